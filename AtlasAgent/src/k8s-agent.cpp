@@ -13,8 +13,12 @@
 
 #include <lib/collectors/aws/src/aws.h>
 #include <lib/collectors/cgroup/src/cgroup.h>
+#include <lib/collectors/cgroup/src/cpu_burst_sampler.h>
+#include <lib/collectors/cgroup/src/kubepods.h>
+#include <lib/collectors/cgroup/src/memory_events.h>
 #include <lib/collectors/disk/src/disk.h>
 #include <lib/collectors/perf_metrics/src/perf_metrics.h>
+#include <lib/collectors/pressure_stall/src/psi_trigger.h>
 #include <lib/collectors/proc/src/proc.h>
 #include <lib/collectors/service_monitor/src/service_monitor.h>
 
@@ -26,21 +30,27 @@
 
 using Aws = atlasagent::Aws;
 using CGroup = atlasagent::CGroup;
+using CpuBurstSampler = atlasagent::CpuBurstSampler;
 using Disk = atlasagent::Disk;
+using KubePods = atlasagent::KubePods;
+using MemoryEvents = atlasagent::MemoryEvents;
 using PerfMetrics = atlasagent::PerfMetrics;
 using Proc = atlasagent::Proc;
+using PsiTriggers = atlasagent::PsiTriggers;
 
-static void gather_peak_k8s_metrics(CGroup* cGroup, const bool fiveSecondMetricsEnabled, const bool sixtySecondMetricsEnabled)
+static void gather_peak_k8s_metrics(CGroup* cGroup, PsiTriggers* psiTriggers, const bool fiveSecondMetricsEnabled,
+                                     const bool sixtySecondMetricsEnabled)
 {
     cGroup->CpuStats(fiveSecondMetricsEnabled, sixtySecondMetricsEnabled);
+    psiTriggers->poll();
 }
 
 static void gather_slow_k8s_metrics(CGroup* cGroup, Proc* proc, Disk* disk, Aws* aws)
 {
     aws->collect();
-    cGroup->MemoryStatsV2();
-    cGroup->MemoryStatsStdV2();
+    cGroup->MemoryStats();
     cGroup->NetworkStats();
+    cGroup->ControllerStats();
     disk->k8s_disk_stats();
     proc->CollectK8s();
 }
@@ -56,10 +66,14 @@ void collect_k8s_metrics(Registry* registry, const std::unordered_map<std::strin
     Aws aws{registry};
     CGroup cGroup{registry};
     Disk disk{registry, ""};
+    MemoryEvents memoryEvents{registry};
     PerfMetrics perf_metrics{registry, ""};
     Proc proc{registry, std::move(net_tags)};
+    PsiTriggers psiTriggers{registry, "/sys/fs/cgroup", ".pressure"};
 
     auto gpu = GpuMetrics::Create(registry);
+    auto cpuBurstSampler = CpuBurstSampler::Create(registry);
+    auto kubePods = KubePods::Create(registry);
 
     // TODO: DCGM & ServiceMonitor have Dynamic metric collection. During each iteration we have to
     // check if these optionals have a set value. lets improve how we handle this
@@ -92,7 +106,7 @@ void collect_k8s_metrics(Registry* registry, const std::unordered_map<std::strin
 
         // 1 second, 5 second, and 60 second CPU metrics are gathered here because they read from
         // the same /proc/stat file
-        gather_peak_k8s_metrics(&cGroup, fiveSecondMetricsEnabled, sixtySecondMetricsEnabled);
+        gather_peak_k8s_metrics(&cGroup, &psiTriggers, fiveSecondMetricsEnabled, sixtySecondMetricsEnabled);
 
         // If its time to gather 5 second metrics, update the next run time
         // Currently we only have CPU metrics that run every 5 seconds, but if we add more in the future
@@ -100,6 +114,7 @@ void collect_k8s_metrics(Registry* registry, const std::unordered_map<std::strin
         if (fiveSecondMetricsEnabled == true)
         {
             cGroup.IOStats();
+            CpuBurstSampler::Collect(cpuBurstSampler);
             next_five_second_run += seconds(5);
         }
 
@@ -109,6 +124,7 @@ void collect_k8s_metrics(Registry* registry, const std::unordered_map<std::strin
             gather_slow_k8s_metrics(&cGroup, &proc, &disk, &aws);
             perf_metrics.collect();
             GpuMetrics::Collect(gpu);
+            KubePods::Collect(kubePods);
             ServiceMonitor::Collect(serviceMetrics);
             auto elapsed = duration_cast<milliseconds>(system_clock::now() - start);
             Logger()->info("Published Kubernetes metrics (delay={})", elapsed);
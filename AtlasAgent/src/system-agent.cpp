@@ -13,10 +13,14 @@
 #include <lib/collectors/ebs/src/ebs.h>
 #include <lib/collectors/ethtool/src/ethtool.h>
 #include <lib/collectors/ntp/src/ntp.h>
+#include <lib/collectors/numa/src/numa.h>
+#include <lib/collectors/nvme/src/nvme_smart.h>
 #include <lib/collectors/perf_metrics/src/perf_metrics.h>
 #include <lib/collectors/perfspect/src/perfspect.h>
 #include <lib/collectors/pressure_stall/src/pressure_stall.h>
+#include <lib/collectors/pressure_stall/src/psi_trigger.h>
 #include <lib/collectors/proc/src/proc.h>
+#include <lib/collectors/schedstat/src/schedstat.h>
 #include <lib/collectors/service_monitor/src/service_monitor.h>
 #include <lib/util/src/util.h>
 
@@ -32,24 +36,35 @@ using CpuFreq = atlasagent::CpuFreq;
 using Disk = atlasagent::Disk;
 using Ethtool = atlasagent::Ethtool;
 using Ntp = atlasagent::Ntp<>;
+using Numa = atlasagent::Numa;
+using NvmeSmart = atlasagent::NvmeSmart;
 using PerfMetrics = atlasagent::PerfMetrics;
 using PressureStall = atlasagent::PressureStall;
+using PsiTriggers = atlasagent::PsiTriggers;
 using Proc = atlasagent::Proc;
+using SchedStat = atlasagent::SchedStat;
 
-static void gather_peak_system_metrics(Proc* proc, const bool fiveSecondMetricsEnabled, const bool sixtySecondMetricsEnabled)
+static void gather_peak_system_metrics(Proc* proc, Disk* disk, Numa* numa, SchedStat* schedStat,
+                                       PsiTriggers* psiTriggers, const bool fiveSecondMetricsEnabled,
+                                       const bool sixtySecondMetricsEnabled)
 {
-    proc->CpuStats(fiveSecondMetricsEnabled, sixtySecondMetricsEnabled);
+    auto cpuLines = proc->CpuStats(fiveSecondMetricsEnabled, sixtySecondMetricsEnabled);
+    numa->CpuStats(cpuLines, sixtySecondMetricsEnabled);
+    schedStat->collect();
+    psiTriggers->poll();
+    disk->peak_stats();
 }
 
 static void gather_scaling_metrics(CpuFreq* cpufreq) { cpufreq->Stats(); }
 
-static void gather_slow_system_metrics(Proc* proc, Disk* disk, Ethtool* ethtool, Ntp* ntp, PressureStall* pressureStall,
-                                       Aws* aws)
+static void gather_slow_system_metrics(Proc* proc, Disk* disk, Ethtool* ethtool, Ntp* ntp, Numa* numa,
+                                       PressureStall* pressureStall, Aws* aws)
 {
     aws->collect();
     disk->disk_stats();
     ethtool->collect();
     ntp->collect();
+    numa->collect();
     pressureStall->collect();
     proc->CollectSystem();
 }
@@ -67,9 +82,12 @@ void collect_system_metrics(Registry* registry, const std::unordered_map<std::st
     Disk disk{registry, ""};
     Ethtool ethtool{registry, net_tags};
     Ntp ntp{registry};
+    Numa numa{registry};
     PerfMetrics perf_metrics{registry, ""};
     PressureStall pressureStall{registry};
+    PsiTriggers psiTriggers{registry};
     Proc proc{registry, net_tags};
+    SchedStat schedStat{registry};
 
     auto gpu = GpuMetrics::Create(registry);
 
@@ -80,6 +98,7 @@ void collect_system_metrics(Registry* registry, const std::unordered_map<std::st
     auto serviceMetrics = ServiceMonitor::Create(registry, max_monitored_services);
     auto perfspectMetrics = Perfspect::Create(registry);
     auto ebsMetrics = EBSCollector::Create(registry);
+    auto nvmeSmart = NvmeSmart::Create(registry);
     auto gpuAMD = atlasagent::GpuMetricsAMD::Create(registry);
 
     // initial polling delay, to prevent publishing too close to a minute boundary
@@ -92,7 +111,7 @@ void collect_system_metrics(Registry* registry, const std::unordered_map<std::st
 
     // the first call to this gather function takes ~100ms, so it must be
     // done before we start calculating times to wait for peak metrics
-    gather_slow_system_metrics(&proc, &disk, &ethtool, &ntp, &pressureStall, &aws);
+    gather_slow_system_metrics(&proc, &disk, &ethtool, &ntp, &numa, &pressureStall, &aws);
     Logger()->info("Published slow system metrics (first iteration)");
 
     auto now = system_clock::now();
@@ -110,14 +129,17 @@ void collect_system_metrics(Registry* registry, const std::unordered_map<std::st
         // Gather one second metrics
         // Proc has been modified to optionally gather 5 second and 60 second metrics during this call
         // This prevents having to read proc/stat multiple times if both 5 and 60 second metrics are enabled
-        gather_peak_system_metrics(&proc, fiveSecondMetricsEnabled, sixtySecondMetricsEnabled);
+        gather_peak_system_metrics(&proc, &disk, &numa, &schedStat, &psiTriggers, fiveSecondMetricsEnabled,
+                                   sixtySecondMetricsEnabled);
         gather_scaling_metrics(&cpufreq);
+        EBSCollector::Sample(ebsMetrics);
 
         // If it's time to gather the 5 second metrics
         if (fiveSecondMetricsEnabled == true)
         {
             Logger()->debug("Gathering 5 second metrics");
             Perfspect::Collect(perfspectMetrics);
+            disk.latency_stats();
             next_five_second_run += seconds(5);
         }
 
@@ -125,13 +147,14 @@ void collect_system_metrics(Registry* registry, const std::unordered_map<std::st
         if (sixtySecondMetricsEnabled == true)
         {
             Logger()->debug("Gathering 60 second metrics");
-            gather_slow_system_metrics(&proc, &disk, &ethtool, &ntp, &pressureStall, &aws);
+            gather_slow_system_metrics(&proc, &disk, &ethtool, &ntp, &numa, &pressureStall, &aws);
             perf_metrics.collect();
             GpuMetrics::Collect(gpu);
 
             atlasagent::GpuMetricsAMD::Collect(gpuAMD);
             GpuMetricsDCGM::Collect(gpuDCGM);
             EBSCollector::Collect(ebsMetrics);
+            NvmeSmart::Collect(nvmeSmart);
             ServiceMonitor::Collect(serviceMetrics);
 
             auto elapsed = duration_cast<milliseconds>(system_clock::now() - start);
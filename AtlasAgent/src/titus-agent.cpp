@@ -7,8 +7,11 @@
 
 #include <lib/collectors/aws/src/aws.h>
 #include <lib/collectors/cgroup/src/cgroup.h>
+#include <lib/collectors/cgroup/src/cpu_burst_sampler.h>
+#include <lib/collectors/cgroup/src/memory_events.h>
 #include <lib/collectors/disk/src/disk.h>
 #include <lib/collectors/perf_metrics/src/perf_metrics.h>
+#include <lib/collectors/pressure_stall/src/psi_trigger.h>
 #include <lib/collectors/proc/src/proc.h>
 #include <lib/collectors/service_monitor/src/service_monitor.h>
 
@@ -20,21 +23,26 @@
 
 using Aws = atlasagent::Aws;
 using CGroup = atlasagent::CGroup;
+using CpuBurstSampler = atlasagent::CpuBurstSampler;
 using Disk = atlasagent::Disk;
+using MemoryEvents = atlasagent::MemoryEvents;
 using PerfMetrics = atlasagent::PerfMetrics;
 using Proc = atlasagent::Proc;
+using PsiTriggers = atlasagent::PsiTriggers;
 
-static void gather_peak_titus_metrics(CGroup* cGroup, const bool fiveSecondMetricsEnabled, const bool sixtySecondMetricsEnabled)
+static void gather_peak_titus_metrics(CGroup* cGroup, PsiTriggers* psiTriggers, const bool fiveSecondMetricsEnabled,
+                                     const bool sixtySecondMetricsEnabled)
 {
     cGroup->CpuStats(fiveSecondMetricsEnabled, sixtySecondMetricsEnabled);
+    psiTriggers->poll();
 }
 
 static void gather_slow_titus_metrics(CGroup* cGroup, Proc* proc, Disk* disk, Aws* aws)
 {
     aws->collect();
-    cGroup->MemoryStatsV2();
-    cGroup->MemoryStatsStdV2();
+    cGroup->MemoryStats();
     cGroup->NetworkStats();
+    cGroup->ControllerStats();
     disk->titus_disk_stats();
     proc->CollectTitus();
 }
@@ -50,10 +58,13 @@ void collect_titus_metrics(Registry* registry, const std::unordered_map<std::str
     Aws aws{registry};
     CGroup cGroup{registry};
     Disk disk{registry, ""};
+    MemoryEvents memoryEvents{registry};
     PerfMetrics perf_metrics{registry, ""};
     Proc proc{registry, std::move(net_tags)};
+    PsiTriggers psiTriggers{registry, "/sys/fs/cgroup", ".pressure"};
 
     auto gpu = GpuMetrics::Create(registry);
+    auto cpuBurstSampler = CpuBurstSampler::Create(registry);
 
     // TODO: DCGM & ServiceMonitor have Dynamic metric collection. During each iteration we have to
     // check if these optionals have a set value. lets improve how we handle this
@@ -86,7 +97,7 @@ void collect_titus_metrics(Registry* registry, const std::unordered_map<std::str
 
         // 1 second, 5 second, and 60 second CPU metrics are gathered here because they read from
         // the same /proc/stat file
-        gather_peak_titus_metrics(&cGroup, fiveSecondMetricsEnabled, sixtySecondMetricsEnabled);
+        gather_peak_titus_metrics(&cGroup, &psiTriggers, fiveSecondMetricsEnabled, sixtySecondMetricsEnabled);
 
         // If its time to gather 5 second metrics, update the next run time
         // Currently we only have CPU metrics that run every 5 seconds, but if we add more in the future
@@ -94,6 +105,7 @@ void collect_titus_metrics(Registry* registry, const std::unordered_map<std::str
         if (fiveSecondMetricsEnabled == true)
         {
             cGroup.IOStats();
+            CpuBurstSampler::Collect(cpuBurstSampler);
             next_five_second_run += seconds(5);
         }
 
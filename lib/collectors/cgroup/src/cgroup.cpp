@@ -1,10 +1,13 @@
 #include "cgroup.h"
+#include "memory_events.h"
 #include <lib/util/src/util.h>
+#include <algorithm>
 #include <cstdlib>
 #include <charconv>
 #include <map>
-#include <unordered_set>
 #include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
 
 namespace atlasagent
 {
@@ -60,9 +63,198 @@ void CGroup::PressureStall() noexcept
     }
 }
 
+UnixFile CGroup::OpenControlFile(const char* name) noexcept
+{
+    if (cgroup_dir_ < 0)
+    {
+        cgroup_dir_ = UnixFile{open(path_prefix_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+        if (cgroup_dir_ < 0)
+        {
+            return UnixFile{-1};
+        }
+    }
+    return UnixFile{openat(cgroup_dir_, name, O_RDONLY | O_CLOEXEC)};
+}
+
+std::string_view CGroup::ReadControlFile(const char* name, char* buf, size_t size) noexcept
+{
+    auto fd = OpenControlFile(name);
+    if (fd < 0)
+    {
+        return {};
+    }
+    auto n = pread(fd, buf, size, 0);
+    return n > 0 ? std::string_view{buf, static_cast<size_t>(n)} : std::string_view{};
+}
+
+std::string_view CGroup::ReadControlFile(const char* name, std::string& buf) noexcept
+{
+    auto fd = OpenControlFile(name);
+    if (fd < 0)
+    {
+        return {};
+    }
+    if (buf.empty())
+    {
+        buf.resize(4096);
+    }
+    size_t len = 0;
+    ssize_t n;
+    while ((n = pread(fd, buf.data() + len, buf.size() - len, static_cast<off_t>(len))) > 0)
+    {
+        len += static_cast<size_t>(n);
+        if (len == buf.size())
+        {
+            buf.resize(len * 2);
+        }
+    }
+    return n < 0 ? std::string_view{} : std::string_view{buf.data(), len};
+}
+
+// A single number, or -1 for "max" and missing files
+static int64_t ParseControlValue(std::string_view value)
+{
+    int64_t result = -1;
+    std::from_chars(value.data(), value.data() + value.size(), result);
+    return result;
+}
+
+template <typename F>
+static void ForEachControlLine(std::string_view buf, F f)
+{
+    while (!buf.empty())
+    {
+        auto eol = buf.find('\n');
+        if (eol != 0)
+        {
+            f(buf.substr(0, eol));
+        }
+        if (eol == std::string_view::npos)
+        {
+            break;
+        }
+        buf.remove_prefix(eol + 1);
+    }
+}
+
+// The value of `key` in a flat keyed file such as pids.events ("max 3")
+static int64_t ParseControlKey(std::string_view buf, std::string_view key)
+{
+    int64_t result = -1;
+    ForEachControlLine(buf,
+                       [&](std::string_view line)
+                       {
+                           if (line.size() > key.size() && line.starts_with(key) && line[key.size()] == ' ')
+                           {
+                               result = ParseControlValue(line.substr(key.size() + 1));
+                           }
+                       });
+    return result;
+}
+
+void CGroup::HugetlbStats() noexcept
+{
+    if (!hugetlb_sizes_)
+    {
+        // the page sizes are fixed for the life of the machine, so the directory is listed once
+        hugetlb_sizes_.emplace();
+        DirHandle dh{path_prefix_.c_str()};
+        if (dh != nullptr)
+        {
+            struct dirent* de;
+            while ((de = readdir(dh)) != nullptr)
+            {
+                std::string_view name{de->d_name};
+                if (name.starts_with("hugetlb.") && name.ends_with(".current") && !name.contains(".rsvd."))
+                {
+                    hugetlb_sizes_->emplace_back(name.substr(8, name.size() - 8 - 8));
+                }
+            }
+        }
+    }
+
+    char buf[128];
+    for (const auto& size : *hugetlb_sizes_)
+    {
+        auto used = ParseControlValue(ReadControlFile(fmt::format("hugetlb.{}.current", size).c_str(), buf, sizeof buf));
+        if (used >= 0)
+        {
+            registry_->CreateGauge("cgroup.hugetlb.used", {{"size", size}}).Set(used);
+        }
+        auto limit = ParseControlValue(ReadControlFile(fmt::format("hugetlb.{}.max", size).c_str(), buf, sizeof buf));
+        if (limit >= 0)
+        {
+            registry_->CreateGauge("cgroup.hugetlb.limit", {{"size", size}}).Set(limit);
+        }
+        auto failures = ParseControlKey(ReadControlFile(fmt::format("hugetlb.{}.events", size).c_str(), buf, sizeof buf), "max");
+        if (failures >= 0)
+        {
+            registry_->CreateMonotonicCounter("cgroup.hugetlb.failures", {{"size", size}}).Set(failures);
+        }
+    }
+}
+
+void CGroup::ControllerStats() noexcept
+{
+    char buf[1024];
+
+    auto pids = ParseControlValue(ReadControlFile("pids.current", buf, sizeof buf));
+    if (pids >= 0)
+    {
+        registry_->CreateGauge("cgroup.pids.used").Set(pids);
+    }
+    auto pids_max = ParseControlValue(ReadControlFile("pids.max", buf, sizeof buf));
+    if (pids_max >= 0)
+    {
+        registry_->CreateGauge("cgroup.pids.limit").Set(pids_max);
+    }
+    // forks that failed because pids.max was reached
+    auto pids_failures = ParseControlKey(ReadControlFile("pids.events", buf, sizeof buf), "max");
+    if (pids_failures >= 0)
+    {
+        registry_->CreateMonotonicCounter("cgroup.pids.failures").Set(pids_failures);
+    }
+
+    HugetlbStats();
+
+    // misc.current: "<resource> <usage>" per line
+    auto misc = ReadControlFile("misc.current", buf, sizeof buf);
+    ForEachControlLine(misc,
+                       [this](std::string_view line)
+                       {
+                           auto sp = line.find(' ');
+                           if (sp != std::string_view::npos)
+                           {
+                               registry_->CreateGauge("cgroup.misc.used", {{"id", std::string{line.substr(0, sp)}}})
+                                   .Set(ParseControlValue(line.substr(sp + 1)));
+                           }
+                       });
+
+    // rdma.current: "<device> hca_handle=<n> hca_object=<n>" per line
+    auto rdma = ReadControlFile("rdma.current", buf, sizeof buf);
+    ForEachControlLine(rdma,
+                       [this](std::string_view line)
+                       {
+                           auto sp = line.find(' ');
+                           auto dev = std::string{line.substr(0, sp)};
+                           while (sp != std::string_view::npos)
+                           {
+                               line.remove_prefix(sp + 1);
+                               sp = line.find(' ');
+                               auto field = line.substr(0, sp);
+                               auto eq = field.find('=');
+                               if (eq != std::string_view::npos)
+                               {
+                                   registry_->CreateGauge("cgroup.rdma.used", {{"dev", dev}, {"id", std::string{field.substr(0, eq)}}})
+                                       .Set(ParseControlValue(field.substr(eq + 1)));
+                               }
+                           }
+                       });
+}
+
 void CGroup::CpuThrottleV2(const std::unordered_map<std::string, int64_t>& stats) noexcept
 {
-    static auto prev_throttled_time = static_cast<int64_t>(-1);
+    auto& prev_throttled_time = sixty_second_cpu_.throttled_usec;
     auto cur_throttled_time = stats.at("throttled_usec");
     if (prev_throttled_time >= 0)
     {
@@ -76,7 +268,7 @@ void CGroup::CpuThrottleV2(const std::unordered_map<std::string, int64_t>& stats
 
 void CGroup::CpuTimeV2(const std::unordered_map<std::string, int64_t>& stats) noexcept
 {
-    static auto prev_proc_time = static_cast<int64_t>(-1);
+    auto& prev_proc_time = five_second_cpu_.usage_usec;
     if (prev_proc_time >= 0)
     {
         auto secs = (stats.at("usage_usec") - prev_proc_time) / MICROS;
@@ -84,7 +276,7 @@ void CGroup::CpuTimeV2(const std::unordered_map<std::string, int64_t>& stats) no
     }
     prev_proc_time = stats.at("usage_usec");
 
-    static auto prev_sys_usage = static_cast<int64_t>(-1);
+    auto& prev_sys_usage = five_second_cpu_.system_usec;
     if (prev_sys_usage >= 0)
     {
         auto secs = (stats.at("system_usec") - prev_sys_usage) / MICROS;
@@ -92,7 +284,7 @@ void CGroup::CpuTimeV2(const std::unordered_map<std::string, int64_t>& stats) no
     }
     prev_sys_usage = stats.at("system_usec");
 
-    static auto prev_user_usage = static_cast<int64_t>(-1);
+    auto& prev_user_usage = five_second_cpu_.user_usec;
     if (prev_user_usage >= 0)
     {
         auto secs = (stats.at("user_usec") - prev_user_usage) / MICROS;
@@ -101,10 +293,85 @@ void CGroup::CpuTimeV2(const std::unordered_map<std::string, int64_t>& stats) no
     prev_user_usage = stats.at("user_usec");
 }
 
-double CGroup::GetAvailCpuTime(const double delta_t, const double cpuCount) noexcept
+void CGroup::CpuBurstV2(const std::unordered_map<std::string, int64_t>& stats, const double cpuCount) noexcept
 {
+    auto get = [&stats](const char* key)
+    {
+        auto it = stats.find(key);
+        return it == stats.end() ? int64_t{-1} : it->second;
+    };
+    auto& prev = five_second_cpu_;
+    auto periods = get("nr_periods");
+    auto throttled = get("nr_throttled");
+    auto usage = get("usage_usec");
+
+    if (prev.nr_periods >= 0 && periods > prev.nr_periods)
+    {
+        auto delta_periods = static_cast<double>(periods - prev.nr_periods);
+        if (throttled >= prev.nr_throttled && prev.nr_throttled >= 0)
+        {
+            registry_->CreateGauge("cgroup.cpu.throttleRatio").Set((throttled - prev.nr_throttled) / delta_periods);
+        }
+
+        // how much of the quota the container used in the periods it was runnable
+        const auto& limits = GetCpuLimits(absl::Now());
+        auto quota = limits.cfs_quota_usec > 0 ? limits.cfs_quota_usec : cpuCount * limits.cfs_period_usec;
+        if (quota > 0 && prev.period_usage_usec >= 0 && usage >= prev.period_usage_usec)
+        {
+            auto used = static_cast<double>(usage - prev.period_usage_usec);
+            registry_->CreateGauge("cgroup.cpu.periodUtilization").Set(used / (delta_periods * quota) * 100);
+        }
+    }
+    prev.nr_periods = periods;
+    prev.nr_throttled = throttled;
+    prev.period_usage_usec = usage;
+
+    // cpu.max.burst accounting (5.14+)
+    if (auto nr_bursts = get("nr_bursts"); nr_bursts >= 0)
+    {
+        registry_->CreateMonotonicCounter("cgroup.cpu.numBursts").Set(nr_bursts);
+    }
+    auto burst = get("burst_usec");
+    if (burst >= 0 && prev.burst_usec >= 0 && burst >= prev.burst_usec)
+    {
+        registry_->CreateCounter("cgroup.cpu.burstTime").Increment((burst - prev.burst_usec) / MICROS);
+    }
+    prev.burst_usec = burst;
+
+    // time a sibling hyperthread was forced idle by core scheduling
+    auto force_idle = get("core_sched.force_idle_usec");
+    if (force_idle >= 0 && prev.force_idle_usec >= 0 && force_idle >= prev.force_idle_usec)
+    {
+        registry_->CreateCounter("cgroup.cpu.forceIdleTime").Increment((force_idle - prev.force_idle_usec) / MICROS);
+    }
+    prev.force_idle_usec = force_idle;
+}
+
+const CGroup::CpuLimits& CGroup::GetCpuLimits(const absl::Time& now) noexcept
+{
+    if (now - cpu_limits_.refreshed < absl::Seconds(60))
+    {
+        return cpu_limits_;
+    }
+    cpu_limits_.refreshed = now;
+    cpu_limits_.num_cpu = GetNumCpu();
+
+    // "$MAX $PERIOD", where $MAX may be the string max
     auto cpu_max = read_num_vector_from_file(path_prefix_, "cpu.max");
-    auto cfs_period = cpu_max[1];
+    if (cpu_max.size() == 2 && cpu_max[1] > 0)
+    {
+        cpu_limits_.cfs_period_usec = cpu_max[1];
+        cpu_limits_.cfs_quota_usec = cpu_max[0] > 0 ? cpu_max[0] : -1;
+    }
+    cpu_limits_.weight = read_num_from_file(path_prefix_, "cpu.weight");
+    // SCHED_IDLE cgroups (5.15+)
+    cpu_limits_.idle = read_num_from_file(path_prefix_, "cpu.idle");
+    return cpu_limits_;
+}
+
+double CGroup::GetAvailCpuTime(const absl::Time& now, const double delta_t, const double cpuCount) noexcept
+{
+    auto cfs_period = GetCpuLimits(now).cfs_period_usec;
     auto cfs_quota = cfs_period * cpuCount;
     return (delta_t / cfs_period) * cfs_quota;
 }
@@ -122,7 +389,7 @@ double CGroup::GetNumCpu() noexcept
 
 void CGroup::CpuProcessingCapacity(const absl::Time& now, const double cpuCount, const absl::Duration& interval) noexcept
 {
-    static absl::Time last_updated;
+    auto& last_updated = five_second_cpu_.last_updated;
     if (last_updated == absl::UnixEpoch())
     {
         last_updated = now - interval;
@@ -134,7 +401,7 @@ void CGroup::CpuProcessingCapacity(const absl::Time& now, const double cpuCount,
 
 void CGroup::CpuUtilizationV2(const absl::Time& now, const double cpuCount, const std::unordered_map<std::string, int64_t>& stats, const absl::Duration& interval) noexcept
 {
-    static absl::Time last_updated;
+    auto& last_updated = sixty_second_cpu_.last_updated;
     if (last_updated == absl::UnixEpoch())
     {
         last_updated = now - interval;
@@ -142,17 +409,21 @@ void CGroup::CpuUtilizationV2(const absl::Time& now, const double cpuCount, cons
     auto delta_t = absl::ToDoubleSeconds(now - last_updated);
     last_updated = now;
 
-    auto weight = read_num_from_file(path_prefix_, "cpu.weight");
-    if (weight >= 0)
+    const auto& limits = GetCpuLimits(now);
+    if (limits.weight >= 0)
     {
-        registry_->CreateGauge("cgroup.cpu.weight").Set(weight);
+        registry_->CreateGauge("cgroup.cpu.weight").Set(limits.weight);
+    }
+    if (limits.idle >= 0)
+    {
+        registry_->CreateGauge("cgroup.cpu.idle").Set(limits.idle);
     }
 
-    auto avail_cpu_time = GetAvailCpuTime(delta_t, cpuCount);
+    auto avail_cpu_time = GetAvailCpuTime(now, delta_t, cpuCount);
     registry_->CreateGauge("sys.cpu.numProcessors").Set(cpuCount);
     registry_->CreateGauge("titus.cpu.requested").Set(cpuCount);
 
-    static auto prev_system_time = static_cast<int64_t>(-1);
+    auto& prev_system_time = sixty_second_cpu_.system_usec;
     if (prev_system_time >= 0)
     {
         auto secs = (stats.at("system_usec") - prev_system_time) / MICROS;
@@ -160,7 +431,7 @@ void CGroup::CpuUtilizationV2(const absl::Time& now, const double cpuCount, cons
     }
     prev_system_time = stats.at("system_usec");
 
-    static auto prev_user_time = static_cast<int64_t>(-1);
+    auto& prev_user_time = sixty_second_cpu_.user_usec;
     if (prev_user_time >= 0)
     {
         auto secs = (stats.at("user_usec") - prev_user_time) / MICROS;
@@ -171,13 +442,13 @@ void CGroup::CpuUtilizationV2(const absl::Time& now, const double cpuCount, cons
 
 void CGroup::CpuPeakUtilizationV2(const absl::Time& now, const std::unordered_map<std::string, int64_t>& stats, const double cpuCount) noexcept
 {
-    static absl::Time last_updated;
+    auto& last_updated = peak_cpu_.last_updated;
     auto delta_t = absl::ToDoubleSeconds(now - last_updated);
     last_updated = now;
 
-    auto avail_cpu_time = GetAvailCpuTime(delta_t, cpuCount);
+    auto avail_cpu_time = GetAvailCpuTime(now, delta_t, cpuCount);
 
-    static auto prev_system_time = static_cast<int64_t>(-1);
+    auto& prev_system_time = peak_cpu_.system_usec;
     if (prev_system_time >= 0)
     {
         auto secs = (stats.at("system_usec") - prev_system_time) / MICROS;
@@ -185,7 +456,7 @@ void CGroup::CpuPeakUtilizationV2(const absl::Time& now, const std::unordered_ma
     }
     prev_system_time = stats.at("system_usec");
 
-    static auto prev_user_time = static_cast<int64_t>(-1);
+    auto& prev_user_time = peak_cpu_.user_usec;
     if (prev_user_time >= 0)
     {
         auto secs = (stats.at("user_usec") - prev_user_time) / MICROS;
@@ -198,7 +469,7 @@ void CGroup::CpuStats(const bool fiveSecondMetricsEnabled, const bool sixtySecon
 {
     std::unordered_map<std::string, int64_t> stats;
     parse_kv_from_file(path_prefix_, "cpu.stat", &stats);
-    auto cpuCount = GetNumCpu();
+    auto cpuCount = GetCpuLimits(absl::Now()).num_cpu;
 
     // Collect 60 second metrics if enabled
     if (sixtySecondMetricsEnabled)
@@ -211,6 +482,7 @@ void CGroup::CpuStats(const bool fiveSecondMetricsEnabled, const bool sixtySecon
     if (fiveSecondMetricsEnabled)
     {
         CpuTimeV2(stats);
+        CpuBurstV2(stats, cpuCount);
         CpuProcessingCapacity(absl::Now(), cpuCount, absl::Seconds(5));
     }
 
@@ -218,7 +490,73 @@ void CGroup::CpuStats(const bool fiveSecondMetricsEnabled, const bool sixtySecon
     CpuPeakUtilizationV2(absl::Now(), stats, cpuCount);
 }
 
-void CGroup::MemoryStatsV2() noexcept
+MemoryStat ParseMemoryStat(std::FILE* fp) noexcept
+{
+    static constexpr std::pair<std::string_view, int64_t MemoryStat::*> kFields[] = {
+        {"anon", &MemoryStat::anon},
+        {"file", &MemoryStat::file},
+        {"anon_thp", &MemoryStat::anon_thp},
+        {"file_mapped", &MemoryStat::file_mapped},
+        {"file_dirty", &MemoryStat::file_dirty},
+        {"file_writeback", &MemoryStat::file_writeback},
+        {"shmem", &MemoryStat::shmem},
+        {"slab", &MemoryStat::slab},
+        {"sock", &MemoryStat::sock},
+        {"kernel_stack", &MemoryStat::kernel_stack},
+        {"pagetables", &MemoryStat::pagetables},
+        {"workingset_refault_anon", &MemoryStat::workingset_refault_anon},
+        {"workingset_refault_file", &MemoryStat::workingset_refault_file},
+        {"pgfault", &MemoryStat::pgfault},
+        {"pgmajfault", &MemoryStat::pgmajfault},
+        {"pgscan", &MemoryStat::pgscan},
+        {"pgsteal", &MemoryStat::pgsteal},
+    };
+
+    MemoryStat stat;
+    char line[256];
+    while (fgets(line, sizeof line, fp) != nullptr)
+    {
+        std::string_view sv{line};
+        auto sp = sv.find(' ');
+        if (sp == std::string_view::npos)
+        {
+            continue;
+        }
+        auto key = sv.substr(0, sp);
+        for (const auto& [name, field] : kFields)
+        {
+            if (key == name)
+            {
+                std::from_chars(sv.data() + sp + 1, sv.data() + sv.size(), stat.*field);
+                break;
+            }
+        }
+    }
+    return stat;
+}
+
+static MemoryStat ReadMemoryStat(const std::string& prefix) noexcept
+{
+    auto fp = open_file(prefix, "memory.stat");
+    if (fp == nullptr)
+    {
+        return MemoryStat{};
+    }
+    return ParseMemoryStat(fp);
+}
+
+void CGroup::MemoryStats() noexcept
+{
+    auto stat = ReadMemoryStat(path_prefix_);
+    MemoryStatsV2(stat);
+    MemoryStatsStdV2(stat);
+}
+
+void CGroup::MemoryStatsV2() noexcept { MemoryStatsV2(ReadMemoryStat(path_prefix_)); }
+
+void CGroup::MemoryStatsStdV2() noexcept { MemoryStatsStdV2(ReadMemoryStat(path_prefix_)); }
+
+void CGroup::MemoryStatsV2(const MemoryStat& stat) noexcept
 {
     auto usage_bytes = read_num_from_file(path_prefix_, "memory.current");
     if (usage_bytes >= 0)
@@ -239,39 +577,65 @@ void CGroup::MemoryStatsV2() noexcept
     {
         registry_->CreateMonotonicCounter("cgroup.mem.failures").Set(mem_fail);
     }
+    for (const auto* field : kMemoryEventFields)
+    {
+        if (auto it = events.find(field); it != events.end())
+        {
+            registry_->CreateMonotonicCounter("cgroup.mem.events", {{"id", field}}).Set(it->second);
+        }
+    }
 
     // kmem_stats not available for v2
 
-    std::unordered_map<std::string, int64_t> stats;
-    parse_kv_from_file(path_prefix_, "memory.stat", &stats);
-
-    registry_->CreateGauge("cgroup.mem.processUsage", {{"id", "cache"}}).Set(stats["file"]);
+    auto set_gauge = [this](const char* name, const char* id, int64_t value)
+    {
+        if (value >= 0)
+        {
+            registry_->CreateGauge(name, {{"id", id}}).Set(value);
+        }
+    };
+    auto set_counter = [this](const char* name, const char* id, int64_t value)
+    {
+        if (value >= 0)
+        {
+            registry_->CreateMonotonicCounter(name, {{"id", id}}).Set(value);
+        }
+    };
 
-    registry_->CreateGauge("cgroup.mem.processUsage", {{"id", "rss"}}).Set(stats["anon"]);
+    set_gauge("cgroup.mem.processUsage", "cache", stat.file);
+    set_gauge("cgroup.mem.processUsage", "rss", stat.anon);
+    set_gauge("cgroup.mem.processUsage", "rss_huge", stat.anon_thp);
+    set_gauge("cgroup.mem.processUsage", "mapped_file", stat.file_mapped);
 
-    registry_->CreateGauge("cgroup.mem.processUsage", {{"id", "rss_huge"}}).Set(stats["anon_thp"]);
+    set_counter("cgroup.mem.pageFaults", "minor", stat.pgfault);
+    set_counter("cgroup.mem.pageFaults", "major", stat.pgmajfault);
 
-    registry_->CreateGauge("cgroup.mem.processUsage", {{"id", "mapped_file"}}).Set(stats["file_mapped"]);
+    set_gauge("cgroup.mem.processUsage", "shmem", stat.shmem);
+    set_gauge("cgroup.mem.processUsage", "dirty", stat.file_dirty);
+    set_gauge("cgroup.mem.processUsage", "writeback", stat.file_writeback);
 
-    registry_->CreateMonotonicCounter("cgroup.mem.pageFaults", {{"id", "minor"}}).Set(stats["pgfault"]);
+    set_gauge("cgroup.mem.kernelUsage", "slab", stat.slab);
+    set_gauge("cgroup.mem.kernelUsage", "sock", stat.sock);
+    set_gauge("cgroup.mem.kernelUsage", "kernel_stack", stat.kernel_stack);
+    set_gauge("cgroup.mem.kernelUsage", "pagetables", stat.pagetables);
 
-    registry_->CreateMonotonicCounter("cgroup.mem.pageFaults", {{"id", "major"}}).Set(stats["pgmajfault"]);
+    set_counter("cgroup.mem.workingsetRefault", "anon", stat.workingset_refault_anon);
+    set_counter("cgroup.mem.workingsetRefault", "file", stat.workingset_refault_file);
+    set_counter("cgroup.mem.reclaim", "scan", stat.pgscan);
+    set_counter("cgroup.mem.reclaim", "steal", stat.pgsteal);
 }
 
-void CGroup::MemoryStatsStdV2() noexcept
+void CGroup::MemoryStatsStdV2(const MemoryStat& stat) noexcept
 {
     auto mem_limit = read_num_from_file(path_prefix_, "memory.max");
     auto mem_usage = read_num_from_file(path_prefix_, "memory.current");
     auto memsw_limit = read_num_from_file(path_prefix_, "memory.swap.max");
     auto memsw_usage = read_num_from_file(path_prefix_, "memory.swap.current");
 
-    std::unordered_map<std::string, int64_t> stats;
-    parse_kv_from_file(path_prefix_, "memory.stat", &stats);
-
-    auto cache = stats["file"];
+    auto cache = std::max<int64_t>(stat.file, 0);
     registry_->CreateGauge("mem.cached").Set(cache);
 
-    registry_->CreateGauge("mem.shared").Set(stats["shmem"]);
+    registry_->CreateGauge("mem.shared").Set(std::max<int64_t>(stat.shmem, 0));
 
     if (mem_limit >= 0 && mem_usage >= 0)
     {
@@ -292,140 +656,112 @@ void CGroup::MemoryStatsStdV2() noexcept
     }
 }
 
-std::unordered_map<std::string, std::string> FindDeviceNames()
+std::optional<std::string> BlockDeviceNames::Lookup(unsigned major, unsigned minor) const noexcept
 {
-    auto lines = read_lines_fields("/proc", "diskstats");
-    std::unordered_map<std::string, std::string> deviceMap(lines.size());
-    static constexpr unsigned int EXPECTED_FIELDS = 20;
-    for (const auto& fields : lines)
+    // MAJOR=259\nMINOR=0\nDEVNAME=nvme0n1\nDEVTYPE=disk\n...
+    auto fp = open_file(fmt::format("{}/{}:{}", root_, major, minor), "uevent");
+    if (fp == nullptr)
+    {
+        return std::nullopt;
+    }
+    char line[256];
+    while (fgets(line, sizeof line, fp) != nullptr)
     {
-        if (fields.size() != EXPECTED_FIELDS) [[unlikely]]
+        std::string_view sv{line};
+        if (sv.starts_with("DEVNAME="))
         {
-            atlasagent::Logger()->warn("Unexpected number of fields in /proc/diskstats line: {}", fields.size());
-            continue;
+            sv.remove_prefix(8);
+            while (!sv.empty() && sv.back() == '\n')
+            {
+                sv.remove_suffix(1);
+            }
+            return std::string{sv};
         }
+    }
+    return std::nullopt;
+}
 
-        std::string majorMinor = fields[0] + ':' + fields[1];
-        deviceMap.emplace(std::move(majorMinor), fields[2]);
+static std::string_view NextIOStatField(std::string_view& line)
+{
+    auto start = line.find_first_not_of(' ');
+    if (start == std::string_view::npos)
+    {
+        line = {};
+        return {};
     }
-    return deviceMap;
+    auto end = line.find(' ', start);
+    auto field = line.substr(start, end - start);
+    line = end == std::string_view::npos ? std::string_view{} : line.substr(end);
+    return field;
 }
 
-std::optional<IOStats> ParseIOLine(const std::vector<std::string>& fields, const std::unordered_map<std::string, std::string>& devMap) try
+template <typename T>
+static bool ParseIOStatNumber(std::string_view s, T* value)
 {
-    // Set the key to the device name
-    IOStats stats;
-    stats.majorMinor = fields[0];
+    auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), *value);
+    return ec == std::errc() && ptr == s.data() + s.size() && !s.empty();
+}
 
-    auto it = devMap.find(stats.majorMinor);
-    if (it != devMap.end())
+// "259:0 rbytes=N wbytes=N rios=N wios=N dbytes=N dios=N", possibly followed by extension keys such as
+// cost.vrate=100.00 and cost.usage=N added by io.cost
+bool ParseIOStatLine(std::string_view line, IOStatSample* sample) noexcept
+{
+    *sample = {};
+    auto device = NextIOStatField(line);
+    if (line.find_first_not_of(' ') == std::string_view::npos)
     {
-        stats.deviceName = it->second;
+        return true;  // a device with no stats
     }
-    else
+
+    auto colon = device.find(':');
+    if (colon == std::string_view::npos || !ParseIOStatNumber(device.substr(0, colon), &sample->major) ||
+        !ParseIOStatNumber(device.substr(colon + 1), &sample->minor))
     {
-        atlasagent::Logger()->warn("Device major:minor {} not found in /proc/diskstats mapping", stats.majorMinor);
+        Logger()->error("Malformed device in io.stat: {}", device);
+        return false;
     }
 
-    // Iterate through the remaining fields and parse key-value pairs
-    for (size_t i = 1; i < fields.size(); ++i)
+    static constexpr std::string_view keys[] = {"rbytes", "wbytes", "rios", "wios", "dbytes", "dios"};
+    uint64_t* values[] = {&sample->rBytes,      &sample->wBytes, &sample->rOperations,
+                          &sample->wOperations, &sample->dBytes, &sample->dOperations};
+    unsigned found = 0;
+    for (auto field = NextIOStatField(line); !field.empty(); field = NextIOStatField(line))
     {
-        auto pos = fields[i].find('=');
-        if (pos == std::string::npos)
+        auto eq = field.find('=');
+        if (eq == std::string_view::npos)
         {
-            throw std::runtime_error("Malformed key=value pair in io.stat: " + fields[i]);
+            Logger()->error("Malformed key=value pair in io.stat: {}", field);
+            return false;
         }
 
-        std::string_view currentField(fields[i]);
-        std::string_view key = currentField.substr(0, pos);
-
-        // Skip unknown extension keys (e.g. cost.vrate, cost.usage added by io.cost)
-        // before parsing the value — floating-point from_chars is incomplete on some
-        // C++17 toolchains (libstdc++ < GCC 11), so values like "100.00" must never
-        // reach from_chars for keys we do not intend to use.
-        static const std::unordered_set<std::string_view> knownKeys{"rbytes", "wbytes", "rios", "wios", "dbytes", "dios"};
-        if (!knownKeys.count(key))
+        // unknown keys are skipped without looking at their values, which need not be integers
+        auto key = field.substr(0, eq);
+        auto k = static_cast<size_t>(std::find(std::begin(keys), std::end(keys), key) - std::begin(keys));
+        if (k == std::size(keys))
+        {
             continue;
-
-        std::string_view value_str = currentField.substr(pos + 1);
-
-        double value;
-        auto [ptr, ec] = std::from_chars(value_str.data(), value_str.data() + value_str.size(), value);
-        if (ec != std::errc())
+        }
+        if (found & (1u << k))
         {
-            throw std::runtime_error("Failed to parse expected integer from io.stat");
-        };
-
-        if (value < 0)
+            Logger()->error("Duplicate key in io.stat: {}", key);
+            return false;
+        }
+        // negative values fail to parse as unsigned
+        if (!ParseIOStatNumber(field.substr(eq + 1), values[k]))
         {
-            throw std::runtime_error("Negative value in io.stat for key: " + std::string(key));
+            Logger()->error("Failed to parse expected integer from io.stat: {}", field);
+            return false;
         }
-
-        if (key == "rbytes" && stats.rBytes.has_value() == false)
-            stats.rBytes = value;
-        else if (key == "wbytes" && stats.wBytes.has_value() == false)
-            stats.wBytes = value;
-        else if (key == "rios" && stats.rOperations.has_value() == false)
-            stats.rOperations = value;
-        else if (key == "wios" && stats.wOperations.has_value() == false)
-            stats.wOperations = value;
-        else if (key == "dbytes" && stats.dBytes.has_value() == false)
-            stats.dBytes = value;
-        else if (key == "dios" && stats.dOperations.has_value() == false)
-            stats.dOperations = value;
-        else
-            // Unknown keys were already filtered above, so reaching here means a duplicate.
-            throw std::runtime_error("Duplicate key in io.stat: " + std::string(key));
+        found |= 1u << k;
     }
 
-    // Validate that all required IO statistics are set
-    bool all_stats_valid = stats.rBytes.has_value() && stats.wBytes.has_value() && stats.rOperations.has_value() &&
-                           stats.wOperations.has_value() && stats.dBytes.has_value() && stats.dOperations.has_value();
-
-    if (!all_stats_valid)
+    if (found != (1u << std::size(keys)) - 1)
     {
-        throw std::runtime_error("Incomplete IO statistics for device: " + stats.majorMinor);
+        Logger()->error("Incomplete IO statistics for device: {}", device);
+        return false;
     }
-
-    return stats;
-}
-catch (const std::exception& ex)
-{
-    atlasagent::Logger()->error("Exception parsing IO stat line: {}", ex.what());
-    return std::nullopt;
-}
-
-std::unordered_map<std::string, IOStats> ParseIOLines(const std::vector<std::vector<std::string>>& lines, const std::unordered_map<std::string, std::string>& devMap) try
-{
-    std::unordered_map<std::string, IOStats> ioStats;
-
-    // Iterate through each line from io.stat
-    for (const auto& fields : lines)
-    {
-        // Skip completely empty lines (device with no stats)
-        if (fields.size() == 1) continue;
-
-        // Each line needs at least 7 fields: device rbytes= wbytes= rios= wios= dbytes= dios=
-        // Extra fields (e.g. cost.vrate=, cost.usage= added by io.cost) are tolerated
-        if (fields.size() < 7)
-        {
-            throw std::runtime_error("Invalid number of fields in io.stat line: " + std::to_string(fields.size()));
-        }
-
-        // Parse the individual line into an IOStats object
-        auto ioStatObject = ParseIOLine(fields, devMap);
-        if (ioStatObject.has_value() == false)
-        {
-            return {};
-        }
-        ioStats.emplace(ioStatObject->majorMinor, std::move(ioStatObject.value()));
-    }
-    return ioStats;
-}
-catch (const std::exception& ex)
-{
-    atlasagent::Logger()->error("Exception parsing IO stat lines: {}", ex.what());
-    return {};
+    sample->hasStats = true;
+    return true;
 }
 
 std::optional<IOThrottle> ParseIOThrottleLine(const std::vector<std::string>& fields) try
@@ -522,96 +858,179 @@ catch (const std::exception& ex)
     return {};
 }
 
-void UpdateIOMetrics(const std::unordered_map<std::string, IOStats>& ioStats, const std::unordered_map<std::string, IOThrottle>& ioThrottles, Registry* registry)
+// io.stat lists devices in the same order every time, so the hint (the position after the previous
+// device) nearly always finds the device without searching
+IODevice& CGroup::FindIODevice(unsigned major, unsigned minor, size_t& hint) noexcept
+{
+    auto matches = [&](const IODevice& dev) { return dev.major == major && dev.minor == minor; };
+    auto slot = hint < io_devices_.size() && matches(io_devices_[hint])
+                    ? hint
+                    : static_cast<size_t>(std::find_if(io_devices_.begin(), io_devices_.end(), matches) -
+                                          io_devices_.begin());
+    if (slot == io_devices_.size())
+    {
+        auto& dev = io_devices_.emplace_back();
+        dev.major = major;
+        dev.minor = minor;
+        ResolveIODevice(dev);
+        SetIOThrottle(dev);
+    }
+    hint = slot + 1;
+    return io_devices_[slot];
+}
+
+void CGroup::ResolveIODevice(IODevice& dev) noexcept
+{
+    auto name = block_devices_.Lookup(dev.major, dev.minor);
+    if (!name)
+    {
+        Logger()->warn("Device major:minor {}:{} not found in /sys/dev/block", dev.major, dev.minor);
+        return;
+    }
+    dev.resolved = true;
+    if (*name != dev.name)
+    {
+        dev.name = std::move(*name);
+        dev.meters.reset();
+    }
+}
+
+void CGroup::SetIOThrottle(IODevice& dev) noexcept
+{
+    auto it = io_throttles_.find(fmt::format("{}:{}", dev.major, dev.minor));
+    dev.throttle = it == io_throttles_.end() ? std::nullopt : std::optional<IOThrottle>{it->second};
+}
+
+void CGroup::UpdateIODevice(IODevice& dev) noexcept
 {
-    // Static map to hold previous IOStats for delta calculations
-    static std::unordered_map<std::string, IOStats> previousStats;
     constexpr double INTERVAL_SECONDS = 5.0;
     constexpr double PERCENT_MULTIPLIER = 100.0;
 
-    // Iterate through current IO statistics
-    for (const auto& [deviceKey, currentStat] : ioStats)
+    const auto cur = dev.cur;
+    const auto prev = dev.prev;
+    const auto hadPrev = dev.hasPrev;
+    dev.prev = cur;
+    dev.hasPrev = true;
+    if (!hadPrev)
+    {
+        return;
+    }
+
+    // Counters going backwards mean the major:minor may now belong to another device, whose counters
+    // start over, so look its name up again and take this sample as the new baseline
+    if (cur.rBytes < prev.rBytes || cur.wBytes < prev.wBytes || cur.rOperations < prev.rOperations ||
+        cur.wOperations < prev.wOperations)
     {
-        atlasagent::Logger()->debug("IO Stats for device {}:", deviceKey);
-        atlasagent::Logger()->debug("\tIO Object: {{current_rbytes: {}, current_rios: {}, current_wbytes: {}, current_wios: {}}}",
-                        currentStat.rBytes.value(), currentStat.rOperations.value(), currentStat.wBytes.value(),
-                        currentStat.wOperations.value());
+        ResolveIODevice(dev);
+        return;
+    }
 
-        // Check if we have previous data for a delta calculation
-        auto prev_it = previousStats.find(deviceKey);
-        if (prev_it != previousStats.end())
-        {
-            const auto& prevStat = prev_it->second;
-
-            // Calculate deltas
-            const auto delta_rbytes = currentStat.rBytes.value() - prevStat.rBytes.value();
-            const auto delta_wbytes = currentStat.wBytes.value() - prevStat.wBytes.value();
-            const auto delta_rios = currentStat.rOperations.value() - prevStat.rOperations.value();
-            const auto delta_wios = currentStat.wOperations.value() - prevStat.wOperations.value();
-
-            atlasagent::Logger()->debug("\tRealtime Counter: {{delta_rbytes: {}, delta_rios: {}, delta_wbytes: {}, delta_wios: {}}}",
-                            delta_rbytes, delta_rios, delta_wbytes, delta_wios);
-
-            // Update byte and operation counters
-            registry->CreateCounter("disk.io.bytes", {{"dev", currentStat.deviceName}, {"id", "read"}}).Increment(delta_rbytes);
-            registry->CreateCounter("disk.io.bytes", {{"dev", currentStat.deviceName}, {"id", "write"}}).Increment(delta_wbytes);
-            registry->CreateCounter("disk.io.ops", {{"dev", currentStat.deviceName}, {"id", "read"}, {"statistic", "count"}}).Increment(delta_rios);
-            registry->CreateCounter("disk.io.ops", {{"dev", currentStat.deviceName}, {"id", "write"}, {"statistic", "count"}}).Increment(delta_wios);
-
-            // Calculate throttle utilization if throttle data is available
-            auto throttle_it = ioThrottles.find(deviceKey);
-            if (throttle_it != ioThrottles.end())
-            {
-                const auto& throttle = throttle_it->second;
+    const auto delta_rbytes = static_cast<double>(cur.rBytes - prev.rBytes);
+    const auto delta_wbytes = static_cast<double>(cur.wBytes - prev.wBytes);
+    const auto delta_rios = static_cast<double>(cur.rOperations - prev.rOperations);
+    const auto delta_wios = static_cast<double>(cur.wOperations - prev.wOperations);
+    atlasagent::Logger()->debug("IO Stats for device {}: {{delta_rbytes: {}, delta_rios: {}, delta_wbytes: {}, "
+                                "delta_wios: {}}}",
+                                dev.name, delta_rbytes, delta_rios, delta_wbytes, delta_wios);
 
-                atlasagent::Logger()->debug("\tThrottle Settings: {{read_bps: {}, write_bps: {}, read_iops: {}, write_iops: {}}}",
-                                throttle.rBps.value(), throttle.wBps.value(), throttle.rIops.value(),
-                                throttle.wIops.value());
+    // Meter handles are created once per device
+    if (!dev.meters)
+    {
+        const auto& name = dev.name;
+        constexpr auto bytes = "cgroup.disk.io.throttleActivityBytes";
+        constexpr auto ops = "cgroup.disk.io.throttleActivityOperations";
+        dev.meters.emplace(IODeviceMeters{
+            registry_->CreateCounter("disk.io.bytes", {{"dev", name}, {"id", "read"}}),
+            registry_->CreateCounter("disk.io.bytes", {{"dev", name}, {"id", "write"}}),
+            registry_->CreateCounter("disk.io.ops", {{"dev", name}, {"id", "read"}, {"statistic", "count"}}),
+            registry_->CreateCounter("disk.io.ops", {{"dev", name}, {"id", "write"}, {"statistic", "count"}}),
+            registry_->CreateDistributionSummary(bytes, {{"dev", name}, {"id", "read"}}),
+            registry_->CreateDistributionSummary(bytes, {{"dev", name}, {"id", "write"}}),
+            registry_->CreateDistributionSummary(ops, {{"dev", name}, {"id", "read"}}),
+            registry_->CreateDistributionSummary(ops, {{"dev", name}, {"id", "write"}})});
+    }
+    auto& meters = *dev.meters;
 
-                // Helper lambda to record throttle utilization
-                auto record_throttle_utilization = [&](double delta, const std::optional<double>& limit, const std::string& metric_name, const std::string& operation)
-                {
-                    if (limit.has_value() && limit.value() > 0)
-                    {
-                        // Utilization = (delta / (limit * interval)) * 100
-                        const auto utilization = (delta / (limit.value() * INTERVAL_SECONDS)) * PERCENT_MULTIPLIER;
-                        registry->CreateDistributionSummary(metric_name, {{"dev", currentStat.deviceName}, {"id", operation}}).Record(utilization);
-                    }
-                };
-
-                record_throttle_utilization(delta_rbytes, throttle.rBps, "cgroup.disk.io.throttleActivityBytes", "read");
-                record_throttle_utilization(delta_wbytes, throttle.wBps, "cgroup.disk.io.throttleActivityBytes", "write");
-                record_throttle_utilization(delta_rios, throttle.rIops, "cgroup.disk.io.throttleActivityOperations", "read");
-                record_throttle_utilization(delta_wios, throttle.wIops, "cgroup.disk.io.throttleActivityOperations", "write");
+    // Update byte and operation counters
+    meters.readBytes.Increment(delta_rbytes);
+    meters.writeBytes.Increment(delta_wbytes);
+    meters.readOps.Increment(delta_rios);
+    meters.writeOps.Increment(delta_wios);
+
+    // Calculate throttle utilization if throttle data is available
+    if (dev.throttle)
+    {
+        const auto& throttle = *dev.throttle;
+        auto record_throttle_utilization =
+            [&](double delta, const std::optional<double>& limit, DistributionSummary& summary)
+        {
+            if (limit.has_value() && limit.value() > 0)
+            {
+                // Utilization = (delta / (limit * interval)) * 100
+                const auto utilization = (delta / (limit.value() * INTERVAL_SECONDS)) * PERCENT_MULTIPLIER;
+                summary.Record(utilization);
             }
-        }
-        // Update previous stats for next iteration
-        previousStats[deviceKey] = currentStat;
+        };
+
+        record_throttle_utilization(delta_rbytes, throttle.rBps, meters.throttleReadBytes);
+        record_throttle_utilization(delta_wbytes, throttle.wBps, meters.throttleWriteBytes);
+        record_throttle_utilization(delta_rios, throttle.rIops, meters.throttleReadOps);
+        record_throttle_utilization(delta_wios, throttle.wIops, meters.throttleWriteOps);
     }
 }
 
 void CGroup::IOStats()
 {
-    // Read the contents of io.stat
-    auto ioStatLines = read_lines_fields(path_prefix_, "io.stat");
-
-    // Find all the device names from /proc/diskstats and create mapping of {major:minor, device name}
-    auto deviceNames = FindDeviceNames();
+    // io.max only changes when limits are reconfigured, so it is reread once a minute. Devices whose
+    // names could not be looked up when they showed up are retried then too.
+    auto now = absl::Now();
+    if (now - io_throttles_refreshed_ >= absl::Seconds(60))
+    {
+        io_throttles_refreshed_ = now;
+        io_throttles_ = ParseIOThrottleLines(read_lines_fields(path_prefix_, "io.max"));
+        for (auto& dev : io_devices_)
+        {
+            SetIOThrottle(dev);
+            if (!dev.resolved)
+            {
+                ResolveIODevice(dev);
+            }
+        }
+    }
 
-    // Parse the io.stat lines into structured IOStats objects
-    auto ioStats = ParseIOLines(ioStatLines, deviceNames);
-    if (ioStats.empty())
+    // Parse io.stat in place into the device table. A malformed line discards the whole sample.
+    for (auto& dev : io_devices_)
+    {
+        dev.seen = false;
+    }
+    size_t hint = 0;
+    bool valid = true;
+    bool any = false;
+    ForEachControlLine(ReadControlFile("io.stat", io_stat_buf_),
+                       [&](std::string_view line)
+                       {
+                           IOStatSample sample;
+                           if (!valid || !(valid = ParseIOStatLine(line, &sample)) || !sample.hasStats)
+                           {
+                               return;
+                           }
+                           auto& dev = FindIODevice(sample.major, sample.minor, hint);
+                           dev.cur = sample;
+                           dev.seen = true;
+                           any = true;
+                       });
+    if (!valid || !any)
     {
         atlasagent::Logger()->info("No valid IO statistics found in io.stat");
         return;
     }
 
-    // Read the contents of io.max and parse into structured IOThrottle objects
-    auto throttleLines = read_lines_fields(path_prefix_, "io.max");
-    auto ioThrottles = ParseIOThrottleLines(throttleLines);
-
-    // Update metrics based on parsed IO statistics and throttling information
-    UpdateIOMetrics(ioStats, ioThrottles, registry_);
+    // Devices that left io.stat were detached, or the cgroup stopped using them
+    std::erase_if(io_devices_, [](const IODevice& dev) { return !dev.seen; });
+    for (auto& dev : io_devices_)
+    {
+        UpdateIODevice(dev);
+    }
 }
 
 }  // namespace atlasagent
\ No newline at end of file
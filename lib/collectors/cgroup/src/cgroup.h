@@ -1,24 +1,30 @@
 #pragma once
 
+#include <lib/files/src/files.h>
 #include <thirdparty/spectator-cpp/spectator/registry.h>
 #include <absl/container/flat_hash_map.h>
 #include <absl/time/clock.h>
+#include <cstdio>
 #include <optional>
+#include <string_view>
+#include <vector>
 
 namespace atlasagent
 {
 
 
-struct IOStats
+// The counters of one io.stat device line
+struct IOStatSample
 {
-    std::string deviceName{"unknown"};
-    std::string majorMinor;
-    std::optional<double> rBytes = std::nullopt;
-    std::optional<double> wBytes = std::nullopt;
-    std::optional<double> rOperations = std::nullopt;
-    std::optional<double> wOperations = std::nullopt;
-    std::optional<double> dBytes = std::nullopt;
-    std::optional<double> dOperations = std::nullopt;
+    unsigned major{0};
+    unsigned minor{0};
+    bool hasStats{false};  // false for a device listed without statistics
+    uint64_t rBytes{0};
+    uint64_t wBytes{0};
+    uint64_t rOperations{0};
+    uint64_t wOperations{0};
+    uint64_t dBytes{0};
+    uint64_t dOperations{0};
 };
 
 struct IOThrottle
@@ -30,6 +36,73 @@ struct IOThrottle
     std::optional<double> wIops = std::nullopt;
 };
 
+// Looks up block device names in /sys/dev/block/<major>:<minor>/uevent
+class BlockDeviceNames
+{
+   public:
+    explicit BlockDeviceNames(std::string sys_dev_block = "/sys/dev/block") noexcept
+        : root_(std::move(sys_dev_block))
+    {
+    }
+
+    [[nodiscard]] std::optional<std::string> Lookup(unsigned major, unsigned minor) const noexcept;
+
+   private:
+    std::string root_;
+};
+
+// Meter handles for one io.stat device, created when its first delta is published.
+struct IODeviceMeters
+{
+    Counter readBytes;
+    Counter writeBytes;
+    Counter readOps;
+    Counter writeOps;
+    DistributionSummary throttleReadBytes;
+    DistributionSummary throttleWriteBytes;
+    DistributionSummary throttleReadOps;
+    DistributionSummary throttleWriteOps;
+};
+
+// One device listed in io.stat, kept while it stays listed. The name is looked up when the device
+// first shows up, and again only if its counters go backwards: NVMe minors are reused after a detach,
+// so a different device may now own the major:minor.
+struct IODevice
+{
+    unsigned major{0};
+    unsigned minor{0};
+    std::string name{"unknown"};
+    bool resolved{false};
+    bool seen{false};  // listed in the latest io.stat
+    bool hasPrev{false};
+    IOStatSample cur;
+    IOStatSample prev;
+    std::optional<IOThrottle> throttle;
+    std::optional<IODeviceMeters> meters;
+};
+
+// The memory.stat fields the agent reports. Fields the kernel does not provide stay at -1.
+struct MemoryStat
+{
+    int64_t anon{-1};
+    int64_t file{-1};
+    int64_t anon_thp{-1};
+    int64_t file_mapped{-1};
+    int64_t file_dirty{-1};
+    int64_t file_writeback{-1};
+    int64_t shmem{-1};
+    int64_t slab{-1};
+    int64_t sock{-1};
+    int64_t kernel_stack{-1};
+    int64_t pagetables{-1};
+    int64_t workingset_refault_anon{-1};
+    int64_t workingset_refault_file{-1};
+    int64_t pgfault{-1};
+    int64_t pgmajfault{-1};
+    int64_t pgscan{-1};
+    int64_t pgsteal{-1};
+};
+
 class CGroup
 {
    public:
@@ -40,11 +113,22 @@ class CGroup
 
     void CpuStats(const bool fiveSecondMetricsEnabled, const bool sixtySecondMetricsEnabled);
     void IOStats();
+    // Parses memory.stat once and publishes both the cgroup.mem and the mem views of it.
+    void MemoryStats() noexcept;
     void MemoryStatsV2() noexcept;
     void MemoryStatsStdV2() noexcept;
     void NetworkStats() noexcept;
     void PressureStall() noexcept;
-    void SetPrefix(std::string new_prefix) noexcept { path_prefix_ = std::move(new_prefix); }
+    // pids, hugetlb, misc and rdma controllers
+    void ControllerStats() noexcept;
+    void SetPrefix(std::string new_prefix) noexcept
+    {
+        path_prefix_ = std::move(new_prefix);
+        cpu_limits_.refreshed = absl::InfinitePast();
+        io_throttles_refreshed_ = absl::InfinitePast();
+        cgroup_dir_ = UnixFile{-1};
+        hugetlb_sizes_.reset();
+    }
 
    protected:
     // For testing access
@@ -52,18 +136,83 @@ class CGroup
     double GetNumCpu() noexcept;
     void CpuThrottleV2(const std::unordered_map<std::string, int64_t>& stats) noexcept;
     void CpuTimeV2(const std::unordered_map<std::string, int64_t>& stats) noexcept;
+    void CpuBurstV2(const std::unordered_map<std::string, int64_t>& stats, const double cpuCount) noexcept;
     void CpuUtilizationV2(const absl::Time& now, const double cpuCount, const std::unordered_map<std::string, int64_t>& stats, const absl::Duration& interval) noexcept;
     void CpuPeakUtilizationV2(const absl::Time& now, const std::unordered_map<std::string, int64_t>& stats, const double cpuCount) noexcept;
     void CpuProcessingCapacity(const absl::Time& now, const double cpuCount, const absl::Duration& interval) noexcept;
-    
+
+    // cpu.max, cpu.weight and TITUS_NUM_CPU only change when the container is resized, so they are
+    // reread at most once a minute rather than on every 1s tick.
+    struct CpuLimits
+    {
+        absl::Time refreshed{absl::InfinitePast()};
+        double num_cpu{0};
+        double cfs_period_usec{100000};
+        double cfs_quota_usec{-1};  // -1 when cpu.max has no quota
+        double weight{-1};
+        double idle{-1};
+    };
+
+    const CpuLimits& GetCpuLimits(const absl::Time& now) noexcept;
+
+    BlockDeviceNames block_devices_;
+    // flat table of the devices in io.stat, in the order it lists them
+    std::vector<IODevice> io_devices_;
+
    private:
-    double GetAvailCpuTime(const double delta_t, const double cpuCount) noexcept;
+    // Read a control file through a directory fd kept open on the cgroup. Returns the contents,
+    // or an empty view when the controller is not enabled.
+    std::string_view ReadControlFile(const char* name, char* buf, size_t size) noexcept;
+    // Reads all of a control file into `buf`, which only grows, for files such as io.stat whose size
+    // depends on the number of devices.
+    std::string_view ReadControlFile(const char* name, std::string& buf) noexcept;
+    UnixFile OpenControlFile(const char* name) noexcept;
+    void HugetlbStats() noexcept;
+
+    void MemoryStatsV2(const MemoryStat& stat) noexcept;
+    void MemoryStatsStdV2(const MemoryStat& stat) noexcept;
+
+    double GetAvailCpuTime(const absl::Time& now, const double delta_t, const double cpuCount) noexcept;
+
+    IODevice& FindIODevice(unsigned major, unsigned minor, size_t& hint) noexcept;
+    void ResolveIODevice(IODevice& dev) noexcept;
+    void SetIOThrottle(IODevice& dev) noexcept;
+    void UpdateIODevice(IODevice& dev) noexcept;
+
+    // Previous cpu.stat sample for one collection cadence. The 1s, 5s and 60s paths compute deltas
+    // over different intervals, so each keeps its own; -1 means no sample yet.
+    struct CpuSample
+    {
+        absl::Time last_updated;
+        int64_t usage_usec{-1};
+        int64_t system_usec{-1};
+        int64_t user_usec{-1};
+        int64_t throttled_usec{-1};
+        int64_t nr_periods{-1};
+        int64_t nr_throttled{-1};
+        int64_t burst_usec{-1};
+        int64_t force_idle_usec{-1};
+        int64_t period_usage_usec{-1};
+    };
 
     Registry* registry_;
+    // Delta state is per instance, so several CGroup collectors (one per cgroup) can coexist.
+    CpuSample peak_cpu_;
+    CpuSample five_second_cpu_;
+    CpuSample sixty_second_cpu_;
+    CpuLimits cpu_limits_;
+    std::string io_stat_buf_;
+    // io.max only changes when limits are reconfigured, so like CpuLimits it is reread once a minute
+    std::unordered_map<std::string, IOThrottle> io_throttles_;
+    absl::Time io_throttles_refreshed_{absl::InfinitePast()};
+    UnixFile cgroup_dir_{-1};
+    std::optional<std::vector<std::string>> hugetlb_sizes_;  // e.g. 2MB, 1GB; listed on first use
 };
 
 // TODO: Stop exposing these functions publicly, currently required for testing
-std::unordered_map<std::string, IOStats> ParseIOLines(const std::vector<std::vector<std::string>>& lines, const std::unordered_map<std::string, std::string>& devMap);
+// Parses one io.stat line in place. Returns false, after logging why, when the line is malformed.
+bool ParseIOStatLine(std::string_view line, IOStatSample* sample) noexcept;
 std::unordered_map<std::string, IOThrottle> ParseIOThrottleLines(const std::vector<std::vector<std::string>>& lines);
+MemoryStat ParseMemoryStat(std::FILE* fp) noexcept;
 
 }  // namespace atlasagent
@@ -0,0 +1,246 @@
+#include "cgroup_watcher.h"
+
+#include <lib/util/src/util.h>
+
+#include <algorithm>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace atlasagent
+{
+
+constexpr uint32_t kWatchMask =
+    IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_ONLYDIR | IN_EXCL_UNLINK;
+
+uint64_t cgroup_id(const char* path) noexcept
+{
+    alignas(file_handle) unsigned char buf[sizeof(file_handle) + MAX_HANDLE_SZ]{};
+    auto* fh = reinterpret_cast<file_handle*>(buf);
+    fh->handle_bytes = MAX_HANDLE_SZ;
+    int mount_id;
+    if (name_to_handle_at(AT_FDCWD, path, fh, &mount_id, 0) == 0 && fh->handle_bytes == sizeof(uint64_t))
+    {
+        uint64_t id;
+        memcpy(&id, fh->f_handle, sizeof id);
+        return id;
+    }
+
+    struct stat st;
+    return stat(path, &st) == 0 ? st.st_ino : 0;
+}
+
+namespace
+{
+int path_depth(const std::string& path)
+{
+    return path.empty() ? 0 : static_cast<int>(std::count(path.begin(), path.end(), '/')) + 1;
+}
+
+std::string child_path(const std::string& parent, std::string_view name)
+{
+    return parent.empty() ? std::string{name} : fmt::format("{}/{}", parent, name);
+}
+}  // namespace
+
+CgroupWatcher::CgroupWatcher(std::string root, int max_depth) noexcept : root_{std::move(root)}, max_depth_{max_depth}
+{
+    init();
+}
+
+std::string CgroupWatcher::full_path(const std::string& path) const
+{
+    return path.empty() ? root_ : fmt::format("{}/{}", root_, path);
+}
+
+void CgroupWatcher::init() noexcept
+{
+    watches_.clear();
+    inotify_ = UnixFile{inotify_init1(IN_NONBLOCK | IN_CLOEXEC)};
+    if (inotify_ < 0)
+    {
+        Logger()->warn("Unable to initialize inotify ({}), rescanning {} on every poll", strerror(errno), root_);
+        return;
+    }
+
+    // watch first, then scan: anything created in between shows up in both and add() ignores the repeat
+    watch("", 0);
+    rescan();
+}
+
+void CgroupWatcher::watch(const std::string& path, int depth) noexcept
+{
+    if (inotify_ < 0 || depth >= max_depth_)
+    {
+        return;
+    }
+    auto wd = inotify_add_watch(inotify_, full_path(path).c_str(), kWatchMask);
+    if (wd < 0)
+    {
+        // ENOSPC: fs.inotify.max_user_watches is exhausted, the overflow rescan still catches changes
+        Logger()->debug("Unable to watch {}: {}", full_path(path), strerror(errno));
+        return;
+    }
+    watches_[wd] = Watch{path, depth};
+}
+
+void CgroupWatcher::scan(const std::string& path, int depth, std::map<std::string, uint64_t>* found) noexcept
+{
+    auto dh = opendir(full_path(path).c_str());
+    if (dh == nullptr)
+    {
+        return;
+    }
+    struct dirent* de;
+    while ((de = readdir(dh)) != nullptr)
+    {
+        if (de->d_type != DT_DIR || de->d_name[0] == '.')
+        {
+            continue;
+        }
+        auto child = child_path(path, de->d_name);
+        found->emplace(child, cgroup_id(full_path(child).c_str()));
+        if (depth + 1 < max_depth_)
+        {
+            scan(child, depth + 1, found);
+        }
+    }
+    closedir(dh);
+}
+
+// Bring the index in line with what is on disk, queueing events for the differences.
+void CgroupWatcher::rescan() noexcept
+{
+    std::map<std::string, uint64_t> found;
+    scan("", 0, &found);
+
+    for (auto it = cgroups_.begin(); it != cgroups_.end();)
+    {
+        auto f = found.find(it->first);
+        if (f == found.end() || f->second != it->second)
+        {
+            events_.push_back(CgroupEvent{CgroupEvent::Kind::Removed, it->first, it->second});
+            it = cgroups_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    for (const auto& [path, id] : found)
+    {
+        if (cgroups_.emplace(path, id).second)
+        {
+            events_.push_back(CgroupEvent{CgroupEvent::Kind::Created, path, id});
+        }
+        // also re-arms every watch after init() replaced the inotify fd
+        watch(path, path_depth(path));
+    }
+}
+
+void CgroupWatcher::add(const std::string& path, int depth) noexcept
+{
+    if (depth > max_depth_ || cgroups_.contains(path))
+    {
+        return;
+    }
+    auto id = cgroup_id(full_path(path).c_str());
+    cgroups_.emplace(path, id);
+    events_.push_back(CgroupEvent{CgroupEvent::Kind::Created, path, id});
+    watch(path, depth);
+
+    // children created before the watch was in place produce no events of their own
+    if (depth < max_depth_)
+    {
+        std::map<std::string, uint64_t> found;
+        scan(path, depth, &found);
+        for (const auto& [child, _] : found)
+        {
+            add(child, path_depth(child));
+        }
+    }
+}
+
+void CgroupWatcher::remove(const std::string& path) noexcept
+{
+    // the cgroup and everything below it; a subtree sorts as a contiguous range after its root
+    auto prefix = path + "/";
+    auto it = cgroups_.find(path);
+    if (it == cgroups_.end())
+    {
+        return;
+    }
+    while (it != cgroups_.end() && (it->first == path || it->first.starts_with(prefix)))
+    {
+        events_.push_back(CgroupEvent{CgroupEvent::Kind::Removed, it->first, it->second});
+        it = cgroups_.erase(it);
+    }
+}
+
+std::vector<CgroupEvent> CgroupWatcher::poll() noexcept
+{
+    if (inotify_ < 0)
+    {
+        rescan();
+        return std::exchange(events_, {});
+    }
+
+    alignas(inotify_event) char buf[16 * 1024];
+    bool overflow = false;
+    for (;;)
+    {
+        auto n = read(inotify_, buf, sizeof buf);
+        if (n <= 0)
+        {
+            break;
+        }
+        for (char* p = buf; p < buf + n;)
+        {
+            auto* ev = reinterpret_cast<inotify_event*>(p);
+            p += sizeof(inotify_event) + ev->len;
+
+            if (ev->mask & IN_Q_OVERFLOW)
+            {
+                overflow = true;
+                continue;
+            }
+            auto w = watches_.find(ev->wd);
+            if (w == watches_.end())
+            {
+                continue;
+            }
+            if (ev->mask & IN_IGNORED)
+            {
+                watches_.erase(w);
+                continue;
+            }
+            if ((ev->mask & IN_ISDIR) == 0 || ev->len == 0)
+            {
+                continue;
+            }
+
+            auto child = child_path(w->second.path, ev->name);
+            if (ev->mask & (IN_CREATE | IN_MOVED_TO))
+            {
+                add(child, w->second.depth + 1);
+            }
+            else if (ev->mask & (IN_DELETE | IN_MOVED_FROM))
+            {
+                remove(child);
+            }
+        }
+    }
+
+    if (overflow)
+    {
+        Logger()->info("inotify queue overflowed for {}, rescanning", root_);
+        init();
+    }
+    return std::exchange(events_, {});
+}
+
+}  // namespace atlasagent
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <lib/files/src/files.h>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace atlasagent
+{
+
+struct CgroupEvent
+{
+    enum class Kind
+    {
+        Created,
+        Removed
+    };
+    Kind kind;
+    std::string path;  // relative to the watched root
+    uint64_t id;       // kernel cgroup id, stable for the lifetime of the cgroup
+};
+
+// The kernel cgroup id of a directory: the 8 byte file handle cgroupfs returns from name_to_handle_at.
+// Falls back to the inode number on filesystems with other handle formats, which is what kernfs uses
+// for the id anyway.
+uint64_t cgroup_id(const char* path) noexcept;
+
+// Keeps an incrementally updated index of the cgroups under a root using inotify, so collectors
+// do not have to rescan the hierarchy on every interval. Directories are indexed down to max_depth
+// levels below the root (the root itself is not reported).
+//
+// poll() never blocks: it drains the pending inotify events and returns what was created or removed
+// since the previous call. The first call reports every existing cgroup as created. If inotify is not
+// available, or its queue overflowed, the tree is rescanned and diffed against the index instead, so
+// callers see the same stream of events either way.
+class CgroupWatcher
+{
+   public:
+    CgroupWatcher(std::string root, int max_depth) noexcept;
+
+    std::vector<CgroupEvent> poll() noexcept;
+
+    [[nodiscard]] const std::map<std::string, uint64_t>& cgroups() const noexcept { return cgroups_; }
+    [[nodiscard]] bool event_driven() const noexcept { return inotify_ >= 0; }
+
+   private:
+    void init() noexcept;
+    void rescan() noexcept;
+    void scan(const std::string& path, int depth, std::map<std::string, uint64_t>* found) noexcept;
+    void add(const std::string& path, int depth) noexcept;
+    void remove(const std::string& path) noexcept;
+    void watch(const std::string& path, int depth) noexcept;
+    [[nodiscard]] std::string full_path(const std::string& path) const;
+
+    struct Watch
+    {
+        std::string path;
+        int depth;
+    };
+
+    std::string root_;
+    int max_depth_;
+    UnixFile inotify_{-1};
+    std::unordered_map<int, Watch> watches_;  // watch descriptor -> directory
+    std::map<std::string, uint64_t> cgroups_; // ordered, so a subtree is a contiguous range
+    std::vector<CgroupEvent> events_;
+};
+
+}  // namespace atlasagent
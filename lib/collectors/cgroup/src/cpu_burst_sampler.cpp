@@ -0,0 +1,199 @@
+#include "cpu_burst_sampler.h"
+
+#include <lib/util/src/util.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace atlasagent
+{
+
+namespace
+{
+double thread_cpu_seconds()
+{
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+}
+
+int64_t stat_value(std::string_view buf, std::string_view key)
+{
+    // keys start a line: "usage_usec 123\n"
+    for (size_t pos = buf.find(key); pos != std::string_view::npos; pos = buf.find(key, pos + 1))
+    {
+        if ((pos == 0 || buf[pos - 1] == '\n') && pos + key.size() < buf.size() && buf[pos + key.size()] == ' ')
+        {
+            int64_t value = -1;
+            auto start = buf.data() + pos + key.size() + 1;
+            std::from_chars(start, buf.data() + buf.size(), value);
+            return value;
+        }
+    }
+    return -1;
+}
+}  // namespace
+
+CpuBurstSampler::CpuBurstSampler(Registry* registry, std::string path_prefix, absl::Duration interval) noexcept
+    : registry_{registry}, path_prefix_{std::move(path_prefix)}, interval_{interval}
+{
+}
+
+CpuBurstSampler::~CpuBurstSampler()
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+}
+
+std::unique_ptr<CpuBurstSampler> CpuBurstSampler::Create(Registry* registry)
+{
+    auto env = std::getenv("ATLAS_CPU_BURST_SAMPLE_MS");
+    if (env == nullptr)
+    {
+        return nullptr;
+    }
+    auto ms = std::strtol(env, nullptr, 10);
+    if (ms < 10 || ms > 100)
+    {
+        Logger()->warn("Ignoring ATLAS_CPU_BURST_SAMPLE_MS={}, expected 10 to 100", env);
+        return nullptr;
+    }
+    auto sampler = std::make_unique<CpuBurstSampler>(registry, "/sys/fs/cgroup", absl::Milliseconds(ms));
+    sampler->start();
+    Logger()->info("Sampling cpu.stat every {}ms", ms);
+    return sampler;
+}
+
+void CpuBurstSampler::Collect(const std::unique_ptr<CpuBurstSampler>& self)
+{
+    if (self)
+    {
+        self->publish();
+    }
+}
+
+void CpuBurstSampler::start() noexcept
+{
+    auto path = fmt::format("{}/cpu.stat", path_prefix_);
+    cpu_stat_ = UnixFile{::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+    if (cpu_stat_ < 0)
+    {
+        Logger()->warn("Unable to open {}: {}", path, strerror(errno));
+        return;
+    }
+    thread_ = std::thread{&CpuBurstSampler::run, this};
+}
+
+double CpuBurstSampler::capacity() const noexcept
+{
+    auto cpu_max = read_num_vector_from_file(path_prefix_, "cpu.max");
+    // "max 100000" parses as a zero quota
+    if (cpu_max.size() == 2 && cpu_max[0] > 0 && cpu_max[1] > 0)
+    {
+        return static_cast<double>(cpu_max[0]) / static_cast<double>(cpu_max[1]);
+    }
+    if (auto env = std::getenv("TITUS_NUM_CPU"); env != nullptr && strtod(env, nullptr) > 0)
+    {
+        return strtod(env, nullptr);
+    }
+    return static_cast<double>(sysconf(_SC_NPROCESSORS_ONLN));
+}
+
+void CpuBurstSampler::run() noexcept
+{
+    char buf[1024];
+    auto cap = capacity();
+    auto cap_refreshed = absl::Now();
+    auto next = absl::Now();
+
+    std::unique_lock<std::mutex> lock{mutex_};
+    while (!stop_)
+    {
+        lock.unlock();
+        auto start_cpu = thread_cpu_seconds();
+        auto now = absl::Now();
+        if (now - cap_refreshed >= absl::Seconds(60))
+        {
+            cap = capacity();
+            cap_refreshed = now;
+        }
+        auto n = pread(cpu_stat_, buf, sizeof buf - 1, 0);
+        if (n > 0)
+        {
+            sample(now, std::string_view{buf, static_cast<size_t>(n)}, cap);
+        }
+        auto spent = thread_cpu_seconds() - start_cpu;
+        lock.lock();
+        aggregate_.sampler_seconds += spent;
+
+        // fixed-rate schedule, skipping ticks rather than bunching up after a stall
+        next += interval_;
+        if (next < absl::Now())
+        {
+            next = absl::Now() + interval_;
+        }
+        cv_.wait_until(lock, absl::ToChronoTime(next), [this] { return stop_; });
+    }
+}
+
+void CpuBurstSampler::sample(absl::Time now, std::string_view cpu_stat, double capacity) noexcept
+{
+    Reading cur{now, stat_value(cpu_stat, "usage_usec"), stat_value(cpu_stat, "nr_throttled")};
+    auto prev = prev_;
+    prev_ = cur;
+    auto elapsed = absl::ToDoubleMicroseconds(cur.when - prev.when);
+    if (prev.usage_usec < 0 || cur.usage_usec < prev.usage_usec || elapsed <= 0 || capacity <= 0)
+    {
+        return;
+    }
+
+    auto utilization = static_cast<double>(cur.usage_usec - prev.usage_usec) / (elapsed * capacity) * 100;
+    auto bucket = std::ranges::lower_bound(kBuckets, utilization) - kBuckets.begin();
+    auto throttled = std::max<int64_t>(0, cur.nr_throttled - prev.nr_throttled);
+
+    std::lock_guard<std::mutex> lock{mutex_};
+    aggregate_.peak_utilization = std::max(aggregate_.peak_utilization, utilization);
+    aggregate_.histogram[bucket]++;
+    aggregate_.samples++;
+    aggregate_.throttled_samples += throttled > 0 ? 1 : 0;
+}
+
+void CpuBurstSampler::publish() noexcept
+{
+    Aggregate agg;
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        std::swap(agg, aggregate_);
+    }
+    if (agg.samples == 0)
+    {
+        return;
+    }
+
+    registry_->CreateMaxGauge("cgroup.cpu.burstUtilization").Set(agg.peak_utilization);
+    for (size_t i = 0; i < agg.histogram.size(); ++i)
+    {
+        if (agg.histogram[i] == 0)
+        {
+            continue;
+        }
+        auto le = i < kBuckets.size() ? std::to_string(kBuckets[i]) : "inf";
+        registry_->CreateCounter("cgroup.cpu.burstSamples", {{"le", le}}).Increment(agg.histogram[i]);
+    }
+    registry_->CreateCounter("cgroup.cpu.burstThrottledSamples").Increment(agg.throttled_samples);
+    registry_->CreateCounter("cgroup.cpu.burstSamplerTime").Increment(agg.sampler_seconds);
+}
+
+}  // namespace atlasagent
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <lib/files/src/files.h>
+#include <thirdparty/spectator-cpp/spectator/registry.h>
+
+#include <absl/time/clock.h>
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace atlasagent
+{
+
+// Samples the container's cpu.stat every 100ms or less from a background thread, to catch bursts that
+// the 1s peak utilization averages away. Every sample is folded into a small fixed-size aggregate:
+// the peak utilization, a histogram of utilization, and how many samples saw throttling. So memory
+// use does not depend on the sampling rate. The 5s loop publishes and resets the aggregate.
+//
+// Utilization is relative to the cpu.max quota (TITUS_NUM_CPU, then the online cpus, when there is no
+// quota), so short bursts above 100% show where cpu.max.burst is absorbing them. The CPU time the
+// sampler spends is published too, so the cost of enabling it fleet-wide can be checked.
+//
+// Opt-in: enabled by setting ATLAS_CPU_BURST_SAMPLE_MS to an interval between 10 and 100.
+class CpuBurstSampler
+{
+   public:
+    // Upper bounds, in percent, of the utilization histogram buckets. The last bucket is unbounded.
+    static constexpr std::array<int, 6> kBuckets{25, 50, 75, 90, 100, 125};
+
+    CpuBurstSampler(Registry* registry, std::string path_prefix, absl::Duration interval) noexcept;
+    ~CpuBurstSampler();
+
+    CpuBurstSampler(const CpuBurstSampler&) = delete;
+    CpuBurstSampler& operator=(const CpuBurstSampler&) = delete;
+
+    static std::unique_ptr<CpuBurstSampler> Create(Registry* registry);
+    static void Collect(const std::unique_ptr<CpuBurstSampler>& self);
+
+    void start() noexcept;
+    void publish() noexcept;
+
+   protected:
+    // Fold one cpu.stat reading taken at `now` into the aggregate. capacity is the number of cpus
+    // the container may use.
+    void sample(absl::Time now, std::string_view cpu_stat, double capacity) noexcept;
+    double capacity() const noexcept;
+
+   private:
+    void run() noexcept;
+
+    struct Reading
+    {
+        absl::Time when;
+        int64_t usage_usec{-1};
+        int64_t nr_throttled{-1};
+    };
+
+    struct Aggregate
+    {
+        double peak_utilization{-1};
+        std::array<int64_t, kBuckets.size() + 1> histogram{};
+        int64_t samples{0};
+        int64_t throttled_samples{0};
+        double sampler_seconds{0};
+    };
+
+    Registry* registry_;
+    std::string path_prefix_;
+    absl::Duration interval_;
+    UnixFile cpu_stat_{-1};
+    Reading prev_;
+
+    std::mutex mutex_;  // guards aggregate_ and stop_
+    std::condition_variable cv_;
+    Aggregate aggregate_;
+    bool stop_{false};
+    std::thread thread_;
+};
+
+}  // namespace atlasagent
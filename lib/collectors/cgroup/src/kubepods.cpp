@@ -0,0 +1,390 @@
+#include "kubepods.h"
+
+#include <lib/util/src/util.h>
+
+#include <algorithm>
+#include <charconv>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace atlasagent
+{
+
+constexpr auto MICROS = 1000 * 1000.0;
+
+std::optional<KubeContainer> parse_kube_container(std::string_view pod_slice, std::string_view scope) noexcept
+{
+    static constexpr std::string_view kSlice = ".slice";
+    static constexpr std::string_view kScope = ".scope";
+    auto pod = pod_slice.rfind("-pod");
+    if (!pod_slice.ends_with(kSlice) || !scope.ends_with(kScope) || pod == std::string_view::npos)
+    {
+        return std::nullopt;
+    }
+
+    KubeContainer c;
+    // systemd escapes the '-' in pod uids as '_'
+    c.pod_uid = pod_slice.substr(pod + 4, pod_slice.size() - kSlice.size() - pod - 4);
+    std::replace(c.pod_uid.begin(), c.pod_uid.end(), '_', '-');
+
+    // cri-containerd-<id>.scope, crio-<id>.scope, docker-<id>.scope
+    auto id = scope.substr(0, scope.size() - kScope.size());
+    auto dash = id.rfind('-');
+    c.container_id = dash == std::string_view::npos ? id : id.substr(dash + 1);
+
+    if (pod_slice.starts_with("kubepods-burstable-"))
+    {
+        c.qos = "burstable";
+    }
+    else if (pod_slice.starts_with("kubepods-besteffort-"))
+    {
+        c.qos = "besteffort";
+    }
+    else
+    {
+        c.qos = "guaranteed";
+    }
+
+    if (c.pod_uid.empty() || c.container_id.empty())
+    {
+        return std::nullopt;
+    }
+    return c;
+}
+
+namespace
+{
+// CPU time used by the calling thread, so time spent blocked on a slow cgroupfs read does not count
+// against the budget
+absl::Duration thread_cpu_time()
+{
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return absl::DurationFromTimespec(ts);
+}
+
+// Read a small cgroup control file relative to a cached directory fd. Returns the bytes read, or -1.
+ssize_t read_at(int dirfd, const char* name, char* buf, size_t size)
+{
+    UnixFile fd{openat(dirfd, name, O_RDONLY | O_CLOEXEC)};
+    if (fd < 0)
+    {
+        return -1;
+    }
+    auto n = pread(fd, buf, size - 1, 0);
+    buf[n < 0 ? 0 : n] = '\0';
+    return n;
+}
+
+// Read all of a file into `buf`, which only grows, so files longer than a fixed buffer (io.stat
+// on a pod with many devices) are not cut off mid-line.
+std::string_view read_all_at(int dirfd, const char* name, std::string& buf)
+{
+    UnixFile fd{openat(dirfd, name, O_RDONLY | O_CLOEXEC)};
+    if (fd < 0)
+    {
+        return {};
+    }
+    if (buf.empty())
+    {
+        buf.resize(4096);
+    }
+    size_t len = 0;
+    ssize_t n;
+    while ((n = pread(fd, buf.data() + len, buf.size() - len, static_cast<off_t>(len))) > 0)
+    {
+        len += static_cast<size_t>(n);
+        if (len == buf.size())
+        {
+            buf.resize(len * 2);
+        }
+    }
+    if (n < 0)
+    {
+        return {};
+    }
+    return {buf.data(), len};
+}
+
+int64_t to_int64(std::string_view s)
+{
+    int64_t v = -1;
+    std::from_chars(s.data(), s.data() + s.size(), v);
+    return v;
+}
+
+// Invoke f(key, value) for each "key value" line of a flat-keyed file such as cpu.stat.
+template <typename F>
+void for_each_kv(std::string_view buf, F f)
+{
+    while (!buf.empty())
+    {
+        auto eol = buf.find('\n');
+        auto line = buf.substr(0, eol);
+        auto sp = line.find(' ');
+        if (sp != std::string_view::npos)
+        {
+            f(line.substr(0, sp), to_int64(line.substr(sp + 1)));
+        }
+        if (eol == std::string_view::npos)
+        {
+            break;
+        }
+        buf.remove_prefix(eol + 1);
+    }
+}
+
+// total= of the "some" line of a PSI file, in microseconds
+int64_t psi_some_total(std::string_view buf)
+{
+    if (!buf.starts_with("some"))
+    {
+        return -1;
+    }
+    auto line = buf.substr(0, buf.find('\n'));
+    auto total = line.find("total=");
+    return total == std::string_view::npos ? -1 : to_int64(line.substr(total + 6));
+}
+
+// `scale` also spreads a delta that spans several collections (a container skipped when the budget
+// ran out) over those collections, so a single interval never reports more than its share
+void add_delta(int64_t cur, int64_t* prev, Counter& counter, double scale)
+{
+    if (cur >= 0 && *prev >= 0 && cur >= *prev)
+    {
+        counter.Increment(static_cast<double>(cur - *prev) * scale);
+    }
+    *prev = cur;
+}
+}  // namespace
+
+KubePods::KubePods(Registry* registry, std::string root, absl::Duration budget) noexcept
+    : registry_{registry}, root_{std::move(root)}, budget_{budget}, watcher_{root_, 3}
+{
+}
+
+std::optional<KubePods> KubePods::Create(Registry* registry)
+{
+    constexpr auto root = "/sys/fs/cgroup/kubepods.slice";
+    struct stat st;
+    if (stat(root, &st) != 0 || !S_ISDIR(st.st_mode))
+    {
+        Logger()->info("{} not found, node-level pod metrics are disabled", root);
+        return std::nullopt;
+    }
+    return KubePods{registry, root};
+}
+
+void KubePods::Collect(std::optional<KubePods>& self)
+{
+    if (self.has_value())
+    {
+        self->collect();
+    }
+}
+
+KubePods::Entry KubePods::make_entry(std::string path, uint64_t id, UnixFile dirfd, const KubeContainer& c) const
+{
+    auto tags = std::unordered_map<std::string, std::string>{
+        {"pod.uid", c.pod_uid}, {"container.id", c.container_id}, {"qos", c.qos}};
+    auto with_id = [&tags](const char* id)
+    {
+        auto t = tags;
+        t.emplace("id", id);
+        return t;
+    };
+
+    Entry e{std::move(path),
+            id,
+            std::move(dirfd),
+            0,
+            -1,
+            -1,
+            -1,
+            -1,
+            -1,
+            registry_->CreateCounter("k8s.container.cpu.usageTime", with_id("user")),
+            registry_->CreateCounter("k8s.container.cpu.usageTime", with_id("system")),
+            registry_->CreateCounter("k8s.container.cpu.throttledTime", tags),
+            registry_->CreateCounter("k8s.container.io.bytes", with_id("read")),
+            registry_->CreateCounter("k8s.container.io.bytes", with_id("write")),
+            registry_->CreateGauge("k8s.container.mem.used", tags),
+            registry_->CreateGauge("k8s.container.mem.limit", tags),
+            registry_->CreateMonotonicCounter("k8s.container.pressure.some", with_id("cpu")),
+            registry_->CreateMonotonicCounter("k8s.container.pressure.some", with_id("io")),
+            registry_->CreateMonotonicCounter("k8s.container.pressure.some", with_id("memory"))};
+    return e;
+}
+
+// kubepods.slice/[kubepods-<qos>.slice/]kubepods-[<qos>-]pod<uid>.slice/<runtime>-<id>.scope
+void KubePods::add(const std::string& path, uint64_t id) noexcept
+{
+    auto slash = path.rfind('/');
+    if (slash == std::string::npos)
+    {
+        return;
+    }
+    auto parent = std::string_view{path}.substr(0, slash);
+    parent = parent.substr(parent.rfind('/') + 1);
+    auto c = parse_kube_container(parent, std::string_view{path}.substr(slash + 1));
+    if (!c)
+    {
+        return;
+    }
+
+    // the same cgroup seen again (e.g. after a watcher rescan) keeps its deltas, while one recreated at
+    // the same path, which has a new id, starts over so deltas do not span two containers
+    auto it = index_.find(path);
+    if (it != index_.end() && entries_[it->second].id == id)
+    {
+        return;
+    }
+
+    auto full_path = fmt::format("{}/{}", root_, path);
+    UnixFile fd{open(full_path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+    if (fd < 0)
+    {
+        return;
+    }
+    if (it != index_.end())
+    {
+        entries_[it->second] = make_entry(path, id, std::move(fd), *c);
+        return;
+    }
+    index_.emplace(path, entries_.size());
+    entries_.emplace_back(make_entry(path, id, std::move(fd), *c));
+}
+
+void KubePods::remove(const std::string& path) noexcept
+{
+    auto it = index_.find(path);
+    if (it == index_.end())
+    {
+        return;
+    }
+    // swap the last row into the hole to keep the table flat
+    auto slot = it->second;
+    index_.erase(it);
+    if (slot != entries_.size() - 1)
+    {
+        entries_[slot] = std::move(entries_.back());
+        index_[entries_[slot].path] = slot;
+    }
+    entries_.pop_back();
+}
+
+void KubePods::discover() noexcept
+{
+    for (const auto& ev : watcher_.poll())
+    {
+        if (ev.kind == CgroupEvent::Kind::Created)
+        {
+            add(ev.path, ev.id);
+        }
+        else
+        {
+            remove(ev.path);
+        }
+    }
+}
+
+void KubePods::update(Entry& e) noexcept
+{
+    char buf[4096];
+    // the number of collections since this container was last updated
+    auto intervals = e.pass == 0 ? 1.0 : static_cast<double>(passes_ - e.pass);
+    e.pass = passes_;
+
+    if (read_at(e.dirfd, "cpu.stat", buf, sizeof buf) > 0)
+    {
+        int64_t user = -1, system = -1, throttled = -1;
+        for_each_kv(buf,
+                    [&](std::string_view key, int64_t value)
+                    {
+                        if (key == "user_usec")
+                            user = value;
+                        else if (key == "system_usec")
+                            system = value;
+                        else if (key == "throttled_usec")
+                            throttled = value;
+                    });
+        add_delta(user, &e.user_usec, e.cpu_user, 1 / MICROS / intervals);
+        add_delta(system, &e.system_usec, e.cpu_system, 1 / MICROS / intervals);
+        add_delta(throttled, &e.throttled_usec, e.cpu_throttled, 1 / MICROS / intervals);
+    }
+
+    if (read_at(e.dirfd, "memory.current", buf, sizeof buf) > 0)
+    {
+        e.mem_used.Set(static_cast<double>(to_int64(buf)));
+    }
+    // "max" when the container has no limit
+    if (read_at(e.dirfd, "memory.max", buf, sizeof buf) > 0)
+    {
+        if (auto limit = to_int64(buf); limit >= 0)
+        {
+            e.mem_limit.Set(static_cast<double>(limit));
+        }
+    }
+
+    if (auto sv = read_all_at(e.dirfd, "io.stat", io_stat_buf_); !sv.empty())
+    {
+        // one line per device: "259:0 rbytes=N wbytes=N rios=N ..."
+        int64_t rbytes = 0, wbytes = 0;
+        for (auto pos = sv.find("rbytes="); pos != std::string_view::npos; pos = sv.find("rbytes=", pos + 1))
+        {
+            rbytes += std::max<int64_t>(0, to_int64(sv.substr(pos + 7)));
+        }
+        for (auto pos = sv.find("wbytes="); pos != std::string_view::npos; pos = sv.find("wbytes=", pos + 1))
+        {
+            wbytes += std::max<int64_t>(0, to_int64(sv.substr(pos + 7)));
+        }
+        add_delta(rbytes, &e.rbytes, e.io_read, 1 / intervals);
+        add_delta(wbytes, &e.wbytes, e.io_write, 1 / intervals);
+    }
+
+    const std::pair<const char*, MonotonicCounter*> pressures[] = {
+        {"cpu.pressure", &e.pressure_cpu}, {"io.pressure", &e.pressure_io}, {"memory.pressure", &e.pressure_memory}};
+    for (const auto& [file, counter] : pressures)
+    {
+        if (read_at(e.dirfd, file, buf, sizeof buf) > 0)
+        {
+            if (auto total = psi_some_total(buf); total >= 0)
+            {
+                counter->Set(total / MICROS);
+            }
+        }
+    }
+}
+
+void KubePods::collect() noexcept
+{
+    auto start = thread_cpu_time();
+    ++passes_;
+    discover();
+    if (entries_.empty())
+    {
+        return;
+    }
+
+    cursor_ %= entries_.size();
+    size_t visited = 0;
+    while (visited < entries_.size())
+    {
+        update(entries_[(cursor_ + visited) % entries_.size()]);
+        ++visited;
+        if (thread_cpu_time() - start > budget_)
+        {
+            break;
+        }
+    }
+    if (visited < entries_.size())
+    {
+        Logger()->debug("Updated {} of {} pod containers within the {} cpu budget", visited, entries_.size(),
+                        absl::FormatDuration(budget_));
+    }
+    cursor_ = (cursor_ + visited) % entries_.size();
+}
+
+}  // namespace atlasagent
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <lib/collectors/cgroup/src/cgroup_watcher.h>
+#include <lib/files/src/files.h>
+#include <thirdparty/spectator-cpp/spectator/registry.h>
+
+#include <absl/time/clock.h>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace atlasagent
+{
+
+// The pod and container a kubepods cgroup belongs to, parsed from the systemd unit names, e.g.
+// kubepods-burstable-pod<uid>.slice / cri-containerd-<id>.scope.
+struct KubeContainer
+{
+    std::string pod_uid;
+    std::string container_id;
+    std::string qos;
+};
+
+std::optional<KubeContainer> parse_kube_container(std::string_view pod_slice, std::string_view scope) noexcept;
+
+// Node-level collector for every pod container under kubepods.slice. Unlike CGroup, which reports on
+// the single cgroup the agent runs in, this walks the whole kubepods hierarchy and keeps one row of
+// state per container cgroup in a flat table: an open directory fd (files are read with openat, so
+// paths are never rebuilt), the previous counters for deltas, and the meter handles. Containers are
+// discovered from CgroupWatcher events rather than by rescanning, and a row (with its meters) is dropped
+// as soon as its cgroup is removed.
+//
+// Each collection stops once it has used its CPU time budget and resumes with the next container on
+// the following call, so a node with thousands of pods cannot stall the agent's 60s loop. Time spent
+// blocked on cgroupfs does not count, so in practice every container is updated on every call; a
+// container that was skipped has its deltas spread over the collections it missed.
+class KubePods
+{
+   public:
+    explicit KubePods(Registry* registry, std::string root = "/sys/fs/cgroup/kubepods.slice",
+                      absl::Duration budget = absl::Milliseconds(250)) noexcept;
+
+    // Availability-aware factory: only builds the collector when the kubepods hierarchy is visible,
+    // i.e. the agent runs in the host cgroup namespace of a k8s node.
+    static std::optional<KubePods> Create(Registry* registry);
+    static void Collect(std::optional<KubePods>& self);
+
+    void collect() noexcept;
+    [[nodiscard]] size_t size() const noexcept { return entries_.size(); }
+
+   protected:
+    void discover() noexcept;
+    void add(const std::string& path, uint64_t id) noexcept;
+
+   private:
+    struct Entry
+    {
+        std::string path;  // relative to root_
+        uint64_t id{};     // kernel cgroup id
+        UnixFile dirfd{-1};
+        uint64_t pass{0};  // the collection that last updated this entry, 0 before the first
+
+        int64_t user_usec{-1};
+        int64_t system_usec{-1};
+        int64_t throttled_usec{-1};
+        int64_t rbytes{-1};
+        int64_t wbytes{-1};
+
+        Counter cpu_user;
+        Counter cpu_system;
+        Counter cpu_throttled;
+        Counter io_read;
+        Counter io_write;
+        Gauge mem_used;
+        Gauge mem_limit;
+        MonotonicCounter pressure_cpu;
+        MonotonicCounter pressure_io;
+        MonotonicCounter pressure_memory;
+    };
+
+    Entry make_entry(std::string path, uint64_t id, UnixFile dirfd, const KubeContainer& c) const;
+    void remove(const std::string& path) noexcept;
+    void update(Entry& e) noexcept;
+
+    Registry* registry_;
+    std::string root_;
+    absl::Duration budget_;
+    CgroupWatcher watcher_;
+    std::vector<Entry> entries_;
+    std::unordered_map<std::string, size_t> index_;  // path -> slot in entries_
+    size_t cursor_{0};                               // next entry to update when the budget ran out
+    uint64_t passes_{0};                             // collections so far
+    std::string io_stat_buf_;                        // reused across containers, grows to the longest io.stat
+};
+
+}  // namespace atlasagent
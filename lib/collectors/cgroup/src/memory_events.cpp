@@ -0,0 +1,103 @@
+#include "memory_events.h"
+
+#include <lib/util/src/util.h>
+
+#include <cstring>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace atlasagent
+{
+
+MemoryEvents::MemoryEvents(Registry* registry, std::string path_prefix) noexcept
+    : registry_{registry}, path_prefix_{std::move(path_prefix)}
+{
+    // the baseline, so the first notification only reports what happened after startup
+    parse_kv_from_file(path_prefix_, "memory.events", &prev_);
+    if (prev_.empty())
+    {
+        return;
+    }
+
+    inotify_ = UnixFile{inotify_init1(IN_NONBLOCK | IN_CLOEXEC)};
+    stop_ = UnixFile{eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)};
+    auto path = fmt::format("{}/memory.events", path_prefix_);
+    if (inotify_ < 0 || stop_ < 0 || inotify_add_watch(inotify_, path.c_str(), IN_MODIFY) < 0)
+    {
+        Logger()->info("Unable to watch {} ({}), memory events are reported once a minute", path, strerror(errno));
+        return;
+    }
+    thread_ = std::thread{&MemoryEvents::run, this};
+}
+
+MemoryEvents::~MemoryEvents()
+{
+    if (thread_.joinable())
+    {
+        uint64_t one = 1;
+        if (write(stop_, &one, sizeof one) < 0)
+        {
+            Logger()->warn("Unable to stop the memory.events watcher: {}", strerror(errno));
+        }
+        thread_.join();
+    }
+}
+
+void MemoryEvents::run() noexcept
+{
+    pollfd fds[2] = {{inotify_, POLLIN, 0}, {stop_, POLLIN, 0}};
+    alignas(inotify_event) char buf[4096];
+    for (;;)
+    {
+        if (::poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            Logger()->error("Polling for memory.events changes failed: {}", strerror(errno));
+            return;
+        }
+        if (fds[1].revents != 0)
+        {
+            return;
+        }
+        // any number of queued modifications collapse into a single reread
+        while (read(inotify_, buf, sizeof buf) > 0)
+        {
+        }
+        update();
+    }
+}
+
+void MemoryEvents::update() noexcept
+{
+    std::unordered_map<std::string, int64_t> events;
+    parse_kv_from_file(path_prefix_, "memory.events", &events);
+
+    for (const auto* field : kMemoryEventFields)
+    {
+        auto it = events.find(field);
+        if (it == events.end())
+        {
+            continue;
+        }
+        registry_->CreateMonotonicCounter("cgroup.mem.events", {{"id", field}}).Set(it->second);
+
+        auto& prev = prev_[field];
+        if (it->second > prev)
+        {
+            registry_->CreateAgeGauge("cgroup.mem.lastEvent", {{"id", field}}).Now();
+            if (std::string_view{field}.starts_with("oom"))
+            {
+                Logger()->warn("memory.events: {} increased by {} in {}", field, it->second - prev, path_prefix_);
+            }
+        }
+        prev = it->second;
+    }
+    updates_.fetch_add(1, std::memory_order_release);
+}
+
+}  // namespace atlasagent
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <lib/files/src/files.h>
+#include <thirdparty/spectator-cpp/spectator/registry.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace atlasagent
+{
+
+// Fields of memory.events, in the order the kernel writes them. oom_group_kill exists since 5.17.
+inline constexpr const char* kMemoryEventFields[] = {"low", "high", "max", "oom", "oom_kill", "oom_group_kill"};
+
+// Tracks memory.events as it changes instead of once a minute. cgroup v2 raises a file modified event
+// on memory.events whenever one of its counters moves, so a thread blocks on an inotify watch for it
+// and republishes the counters as soon as the kernel bumps them. Every field that increased also sets
+// an age gauge, cgroup.mem.lastEvent, which gives the time of the last OOM kill or memory.high
+// throttling event to the millisecond and lines up with latency graphs.
+//
+// Without inotify, the counters are still published once a minute by CGroup::MemoryStatsV2.
+class MemoryEvents
+{
+   public:
+    explicit MemoryEvents(Registry* registry, std::string path_prefix = "/sys/fs/cgroup") noexcept;
+    ~MemoryEvents();
+
+    MemoryEvents(const MemoryEvents&) = delete;
+    MemoryEvents& operator=(const MemoryEvents&) = delete;
+
+    [[nodiscard]] bool watching() const noexcept { return thread_.joinable(); }
+    [[nodiscard]] uint64_t updates() const noexcept { return updates_.load(std::memory_order_acquire); }
+
+   protected:
+    // Read memory.events and publish what changed since the previous read.
+    void update() noexcept;
+
+   private:
+    void run() noexcept;
+
+    Registry* registry_;
+    std::string path_prefix_;
+    std::unordered_map<std::string, int64_t> prev_;
+    UnixFile inotify_{-1};
+    UnixFile stop_{-1};  // eventfd that wakes the thread on shutdown
+    std::atomic<uint64_t> updates_{0};
+    std::thread thread_;
+};
+
+}  // namespace atlasagent
@@ -1,9 +1,16 @@
 #include <lib/collectors/cgroup/src/cgroup.h>
+#include <lib/collectors/cgroup/src/cgroup_watcher.h>
+#include <lib/collectors/cgroup/src/cpu_burst_sampler.h>
+#include <lib/collectors/cgroup/src/kubepods.h>
+#include <lib/collectors/cgroup/src/memory_events.h>
 #include <lib/util/src/util.h>
 #include <gtest/gtest.h>
 #include <thirdparty/spectator-cpp/spectator/registry.h>
 #include <thirdparty/spectator-cpp/libs/writer/writer_wrapper/writer_test_helper.h>
 
+#include <filesystem>
+#include <fstream>
+#include <thread>
 #include <utility>
 
 class CGroupTest : public atlasagent::CGroup
@@ -17,13 +24,39 @@ class CGroupTest : public atlasagent::CGroup
     // Expose protected members and methods for testing
     using CGroup::CpuPeakUtilizationV2;
     using CGroup::CpuProcessingCapacity;
+    using CGroup::CpuBurstV2;
     using CGroup::CpuThrottleV2;
     using CGroup::CpuTimeV2;
     using CGroup::CpuUtilizationV2;
+    using CGroup::GetCpuLimits;
     using CGroup::GetNumCpu;
+    using CGroup::block_devices_;
+    using CGroup::io_devices_;
     using CGroup::path_prefix_;
 };
 
+class KubePodsTest : public atlasagent::KubePods
+{
+   public:
+    explicit KubePodsTest(Registry* registry, std::string root,
+                          absl::Duration budget = absl::Milliseconds(250)) noexcept
+        : KubePods(registry, std::move(root), budget)
+    {
+    }
+    using KubePods::add;
+    using KubePods::discover;
+};
+
+class CpuBurstSamplerTest : public atlasagent::CpuBurstSampler
+{
+   public:
+    explicit CpuBurstSamplerTest(Registry* registry) noexcept
+        : CpuBurstSampler(registry, "lib/collectors/cgroup/test/resources/sample1", absl::Milliseconds(100))
+    {
+    }
+    using CpuBurstSampler::sample;
+};
+
 inline double megabits2bytes(int mbits) { return mbits * 125000; }
 
 TEST(CGroup, Net)
@@ -116,10 +149,11 @@ TEST(CGroup, CpuUtilizationV2)
 
     auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
     auto messages = memoryWriter->GetMessages();
-    EXPECT_EQ(messages.size(), 3);
+    EXPECT_EQ(messages.size(), 4);
     EXPECT_EQ(messages.at(0), "g:cgroup.cpu.weight:100.000000\n");
-    EXPECT_EQ(messages.at(1), "g:sys.cpu.numProcessors:1.000000\n");
-    EXPECT_EQ(messages.at(2), "g:titus.cpu.requested:1.000000\n");
+    EXPECT_EQ(messages.at(1), "g:cgroup.cpu.idle:0.000000\n");
+    EXPECT_EQ(messages.at(2), "g:sys.cpu.numProcessors:1.000000\n");
+    EXPECT_EQ(messages.at(3), "g:titus.cpu.requested:1.000000\n");
     memoryWriter->Clear();
 
     // Second call after 60 seconds to compute utilization
@@ -128,12 +162,42 @@ TEST(CGroup, CpuUtilizationV2)
     cGroup.CpuUtilizationV2(baseTime + absl::Seconds(60), cpuCount, stats, absl::Seconds(60));
 
     messages = memoryWriter->GetMessages();
-    EXPECT_EQ(messages.size(), 5);
+    EXPECT_EQ(messages.size(), 6);
     EXPECT_EQ(messages.at(0), "g:cgroup.cpu.weight:100.000000\n");
-    EXPECT_EQ(messages.at(1), "g:sys.cpu.numProcessors:1.000000\n");
-    EXPECT_EQ(messages.at(2), "g:titus.cpu.requested:1.000000\n");
-    EXPECT_EQ(messages.at(3), "g:sys.cpu.utilization,id=system:66.666667\n");
-    EXPECT_EQ(messages.at(4), "g:sys.cpu.utilization,id=user:33.333333\n");
+    EXPECT_EQ(messages.at(1), "g:cgroup.cpu.idle:0.000000\n");
+    EXPECT_EQ(messages.at(2), "g:sys.cpu.numProcessors:1.000000\n");
+    EXPECT_EQ(messages.at(3), "g:titus.cpu.requested:1.000000\n");
+    EXPECT_EQ(messages.at(4), "g:sys.cpu.utilization,id=system:66.666667\n");
+    EXPECT_EQ(messages.at(5), "g:sys.cpu.utilization,id=user:33.333333\n");
+}
+
+TEST(CGroup, CpuLimitsCache)
+{
+    auto dir = std::filesystem::temp_directory_path() / "cgroup_test_cpu_limits";
+    std::filesystem::create_directories(dir / "a");
+    std::filesystem::create_directories(dir / "b");
+    std::ofstream{dir / "a" / "cpu.max"} << "200000 100000\n";
+    std::ofstream{dir / "b" / "cpu.max"} << "max 50000\n";
+
+    auto config = Config(WriterConfig(WriterTypes::Memory));
+    Registry registry(config);
+    CGroupTest cGroup{&registry, (dir / "a").string()};
+
+    auto now = absl::Now();
+    EXPECT_EQ(cGroup.GetCpuLimits(now).cfs_quota_usec, 200000);
+
+    // the limits are only reread once a minute
+    std::ofstream{dir / "a" / "cpu.max"} << "400000 100000\n";
+    EXPECT_EQ(cGroup.GetCpuLimits(now + absl::Seconds(59)).cfs_quota_usec, 200000);
+    EXPECT_EQ(cGroup.GetCpuLimits(now + absl::Seconds(60)).cfs_quota_usec, 400000);
+
+    // a new prefix is read right away
+    cGroup.SetPrefix((dir / "b").string());
+    const auto& limits = cGroup.GetCpuLimits(now + absl::Seconds(61));
+    EXPECT_EQ(limits.cfs_period_usec, 50000);
+    EXPECT_EQ(limits.cfs_quota_usec, -1);
+
+    std::filesystem::remove_all(dir);
 }
 
 TEST(CGroup, CpuTimeV2)
@@ -162,6 +226,35 @@ TEST(CGroup, CpuTimeV2)
     EXPECT_EQ(messages.at(2), "c:cgroup.cpu.usageTime,id=user:20.000000\n");
 }
 
+TEST(CGroup, CpuBurstV2)
+{
+    auto config = Config(WriterConfig(WriterTypes::Memory));
+    Registry registry(config);
+    CGroupTest cGroup{&registry, "lib/collectors/cgroup/test/resources/sample1"};
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    memoryWriter->Clear();
+
+    std::unordered_map<std::string, int64_t> stats;
+    atlasagent::parse_kv_from_file(cGroup.path_prefix_, "cpu.stat", &stats);
+    cGroup.CpuBurstV2(stats, 1);
+    auto messages = memoryWriter->GetMessages();
+    EXPECT_EQ(messages.size(), 1);
+    EXPECT_EQ(messages.at(0), "C:cgroup.cpu.numBursts:0.000000\n");
+    memoryWriter->Clear();
+
+    // 1000 periods of 100ms with 60s of cpu used against a 1 cpu quota
+    cGroup.SetPrefix("lib/collectors/cgroup/test/resources/sample2");
+    atlasagent::parse_kv_from_file(cGroup.path_prefix_, "cpu.stat", &stats);
+    cGroup.CpuBurstV2(stats, 1);
+    messages = memoryWriter->GetMessages();
+    EXPECT_EQ(messages.size(), 5);
+    EXPECT_EQ(messages.at(0), "g:cgroup.cpu.throttleRatio:0.005000\n");
+    EXPECT_EQ(messages.at(1), "g:cgroup.cpu.periodUtilization:60.000000\n");
+    EXPECT_EQ(messages.at(2), "C:cgroup.cpu.numBursts:3.000000\n");
+    EXPECT_EQ(messages.at(3), "c:cgroup.cpu.burstTime:0.250000\n");
+    EXPECT_EQ(messages.at(4), "c:cgroup.cpu.forceIdleTime:0.100000\n");
+}
+
 TEST(CGroup, ProcessingTime)
 {
     auto config = Config(WriterConfig(WriterTypes::Memory));
@@ -226,30 +319,47 @@ TEST(CGroup, ParseMemoryV2)
     auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
     auto messages = memoryWriter->GetMessages();
 
-    EXPECT_EQ(messages.size(), 17);
+    EXPECT_EQ(messages.size(), 33);
 
     // memory_stats_v2
     EXPECT_EQ(messages.at(0), "g:cgroup.mem.used:7841374208.000000\n");
     EXPECT_EQ(messages.at(1), "g:cgroup.mem.limit:8589934592.000000\n");
     EXPECT_EQ(messages.at(2), "C:cgroup.mem.failures:0.000000\n");
-
-    EXPECT_EQ(messages.at(3), "g:cgroup.mem.processUsage,id=cache:11218944.000000\n");
-    EXPECT_EQ(messages.at(4), "g:cgroup.mem.processUsage,id=rss:1.000000\n");
-    EXPECT_EQ(messages.at(5), "g:cgroup.mem.processUsage,id=rss_huge:2.000000\n");
-    EXPECT_EQ(messages.at(6), "g:cgroup.mem.processUsage,id=mapped_file:0.000000\n");
-
-    EXPECT_EQ(messages.at(7), "C:cgroup.mem.pageFaults,id=minor:0.000000\n");
-    EXPECT_EQ(messages.at(8), "C:cgroup.mem.pageFaults,id=major:0.000000\n");
+    EXPECT_EQ(messages.at(3), "C:cgroup.mem.events,id=low:0.000000\n");
+    EXPECT_EQ(messages.at(4), "C:cgroup.mem.events,id=high:0.000000\n");
+    EXPECT_EQ(messages.at(5), "C:cgroup.mem.events,id=max:0.000000\n");
+    EXPECT_EQ(messages.at(6), "C:cgroup.mem.events,id=oom:0.000000\n");
+    EXPECT_EQ(messages.at(7), "C:cgroup.mem.events,id=oom_kill:0.000000\n");
+
+    EXPECT_EQ(messages.at(8), "g:cgroup.mem.processUsage,id=cache:11218944.000000\n");
+    EXPECT_EQ(messages.at(9), "g:cgroup.mem.processUsage,id=rss:1.000000\n");
+    EXPECT_EQ(messages.at(10), "g:cgroup.mem.processUsage,id=rss_huge:2.000000\n");
+    EXPECT_EQ(messages.at(11), "g:cgroup.mem.processUsage,id=mapped_file:0.000000\n");
+
+    EXPECT_EQ(messages.at(12), "C:cgroup.mem.pageFaults,id=minor:0.000000\n");
+    EXPECT_EQ(messages.at(13), "C:cgroup.mem.pageFaults,id=major:0.000000\n");
+
+    EXPECT_EQ(messages.at(14), "g:cgroup.mem.processUsage,id=shmem:135168.000000\n");
+    EXPECT_EQ(messages.at(15), "g:cgroup.mem.processUsage,id=dirty:0.000000\n");
+    EXPECT_EQ(messages.at(16), "g:cgroup.mem.processUsage,id=writeback:0.000000\n");
+    EXPECT_EQ(messages.at(17), "g:cgroup.mem.kernelUsage,id=slab:1466272.000000\n");
+    EXPECT_EQ(messages.at(18), "g:cgroup.mem.kernelUsage,id=sock:0.000000\n");
+    EXPECT_EQ(messages.at(19), "g:cgroup.mem.kernelUsage,id=kernel_stack:507904.000000\n");
+    EXPECT_EQ(messages.at(20), "g:cgroup.mem.kernelUsage,id=pagetables:684032.000000\n");
+    EXPECT_EQ(messages.at(21), "C:cgroup.mem.workingsetRefault,id=anon:0.000000\n");
+    EXPECT_EQ(messages.at(22), "C:cgroup.mem.workingsetRefault,id=file:0.000000\n");
+    EXPECT_EQ(messages.at(23), "C:cgroup.mem.reclaim,id=scan:0.000000\n");
+    EXPECT_EQ(messages.at(24), "C:cgroup.mem.reclaim,id=steal:0.000000\n");
 
     // memory_stats_std_v2
-    EXPECT_EQ(messages.at(9), "g:mem.cached:11218944.000000\n");
-    EXPECT_EQ(messages.at(10), "g:mem.shared:135168.000000\n");
-    EXPECT_EQ(messages.at(11), "g:mem.availReal:759779328.000000\n");
-    EXPECT_EQ(messages.at(12), "g:mem.freeReal:748560384.000000\n");
-    EXPECT_EQ(messages.at(13), "g:mem.totalReal:8589934592.000000\n");
-    EXPECT_EQ(messages.at(14), "g:mem.availSwap:536870912.000000\n");
-    EXPECT_EQ(messages.at(15), "g:mem.totalSwap:536870912.000000\n");
-    EXPECT_EQ(messages.at(16), "g:mem.totalFree:1296650240.000000\n");
+    EXPECT_EQ(messages.at(25), "g:mem.cached:11218944.000000\n");
+    EXPECT_EQ(messages.at(26), "g:mem.shared:135168.000000\n");
+    EXPECT_EQ(messages.at(27), "g:mem.availReal:759779328.000000\n");
+    EXPECT_EQ(messages.at(28), "g:mem.freeReal:748560384.000000\n");
+    EXPECT_EQ(messages.at(29), "g:mem.totalReal:8589934592.000000\n");
+    EXPECT_EQ(messages.at(30), "g:mem.availSwap:536870912.000000\n");
+    EXPECT_EQ(messages.at(31), "g:mem.totalSwap:536870912.000000\n");
+    EXPECT_EQ(messages.at(32), "g:mem.totalFree:1296650240.000000\n");
 }
 
 // Test case structure for invalid file tests
@@ -273,6 +383,155 @@ std::vector<InvalidFileTestCase> GetCommonInvalidTestCases(const std::string& pr
             {prefix + ".non_numeric", false, "non-numeric values"}};
 }
 
+TEST(CGroup, ControllerStats)
+{
+    auto config = Config(WriterConfig(WriterTypes::Memory));
+    Registry registry(config);
+    CGroupTest cGroup{&registry, "lib/collectors/cgroup/test/resources/sample1"};
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    memoryWriter->Clear();
+
+    cGroup.ControllerStats();
+    auto messages = memoryWriter->GetMessages();
+    auto expected = std::set<std::string>{"g:cgroup.pids.used:42.000000\n",
+                                          "g:cgroup.pids.limit:4096.000000\n",
+                                          "C:cgroup.pids.failures:7.000000\n",
+                                          "g:cgroup.hugetlb.used,size=2MB:0.000000\n",
+                                          "C:cgroup.hugetlb.failures,size=2MB:0.000000\n",
+                                          "g:cgroup.hugetlb.used,size=1GB:1073741824.000000\n",
+                                          "g:cgroup.hugetlb.limit,size=1GB:2147483648.000000\n",
+                                          "C:cgroup.hugetlb.failures,size=1GB:2.000000\n",
+                                          "g:cgroup.misc.used,id=res_a:3.000000\n",
+                                          "g:cgroup.misc.used,id=res_b:0.000000\n",
+                                          "g:cgroup.rdma.used,id=hca_handle,dev=mlx5_0:2.000000\n",
+                                          "g:cgroup.rdma.used,id=hca_object,dev=mlx5_0:100.000000\n"};
+    EXPECT_EQ(messages.size(), expected.size());
+    EXPECT_EQ(std::set<std::string>(messages.begin(), messages.end()), expected);
+}
+
+TEST(CGroup, ParseMemoryStat)
+{
+    char buf[] = "anon 1\nfile 2\nslab_reclaimable 3\nslab 4\npgscan 5\n";
+    auto fp = fmemopen(buf, sizeof buf - 1, "r");
+    auto stat = atlasagent::ParseMemoryStat(fp);
+    fclose(fp);
+
+    EXPECT_EQ(stat.anon, 1);
+    EXPECT_EQ(stat.file, 2);
+    EXPECT_EQ(stat.slab, 4);
+    EXPECT_EQ(stat.pgscan, 5);
+    // not reported by this kernel
+    EXPECT_EQ(stat.pgsteal, -1);
+    EXPECT_EQ(stat.workingset_refault_anon, -1);
+}
+
+TEST(CGroup, BlockDeviceNames)
+{
+    atlasagent::BlockDeviceNames names{"lib/collectors/cgroup/test/resources/dev_block"};
+    EXPECT_EQ(names.Lookup(259, 0), "nvme0n1");
+    EXPECT_FALSE(names.Lookup(123, 4).has_value());
+}
+
+TEST(CGroup, IODeviceReuse)
+{
+    namespace fs = std::filesystem;
+    auto root = fs::temp_directory_path() / "cgroup_io_reuse_test";
+    fs::remove_all(root);
+    fs::create_directories(root / "cgroup");
+    auto set_name = [&](const std::string& dev, const std::string& name)
+    {
+        fs::create_directories(root / "dev_block" / dev);
+        std::ofstream(root / "dev_block" / dev / "uevent") << "MAJOR=259\nDEVNAME=" << name << "\nDEVTYPE=disk\n";
+    };
+    auto set_io_stat = [&](const std::vector<std::pair<std::string, int>>& devices)
+    {
+        std::ofstream out(root / "cgroup" / "io.stat");
+        for (const auto& [dev, value] : devices)
+        {
+            out << fmt::format("{} rbytes={} wbytes={} rios={} wios={} dbytes=0 dios=0\n", dev, value, value, value,
+                               value);
+        }
+    };
+    auto names = [](const CGroupTest& cGroup)
+    {
+        std::vector<std::string> names;
+        for (const auto& dev : cGroup.io_devices_)
+        {
+            names.push_back(dev.name);
+        }
+        return names;
+    };
+
+    auto config = Config(WriterConfig(WriterTypes::Memory));
+    Registry registry(config);
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    CGroupTest cGroup{&registry, (root / "cgroup").string()};
+    cGroup.block_devices_ = atlasagent::BlockDeviceNames{(root / "dev_block").string()};
+    set_name("259:1", "nvme1n1");
+    set_name("259:2", "nvme2n1");
+
+    set_io_stat({{"259:1", 100}, {"259:2", 100}});
+    cGroup.IOStats();
+    memoryWriter->Clear();
+
+    // names are only looked up for devices that are new to io.stat
+    set_name("259:2", "renamed");
+    set_io_stat({{"259:1", 300}, {"259:2", 200}});
+    cGroup.IOStats();
+    EXPECT_EQ(names(cGroup), (std::vector<std::string>{"nvme1n1", "nvme2n1"}));
+    auto messages = memoryWriter->GetMessages();
+    EXPECT_EQ(messages.size(), 8);
+    EXPECT_TRUE(std::find(messages.begin(), messages.end(), "c:disk.io.bytes,id=read,dev=nvme2n1:100.000000\n") !=
+                messages.end());
+    memoryWriter->Clear();
+
+    // another volume attached on the same major:minor has counters that start over, so it is looked up
+    // again and starts from a new baseline under its own name
+    set_name("259:1", "nvme3n1");
+    set_io_stat({{"259:1", 10}, {"259:2", 200}});
+    cGroup.IOStats();
+    EXPECT_EQ(names(cGroup), (std::vector<std::string>{"nvme3n1", "nvme2n1"}));
+    memoryWriter->Clear();
+    set_io_stat({{"259:1", 60}, {"259:2", 200}});
+    cGroup.IOStats();
+    messages = memoryWriter->GetMessages();
+    EXPECT_TRUE(std::find(messages.begin(), messages.end(), "c:disk.io.bytes,id=read,dev=nvme3n1:50.000000\n") !=
+                messages.end());
+    memoryWriter->Clear();
+
+    // a device that leaves io.stat is forgotten, and looked up again when a device with its number shows up
+    set_io_stat({{"259:2", 200}});
+    cGroup.IOStats();
+    EXPECT_EQ(names(cGroup), (std::vector<std::string>{"nvme2n1"}));
+    set_name("259:1", "nvme4n1");
+    set_io_stat({{"259:2", 200}, {"259:1", 500}});
+    memoryWriter->Clear();
+    cGroup.IOStats();
+    EXPECT_EQ(names(cGroup), (std::vector<std::string>{"nvme2n1", "nvme4n1"}));
+    EXPECT_EQ(memoryWriter->GetMessages().size(), 4);  // 259:2 only, 259:1 just set its baseline
+    fs::remove_all(root);
+}
+
+// Parses every line of an io.stat file like CGroup::IOStats does: nothing when any line is malformed.
+static std::optional<std::vector<atlasagent::IOStatSample>> ParseIOStatFile(const std::string& path)
+{
+    std::vector<atlasagent::IOStatSample> samples;
+    std::ifstream in(path);
+    for (std::string line; std::getline(in, line);)
+    {
+        atlasagent::IOStatSample sample;
+        if (!atlasagent::ParseIOStatLine(line, &sample))
+        {
+            return std::nullopt;
+        }
+        if (sample.hasStats)
+        {
+            samples.push_back(sample);
+        }
+    }
+    return samples;
+}
+
 TEST(CGroup, InvalidIOStats)
 {
     auto testCases = GetCommonInvalidTestCases("io.stat");
@@ -281,30 +540,27 @@ TEST(CGroup, InvalidIOStats)
     // Extra fields (e.g. from io.cost) are now tolerated, so too_many_fields is valid for io.stat
     testCases.push_back({"io.stat.too_many_fields", true, "extra extension fields are tolerated"});
 
-    // Create a simple device map for testing
-    std::unordered_map<std::string, std::string> deviceMap = {{"8:0", "sda"}, {"8:1", "sda1"}, {"259:0", "nvme0n1"}};
-
     for (const auto& testCase : testCases)
     {
-        auto lines = atlasagent::read_lines_fields("lib/collectors/cgroup/test/resources/invalid_tests/io.stat/",
-                                                   testCase.filename.c_str());
-        auto result = atlasagent::ParseIOLines(lines, deviceMap);
+        auto result =
+            ParseIOStatFile("lib/collectors/cgroup/test/resources/invalid_tests/io.stat/" + testCase.filename);
 
         if (testCase.expectedResult)
         {
-            // For empty files, success means returning an empty map
+            ASSERT_TRUE(result.has_value()) << "io.stat should parse for " << testCase.description;
+            // For empty files, success means no devices
             if (testCase.filename == "io.stat.empty")
             {
-                EXPECT_TRUE(result.empty()) << "No data should be parsed from empty file";
+                EXPECT_TRUE(result->empty()) << "No data should be parsed from empty file";
             }
             else
             {
-                EXPECT_FALSE(result.empty()) << "ParseIOLines should return non-empty map for " << testCase.description;
+                EXPECT_FALSE(result->empty()) << "io.stat should have devices for " << testCase.description;
             }
         }
         else
         {
-            EXPECT_TRUE(result.empty()) << "ParseIOLines should return empty map for " << testCase.description;
+            EXPECT_FALSE(result.has_value()) << "io.stat should not parse for " << testCase.description;
         }
     }
 }
@@ -344,26 +600,20 @@ TEST(CGroup, InvalidIOMaxStats)
 
 TEST(CGroup, IOStatWithCostFields)
 {
-    std::unordered_map<std::string, std::string> deviceMap = {{"259:0", "nvme0n1"}};
-    auto lines = atlasagent::read_lines_fields("lib/collectors/cgroup/test/resources/sample_io_cost/", "io.stat");
-    auto result = atlasagent::ParseIOLines(lines, deviceMap);
-
-    ASSERT_FALSE(result.empty()) << "io.stat with cost fields should parse successfully";
-    ASSERT_NE(result.find("259:0"), result.end()) << "device 259:0 should be present";
-
-    const auto& entry = result.at("259:0");
-    ASSERT_TRUE(entry.rBytes.has_value());
-    EXPECT_EQ(*entry.rBytes, 40016384.0);
-    ASSERT_TRUE(entry.wBytes.has_value());
-    EXPECT_EQ(*entry.wBytes, 3842195456.0);
-    ASSERT_TRUE(entry.rOperations.has_value());
-    EXPECT_EQ(*entry.rOperations, 1074.0);
-    ASSERT_TRUE(entry.wOperations.has_value());
-    EXPECT_EQ(*entry.wOperations, 34821.0);
-    ASSERT_TRUE(entry.dBytes.has_value());
-    EXPECT_EQ(*entry.dBytes, 0.0);
-    ASSERT_TRUE(entry.dOperations.has_value());
-    EXPECT_EQ(*entry.dOperations, 0.0);
+    auto result = ParseIOStatFile("lib/collectors/cgroup/test/resources/sample_io_cost/io.stat");
+
+    ASSERT_TRUE(result.has_value()) << "io.stat with cost fields should parse successfully";
+    ASSERT_EQ(result->size(), 1) << "device 259:0 should be present";
+
+    const auto& entry = result->at(0);
+    EXPECT_EQ(entry.major, 259);
+    EXPECT_EQ(entry.minor, 0);
+    EXPECT_EQ(entry.rBytes, 40016384);
+    EXPECT_EQ(entry.wBytes, 3842195456);
+    EXPECT_EQ(entry.rOperations, 1074);
+    EXPECT_EQ(entry.wOperations, 34821);
+    EXPECT_EQ(entry.dBytes, 0);
+    EXPECT_EQ(entry.dOperations, 0);
 }
 
 TEST(CGroup, IOStats)
@@ -414,4 +664,315 @@ TEST(CGroup, IOStats)
     std::set<std::string> expectedSet(expectedMessages.begin(), expectedMessages.end());
 
     EXPECT_EQ(messageSet, expectedSet);
-}
\ No newline at end of file
+}
+
+TEST(KubePods, ParseContainer)
+{
+    auto c = atlasagent::parse_kube_container("kubepods-burstable-pod6f1a2b3c_4d5e_6789_abcd_ef0123456789.slice",
+                                              "cri-containerd-3c9f1e.scope");
+    ASSERT_TRUE(c.has_value());
+    EXPECT_EQ(c->pod_uid, "6f1a2b3c-4d5e-6789-abcd-ef0123456789");
+    EXPECT_EQ(c->container_id, "3c9f1e");
+    EXPECT_EQ(c->qos, "burstable");
+
+    c = atlasagent::parse_kube_container("kubepods-besteffort-pod1234.slice", "crio-abcd.scope");
+    ASSERT_TRUE(c.has_value());
+    EXPECT_EQ(c->qos, "besteffort");
+    EXPECT_EQ(c->container_id, "abcd");
+
+    c = atlasagent::parse_kube_container("kubepods-pod1234.slice", "docker-ef01.scope");
+    ASSERT_TRUE(c.has_value());
+    EXPECT_EQ(c->qos, "guaranteed");
+
+    EXPECT_FALSE(atlasagent::parse_kube_container("kubepods-burstable.slice", "cri-containerd-1.scope").has_value());
+    EXPECT_FALSE(atlasagent::parse_kube_container("kubepods-pod1234.slice", "init.scope-x").has_value());
+}
+
+TEST(KubePods, Discover)
+{
+    auto config = Config(WriterConfig(WriterTypes::Memory));
+    auto r = Registry(config);
+    KubePodsTest pods{&r, "lib/collectors/cgroup/test/resources/kubepods"};
+    pods.discover();
+    EXPECT_EQ(pods.size(), 2);
+    pods.discover();
+    EXPECT_EQ(pods.size(), 2);
+}
+
+TEST(KubePods, Collect)
+{
+    namespace fs = std::filesystem;
+    auto root = fs::temp_directory_path() / "kubepods_test";
+    fs::remove_all(root);
+    fs::copy("lib/collectors/cgroup/test/resources/kubepods", root, fs::copy_options::recursive);
+    auto scope = root / "kubepods-pod0a1b2c3d_0000_1111_2222_333344445555.slice" / "cri-containerd-7ab2d4.scope";
+    fs::remove_all(root / "kubepods-burstable.slice");
+
+    auto config = Config(WriterConfig(WriterTypes::Memory));
+    auto r = Registry(config);
+    KubePodsTest pods{&r, root.string()};
+
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    memoryWriter->Clear();
+    pods.collect();
+    EXPECT_EQ(pods.size(), 1);
+    // the first pass only primes the deltas: gauges and monotonic counters are reported, counters are not
+    EXPECT_EQ(memoryWriter->GetMessages().size(), 5);
+    memoryWriter->Clear();
+
+    std::ofstream(scope / "cpu.stat") << "usage_usec 8000000\nuser_usec 5000000\nsystem_usec 3000000\n"
+                                         "nr_periods 200\nnr_throttled 10\nthrottled_usec 750000\n";
+    std::ofstream(scope / "io.stat") << "259:0 rbytes=12288 wbytes=8192 rios=3 wios=2 dbytes=0 dios=0\n"
+                                        "253:0 rbytes=1024 wbytes=4096 rios=1 wios=1 dbytes=0 dios=0\n";
+    pods.collect();
+    auto messages = memoryWriter->GetMessages();
+    fs::remove_all(root);
+
+    auto expected = std::set<std::string>{
+        "C:k8s.container.pressure.some,id=cpu,qos=guaranteed,container.id=7ab2d4,pod.uid=0a1b2c3d-0000-1111-2222-333344445555:1.500000\n",
+        "C:k8s.container.pressure.some,id=io,qos=guaranteed,container.id=7ab2d4,pod.uid=0a1b2c3d-0000-1111-2222-333344445555:2.000000\n",
+        "C:k8s.container.pressure.some,id=memory,qos=guaranteed,container.id=7ab2d4,pod.uid=0a1b2c3d-0000-1111-2222-333344445555:0.000000\n",
+        "c:k8s.container.cpu.throttledTime,qos=guaranteed,container.id=7ab2d4,pod.uid=0a1b2c3d-0000-1111-2222-333344445555:0.500000\n",
+        "c:k8s.container.cpu.usageTime,id=system,qos=guaranteed,container.id=7ab2d4,pod.uid=0a1b2c3d-0000-1111-2222-333344445555:1.000000\n",
+        "c:k8s.container.cpu.usageTime,id=user,qos=guaranteed,container.id=7ab2d4,pod.uid=0a1b2c3d-0000-1111-2222-333344445555:2.000000\n",
+        "c:k8s.container.io.bytes,id=read,qos=guaranteed,container.id=7ab2d4,pod.uid=0a1b2c3d-0000-1111-2222-333344445555:8192.000000\n",
+        "c:k8s.container.io.bytes,id=write,qos=guaranteed,container.id=7ab2d4,pod.uid=0a1b2c3d-0000-1111-2222-333344445555:4096.000000\n",
+        "g:k8s.container.mem.limit,qos=guaranteed,container.id=7ab2d4,pod.uid=0a1b2c3d-0000-1111-2222-333344445555:536870912.000000\n",
+        "g:k8s.container.mem.used,qos=guaranteed,container.id=7ab2d4,pod.uid=0a1b2c3d-0000-1111-2222-333344445555:104857600.000000\n"};
+    EXPECT_EQ(std::set<std::string>(messages.begin(), messages.end()), expected);
+}
+
+TEST(KubePods, LargeIOStat)
+{
+    namespace fs = std::filesystem;
+    auto root = fs::temp_directory_path() / "kubepods_test_io";
+    fs::remove_all(root);
+    fs::copy("lib/collectors/cgroup/test/resources/kubepods", root, fs::copy_options::recursive);
+    auto scope = root / "kubepods-pod0a1b2c3d_0000_1111_2222_333344445555.slice" / "cri-containerd-7ab2d4.scope";
+    fs::remove_all(root / "kubepods-burstable.slice");
+
+    // far more than a page of devices, with the one that changes last
+    auto io_stat = [](int64_t last_rbytes)
+    {
+        std::string s;
+        for (int i = 0; i < 200; ++i)
+        {
+            auto rbytes = i == 199 ? last_rbytes : 1000000000;
+            s += fmt::format("259:{} rbytes={} wbytes=0 rios=1000 wios=0 dbytes=0 dios=0\n", i, rbytes);
+        }
+        return s;
+    };
+    std::ofstream(scope / "io.stat") << io_stat(1000000000);
+
+    auto config = Config(WriterConfig(WriterTypes::Memory));
+    auto r = Registry(config);
+    KubePodsTest pods{&r, root.string()};
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    pods.collect();
+    memoryWriter->Clear();
+
+    std::ofstream(scope / "io.stat") << io_stat(1000004096);
+    pods.collect();
+    auto messages = memoryWriter->GetMessages();
+    fs::remove_all(root);
+
+    EXPECT_TRUE(std::find(messages.begin(), messages.end(),
+                          "c:k8s.container.io.bytes,id=read,qos=guaranteed,container.id=7ab2d4,"
+                          "pod.uid=0a1b2c3d-0000-1111-2222-333344445555:4096.000000\n") != messages.end());
+}
+
+TEST(KubePods, SkippedContainer)
+{
+    namespace fs = std::filesystem;
+    auto root = fs::temp_directory_path() / "kubepods_skipped_test";
+    fs::remove_all(root);
+    fs::copy("lib/collectors/cgroup/test/resources/kubepods", root, fs::copy_options::recursive);
+    std::vector<fs::path> scopes{
+        root / "kubepods-burstable.slice" / "kubepods-burstable-pod6f1a2b3c_4d5e_6789_abcd_ef0123456789.slice" /
+            "cri-containerd-3c9f1e.scope",
+        root / "kubepods-pod0a1b2c3d_0000_1111_2222_333344445555.slice" / "cri-containerd-7ab2d4.scope"};
+
+    // with no budget each collection updates a single container
+    auto config = Config(WriterConfig(WriterTypes::Memory));
+    auto r = Registry(config);
+    KubePodsTest pods{&r, root.string(), absl::ZeroDuration()};
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    pods.collect();
+    pods.collect();
+    EXPECT_EQ(pods.size(), 2);
+
+    // the first container was skipped by the second collection, so its delta covers two of them
+    for (const auto& scope : scopes)
+    {
+        std::ofstream(scope / "cpu.stat") << "usage_usec 9000000\nuser_usec 5000000\nsystem_usec 4000000\n";
+    }
+    memoryWriter->Clear();
+    pods.collect();
+    auto messages = memoryWriter->GetMessages();
+    fs::remove_all(root);
+
+    std::vector<std::string> usage;
+    std::copy_if(messages.begin(), messages.end(), std::back_inserter(usage),
+                 [](const std::string& m) { return m.starts_with("c:k8s.container.cpu.usageTime,id=user"); });
+    ASSERT_EQ(usage.size(), 1);
+    EXPECT_TRUE(usage[0].ends_with(":1.000000\n")) << usage[0];
+}
+
+TEST(KubePods, RecreatedContainer)
+{
+    namespace fs = std::filesystem;
+    auto root = fs::temp_directory_path() / "kubepods_recreated_test";
+    fs::remove_all(root);
+    fs::copy("lib/collectors/cgroup/test/resources/kubepods", root, fs::copy_options::recursive);
+    fs::remove_all(root / "kubepods-burstable.slice");
+    std::string path = "kubepods-pod0a1b2c3d_0000_1111_2222_333344445555.slice/cri-containerd-7ab2d4.scope";
+    auto id = atlasagent::cgroup_id((root / path).c_str());
+
+    auto config = Config(WriterConfig(WriterTypes::Memory));
+    auto r = Registry(config);
+    KubePodsTest pods{&r, root.string()};
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    pods.collect();
+
+    auto user_usage = [&](int64_t user_usec)
+    {
+        std::ofstream(root / path / "cpu.stat") << "user_usec " << user_usec << "\n";
+        memoryWriter->Clear();
+        pods.collect();
+        auto messages = memoryWriter->GetMessages();
+        return std::count_if(messages.begin(), messages.end(), [](const std::string& m)
+                             { return m.starts_with("c:k8s.container.cpu.usageTime,id=user"); });
+    };
+
+    // seeing the same cgroup again keeps its previous counters
+    pods.add(path, id);
+    EXPECT_EQ(user_usage(4000000), 1);
+
+    // a different id at the same path is a new cgroup, so the next collection only primes the deltas
+    pods.add(path, id + 1);
+    EXPECT_EQ(pods.size(), 1);
+    EXPECT_EQ(user_usage(5000000), 0);
+    EXPECT_EQ(user_usage(6000000), 1);
+    fs::remove_all(root);
+}
+
+TEST(CgroupWatcher, Events)
+{
+    namespace fs = std::filesystem;
+    using Kind = atlasagent::CgroupEvent::Kind;
+    auto root = fs::temp_directory_path() / "cgroup_watcher_test";
+    fs::remove_all(root);
+    fs::create_directories(root / "a.slice" / "b.scope");
+
+    atlasagent::CgroupWatcher watcher{root.string(), 2};
+    auto events = watcher.poll();
+    ASSERT_EQ(events.size(), 2);
+    EXPECT_EQ(events[0].kind, Kind::Created);
+    EXPECT_EQ(events[0].path, "a.slice");
+    EXPECT_EQ(events[1].path, "a.slice/b.scope");
+    EXPECT_NE(events[1].id, 0);
+    EXPECT_TRUE(watcher.poll().empty());
+
+    // a new subtree, including children made before its watch existed; the depth limit applies
+    fs::create_directories(root / "c.slice" / "d.scope" / "too-deep");
+    events = watcher.poll();
+    ASSERT_EQ(events.size(), 2);
+    EXPECT_EQ(events[0].path, "c.slice");
+    EXPECT_EQ(events[1].path, "c.slice/d.scope");
+    EXPECT_EQ(watcher.cgroups().size(), 4);
+
+    fs::remove_all(root / "a.slice");
+    events = watcher.poll();
+    std::set<std::string> removed;
+    for (const auto& ev : events)
+    {
+        EXPECT_EQ(ev.kind, Kind::Removed);
+        removed.insert(ev.path);
+    }
+    EXPECT_EQ(removed, (std::set<std::string>{"a.slice", "a.slice/b.scope"}));
+    EXPECT_EQ(watcher.cgroups().size(), 2);
+    fs::remove_all(root);
+}
+
+TEST(KubePods, RemovedContainer)
+{
+    namespace fs = std::filesystem;
+    auto root = fs::temp_directory_path() / "kubepods_removed_test";
+    fs::remove_all(root);
+    fs::copy("lib/collectors/cgroup/test/resources/kubepods", root, fs::copy_options::recursive);
+
+    auto config = Config(WriterConfig(WriterTypes::Memory));
+    auto r = Registry(config);
+    KubePodsTest pods{&r, root.string()};
+    pods.discover();
+    EXPECT_EQ(pods.size(), 2);
+
+    fs::remove_all(root / "kubepods-burstable.slice");
+    pods.discover();
+    EXPECT_EQ(pods.size(), 1);
+    fs::remove_all(root);
+}
+
+TEST(MemoryEvents, Notification)
+{
+    namespace fs = std::filesystem;
+    auto root = fs::temp_directory_path() / "memory_events_test";
+    fs::remove_all(root);
+    fs::create_directories(root);
+    std::ofstream(root / "memory.events") << "low 0\nhigh 3\nmax 0\noom 0\noom_kill 0\noom_group_kill 0\n";
+
+    auto config = Config(WriterConfig(WriterTypes::Memory));
+    auto r = Registry(config);
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    memoryWriter->Clear();
+
+    atlasagent::MemoryEvents events{&r, root.string()};
+    ASSERT_TRUE(events.watching());
+    // rewrite in place with a single write, as the kernel would, rather than truncating first
+    std::ofstream(root / "memory.events", std::ios::in | std::ios::out)
+        << "low 0\nhigh 5\nmax 0\noom 1\noom_kill 1\noom_group_kill 0\n" << std::flush;
+    for (int i = 0; i < 200 && events.updates() == 0; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    ASSERT_GT(events.updates(), 0);
+
+    auto messages = memoryWriter->GetMessages();
+    std::set<std::string> messageSet(messages.begin(), messages.end());
+    EXPECT_TRUE(messageSet.contains("C:cgroup.mem.events,id=high:5.000000\n"));
+    EXPECT_TRUE(messageSet.contains("C:cgroup.mem.events,id=oom_kill:1.000000\n"));
+    EXPECT_TRUE(messageSet.contains("A:cgroup.mem.lastEvent,id=high:0.000000\n"));
+    EXPECT_TRUE(messageSet.contains("A:cgroup.mem.lastEvent,id=oom:0.000000\n"));
+    EXPECT_TRUE(messageSet.contains("A:cgroup.mem.lastEvent,id=oom_kill:0.000000\n"));
+    EXPECT_FALSE(messageSet.contains("A:cgroup.mem.lastEvent,id=low:0.000000\n"));
+    fs::remove_all(root);
+}
+
+TEST(CpuBurstSampler, PeakAndHistogram)
+{
+    auto config = Config(WriterConfig(WriterTypes::Memory));
+    auto r = Registry(config);
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    memoryWriter->Clear();
+    CpuBurstSamplerTest sampler{&r};
+
+    // 2 cpus: 100ms at 20% of the quota, then a burst of 180ms of cpu time in 100ms (90%)
+    auto t = absl::FromUnixSeconds(1000000000);
+    sampler.sample(t, "usage_usec 1000000\nnr_periods 10\nnr_throttled 0\n", 2);
+    sampler.sample(t + absl::Milliseconds(100), "usage_usec 1040000\nnr_periods 11\nnr_throttled 0\n", 2);
+    sampler.sample(t + absl::Milliseconds(200), "usage_usec 1220000\nnr_periods 12\nnr_throttled 1\n", 2);
+    sampler.publish();
+
+    auto messages = memoryWriter->GetMessages();
+    auto expected = std::set<std::string>{"m:cgroup.cpu.burstUtilization:90.000000\n",
+                                          "c:cgroup.cpu.burstSamples,le=25:1.000000\n",
+                                          "c:cgroup.cpu.burstSamples,le=90:1.000000\n",
+                                          "c:cgroup.cpu.burstThrottledSamples:1.000000\n",
+                                          "c:cgroup.cpu.burstSamplerTime:0.000000\n"};
+    EXPECT_EQ(std::set<std::string>(messages.begin(), messages.end()), expected);
+
+    // the aggregate is reset on publish, and nothing is reported without new samples
+    memoryWriter->Clear();
+    sampler.publish();
+    EXPECT_TRUE(memoryWriter->GetMessages().empty());
+}
@@ -1,15 +1,71 @@
 #include "disk.h"
 #include <lib/util/src/util.h>
-#include <absl/strings/str_split.h>
+#include <array>
 #include <fstream>
 #include <iostream>
 #include <sstream>
-#include <sys/statvfs.h>
+#include <poll.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+#include <algorithm>
+#include <charconv>
 #include <unordered_set>
 
 namespace atlasagent
 {
 
+Disk::Disk(Registry* registry, std::string path_prefix) noexcept
+    : registry_(registry), path_prefix_(std::move(path_prefix))
+{
+    static constexpr const char* kEnableEnvVar = "ATLAS_ENABLE_DISK_LATENCY_METRICS";
+    auto enabled_var = std::getenv(kEnableEnvVar);
+    if (enabled_var != nullptr && std::strcmp(enabled_var, "true") == 0)
+    {
+        Logger()->info("Disk latency metrics have been enabled using the env variable {}", kEnableEnvVar);
+        latency_enabled_ = true;
+    }
+
+    device_filter_ = NameFilter::FromEnv("ATLAS_DISK_INCLUDE", "ATLAS_DISK_EXCLUDE");
+    static constexpr const char* kWholeDisksEnvVar = "ATLAS_DISK_WHOLE_DISKS_ONLY";
+    auto whole_disks_var = std::getenv(kWholeDisksEnvVar);
+    if (whole_disks_var != nullptr && std::strcmp(whole_disks_var, "true") == 0)
+    {
+        Logger()->info("Disk partitions will be skipped using the env variable {}", kWholeDisksEnvVar);
+        whole_disks_only_ = true;
+    }
+}
+
+bool Disk::is_partition(unsigned major, unsigned minor) noexcept
+{
+    auto dev = makedev(major, minor);
+    auto it = partitions_.find(dev);
+    if (it != partitions_.end())
+    {
+        return it->second;
+    }
+
+    // device numbers of removed disks are never pruned, so bound the cache
+    static constexpr size_t kMaxCachedDevices = 4096;
+    if (partitions_.size() >= kMaxCachedDevices)
+    {
+        partitions_.clear();
+    }
+    auto file_name = fmt::format("{}/sys/dev/block/{}:{}/partition", path_prefix_, major, minor);
+    auto partition = access(file_name.c_str(), F_OK) == 0;
+    partitions_.emplace(dev, partition);
+    return partition;
+}
+
+// decided from the first three diskstats fields, before the counters are parsed
+bool Disk::device_wanted(unsigned major, unsigned minor, std::string_view device) noexcept
+{
+    if (!device_filter_.matches(device))
+    {
+        return false;
+    }
+    return !whole_disks_only_ || !is_partition(major, minor);
+}
+
 inline std::unordered_set<std::string> get_nodev_filesystems(const std::string& prefix)
 {
     std::unordered_set<std::string> res;
@@ -38,63 +94,147 @@ inline std::unordered_set<std::string> get_nodev_filesystems(const std::string&
     return res;
 }
 
-// parse /proc/self/mountinfo
-std::vector<MountPoint> Disk::get_mount_points() const noexcept
+const std::unordered_set<std::string>& Disk::unwanted_filesystems() noexcept
 {
-    auto unwanted_filesystems = get_nodev_filesystems(path_prefix_);
-    unwanted_filesystems.erase("tmpfs");
+    // /proc/filesystems only changes when a filesystem module is loaded, which would not
+    // add a block device filesystem we care about
+    if (!unwanted_filesystems_)
+    {
+        unwanted_filesystems_ = get_nodev_filesystems(path_prefix_);
+        unwanted_filesystems_->erase("tmpfs");
 #if defined(AGENT_FLAVOR_TITUS) || defined(AGENT_FLAVOR_K8S)
-    // for titus and k8s (both container flavors) we generate metrics for overlay fs
-    // see overlay_stats()
-    unwanted_filesystems.erase("overlay");
+        // for titus and k8s (both container flavors) we generate metrics for overlay fs
+        // see overlay_stats()
+        unwanted_filesystems_->erase("overlay");
 #endif
+    }
+    return *unwanted_filesystems_;
+}
 
-    auto file_name = fmt::format("{}/proc/self/mountinfo", path_prefix_);
-    std::ifstream in(file_name);
-    std::vector<MountPoint> res;
-
-    if (!in)
+static std::string_view next_field(std::string_view& line)
+{
+    auto start = line.find_first_not_of(' ');
+    if (start == std::string_view::npos)
     {
-        Logger()->warn("Unable to open {}", file_name);
-        return res;
+        line = {};
+        return {};
     }
+    auto end = line.find(' ', start);
+    auto field = line.substr(start, end - start);
+    line = end == std::string_view::npos ? std::string_view{} : line.substr(end);
+    return field;
+}
+
+template <typename T>
+static void parse_field(std::string_view& line, T& value)
+{
+    auto field = next_field(line);
+    std::from_chars(field.data(), field.data() + field.size(), value);
+}
 
-    std::string slash{"/"};
-    while (in)
+// parse the contents of /proc/self/mountinfo:
+// 36 35 98:0 /mnt1 /mnt2 rw,noatime master:1 - ext3 /dev/root rw,errors=continue
+std::vector<MountPoint> parse_mountinfo(std::string_view mountinfo,
+                                        const std::unordered_set<std::string>& unwanted_filesystems)
+{
+    std::vector<MountPoint> res;
+    while (!mountinfo.empty())
     {
-        MountPoint mp;
-        unsigned ignored;
-        std::string root;
-        char ch;
-        in >> ignored;
-        if (in.eof())
+        auto eol = mountinfo.find('\n');
+        auto line = mountinfo.substr(0, eol);
+        mountinfo = eol == std::string_view::npos ? std::string_view{} : mountinfo.substr(eol + 1);
+
+        next_field(line);  // mount id
+        next_field(line);  // parent id
+        auto dev = next_field(line);
+        auto root = next_field(line);
+        // mount points are relative to root, but we only concern ourselves with root = /
+        if (root != "/")
         {
-            break;
+            continue;
         }
-        in >> ignored;
-        in >> mp.device_major;
-        in >> ch;  // ':';
-        in >> mp.device_minor;
-        in >> root;
-        auto keep = root == slash;
-        if (keep)
+        auto mount_point = next_field(line);
+        auto sep = line.find(" - ");
+        if (sep == std::string_view::npos)
         {
-            in >> mp.mount_point;  // relative to root, but we only concern ourselves with root = /
-            in.ignore(std::numeric_limits<std::streamsize>::max(), '-');
-            in >> mp.fs_type;
-            in >> mp.device;
+            continue;
         }
-        in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        line.remove_prefix(sep + 2);
+        auto fs_type = next_field(line);
+        auto device = next_field(line);
 
         // add only if the filesystem is not in our unwanted blacklist
-        if (keep && unwanted_filesystems.find(mp.fs_type) == unwanted_filesystems.end())
+        std::string fs{fs_type};
+        if (unwanted_filesystems.contains(fs))
         {
-            res.push_back(std::move(mp));
+            continue;
+        }
+        MountPoint mp{};
+        auto colon = dev.find(':');
+        if (colon == std::string_view::npos)
+        {
+            continue;
         }
+        std::from_chars(dev.data(), dev.data() + colon, mp.device_major);
+        std::from_chars(dev.data() + colon + 1, dev.data() + dev.size(), mp.device_minor);
+        mp.mount_point = mount_point;
+        mp.device = device;
+        mp.fs_type = std::move(fs);
+        res.push_back(std::move(mp));
     }
     return res;
 }
 
+std::vector<MountPoint> Disk::get_mount_points() noexcept
+{
+    std::vector<MountPoint> res;
+    if (mountinfo_ < 0)
+    {
+        auto file_name = fmt::format("{}/proc/self/mountinfo", path_prefix_);
+        mountinfo_.open(file_name.c_str());
+        if (mountinfo_ < 0)
+        {
+            return res;
+        }
+    }
+
+    // procfs reports a size of 0, so read until we hit the end
+    std::string contents;
+    char buf[65536];
+    ssize_t n;
+    off_t offset = 0;
+    while ((n = pread(mountinfo_, buf, sizeof buf, offset)) > 0)
+    {
+        contents.append(buf, static_cast<size_t>(n));
+        offset += n;
+    }
+    if (n < 0)
+    {
+        Logger()->warn("Unable to read mountinfo: {}", strerror(errno));
+        mountinfo_ = UnixFile{-1};
+        return res;
+    }
+    return parse_mountinfo(contents, unwanted_filesystems());
+}
+
+// The kernel flags an open mountinfo with POLLERR|POLLPRI whenever the mount table
+// of the namespace changes. Polling also clears the flag, so the next read sees the new table.
+bool Disk::mount_table_changed() noexcept
+{
+    if (mountinfo_ < 0)
+    {
+        return true;
+    }
+    struct pollfd pfd{mountinfo_, POLLPRI, 0};
+    auto rc = poll(&pfd, 1, 0);
+    if (rc < 0)
+    {
+        Logger()->warn("Unable to poll mountinfo: {}", strerror(errno));
+        return true;
+    }
+    return rc > 0 && (pfd.revents & (POLLPRI | POLLERR)) != 0;
+}
+
 static constexpr int kMultipleDevice = 9;
 static constexpr int kLoopDevice = 7;
 static constexpr int kRamDevice = 1;
@@ -164,12 +304,26 @@ std::string get_dev_from_device(const std::string& device)
     return device;
 }
 
-void Disk::stats_for_interesting_mps(std::function<void(Disk*, const MountPoint&)> stats_fn) noexcept
+void Disk::stats_for_interesting_mps(
+    std::function<void(Disk*, const MountPoint&, const StatvfsResult&)> stats_fn) noexcept
 {
-    auto mount_points = filter_interesting_mount_points(get_mount_points());
-    for (const auto& mp : mount_points)
+    if (mount_table_changed())
     {
-        stats_fn(this, mp);
+        interesting_mount_points_ = filter_interesting_mount_points(get_mount_points());
+        interesting_paths_.clear();
+        for (const auto& mp : interesting_mount_points_)
+        {
+            interesting_paths_.push_back(mp.mount_point);
+        }
+    }
+    if (!statvfs_pool_)
+    {
+        statvfs_pool_ = std::make_unique<StatvfsPool>();
+    }
+    auto results = statvfs_pool_->stat(interesting_paths_, absl::Now());
+    for (size_t i = 0; i < interesting_mount_points_.size(); ++i)
+    {
+        stats_fn(this, interesting_mount_points_[i], results[i]);
     }
 }
 
@@ -177,14 +331,15 @@ void Disk::disk_stats() noexcept { do_disk_stats(absl::Now()); }
 
 void Disk::do_disk_stats(absl::Time start) noexcept
 {
-    stats_for_interesting_mps([](Disk* disk, const MountPoint& mp) { disk->update_stats_for(mp); });
+    stats_for_interesting_mps([](Disk* disk, const MountPoint& mp, const StatvfsResult& result)
+                              { disk->update_stats_for(mp, result); });
 
     diskio_stats(start);
     last_updated_ = absl::Now();
 }
 
 // parse /proc/diskstats
-std::vector<DiskIo> Disk::get_disk_stats() const noexcept
+std::vector<DiskIo> Disk::get_disk_stats() noexcept
 {
     std::vector<DiskIo> res;
     std::ostringstream os;
@@ -198,31 +353,53 @@ std::vector<DiskIo> Disk::get_disk_stats() const noexcept
         return res;
     }
 
-    for (std::string line; std::getline(in, line);)
+    for (std::string buf; std::getline(in, buf);)
     {
-        std::vector<std::string> fields = absl::StrSplit(line, absl::ByAnyChar(" \t"), absl::SkipWhitespace());
-        if (fields.size() < 14) continue;
-        int major = std::stoi(fields[0]);
+        // only the device columns are parsed until the filters have accepted the device
+        std::string_view line{buf};
+        int major = -1, minor = -1;
+        parse_field(line, major);
         if (major < 0)
         {
             break;
         }
+        parse_field(line, minor);
+        auto device = next_field(line);
+        if (device.empty() || !device_wanted(static_cast<unsigned>(major), static_cast<unsigned>(minor), device))
+        {
+            continue;
+        }
+
+        std::array<u_long, 17> counters{};
+        size_t count = 0;
+        for (auto field = next_field(line); !field.empty() && count < counters.size(); field = next_field(line))
+        {
+            std::from_chars(field.data(), field.data() + field.size(), counters[count++]);
+        }
+        if (count < 11) continue;
 
         DiskIo diskIo;
         diskIo.major = major;
-        diskIo.minor = std::stoi(fields[1]);
-        diskIo.device = std::move(fields[2]);
-        diskIo.reads_completed = std::strtoul(fields[3].c_str(), nullptr, 10);
-        diskIo.reads_merged = std::strtoul(fields[4].c_str(), nullptr, 10);
-        diskIo.rsect = std::strtoul(fields[5].c_str(), nullptr, 10);
-        diskIo.ms_reading = std::strtoul(fields[6].c_str(), nullptr, 10);
-        diskIo.writes_completed = std::strtoul(fields[7].c_str(), nullptr, 10);
-        diskIo.writes_merged = std::strtoul(fields[8].c_str(), nullptr, 10);
-        diskIo.wsect = std::strtoul(fields[9].c_str(), nullptr, 10);
-        diskIo.ms_writing = std::strtoul(fields[10].c_str(), nullptr, 10);
-        diskIo.ios_in_progress = std::strtoul(fields[11].c_str(), nullptr, 10);
-        diskIo.ms_doing_io = std::strtoul(fields[12].c_str(), nullptr, 10);
-        diskIo.weighted_ms_doing_io = std::strtoul(fields[13].c_str(), nullptr, 10);
+        diskIo.minor = minor;
+        diskIo.device = device;
+        diskIo.reads_completed = counters[0];
+        diskIo.reads_merged = counters[1];
+        diskIo.rsect = counters[2];
+        diskIo.ms_reading = counters[3];
+        diskIo.writes_completed = counters[4];
+        diskIo.writes_merged = counters[5];
+        diskIo.wsect = counters[6];
+        diskIo.ms_writing = counters[7];
+        diskIo.ios_in_progress = counters[8];
+        diskIo.ms_doing_io = counters[9];
+        diskIo.weighted_ms_doing_io = counters[10];
+        // discards are reported by kernel 4.18+ and flushes by 5.5+, the counters stay 0 otherwise
+        diskIo.discards_completed = counters[11];
+        diskIo.discards_merged = counters[12];
+        diskIo.dsect = counters[13];
+        diskIo.ms_discarding = counters[14];
+        diskIo.flushes_completed = counters[15];
+        diskIo.ms_flushing = counters[16];
 
         res.push_back(diskIo);
     }
@@ -232,10 +409,66 @@ std::vector<DiskIo> Disk::get_disk_stats() const noexcept
 static constexpr const char* kRead = "read";
 static constexpr const char* kWrite = "write";
 
-void Disk::diskio_stats(absl::Time start) noexcept
+DiskIoMeters::DiskIoMeters(Registry* registry, const DiskIo& st, bool timing)
+    : major{static_cast<unsigned>(st.major)},
+      minor{static_cast<unsigned>(st.minor)},
+      device{st.device},
+      read_bytes{registry->CreateMonotonicCounter("disk.io.bytes", {{"id", kRead}, {"dev", st.device}})},
+      write_bytes{registry->CreateMonotonicCounter("disk.io.bytes", {{"id", kWrite}, {"dev", st.device}})}
+{
+    if (timing)
+    {
+        read_ops.emplace(registry, MeterId("disk.io.ops", {{"id", kRead}, {"dev", st.device}}));
+        write_ops.emplace(registry, MeterId("disk.io.ops", {{"id", kWrite}, {"dev", st.device}}));
+        percent_busy.emplace(registry->CreateGauge("disk.percentBusy", {{"dev", st.device}}));
+    }
+}
+
+// Finds the record for a device in a vector sorted by (major, minor), creating it with make() if the
+// device is new or its number was reused by a different device. /proc/diskstats lists devices in the
+// same order every time, so the hint (the position after the previous device) nearly always finds
+// the record without searching.
+template <typename T, typename Make>
+static T& device_record(std::vector<T>& records, unsigned major, unsigned minor, std::string_view device,
+                        size_t hint, Make make)
+{
+    auto it = records.begin() + static_cast<std::ptrdiff_t>(std::min(hint, records.size()));
+    if (it == records.end() || it->major != major || it->minor != minor)
+    {
+        it = std::lower_bound(records.begin(), records.end(), std::pair{major, minor},
+                              [](const T& r, const std::pair<unsigned, unsigned>& key)
+                              { return r.major < key.first || (r.major == key.first && r.minor < key.second); });
+    }
+    if (it != records.end() && it->major == major && it->minor == minor)
+    {
+        if (it->device == device)
+        {
+            it->seen = true;
+        }
+        else
+        {
+            *it = make();
+        }
+        return *it;
+    }
+    return *records.insert(it, make());
+}
+
+DiskIoMeters& Disk::diskio_meters_for(const DiskIo& st, size_t hint) noexcept
 {
-    const auto& stats = get_disk_stats();
+    return device_record(diskio_meters_, static_cast<unsigned>(st.major), static_cast<unsigned>(st.minor), st.device,
+                         hint, [&] { return DiskIoMeters{registry_, st, st.major != kMultipleDevice}; });
+}
 
+void Disk::for_each_diskio(const std::vector<DiskIo>& stats,
+                           const std::function<void(DiskIoMeters&, const DiskIo&)>& fn) noexcept
+{
+    for (auto& m : diskio_meters_)
+    {
+        m.seen = false;
+    }
+
+    size_t hint = 0;
     for (const auto& st : stats)
     {
         if (st.major == kLoopDevice || st.major == kRamDevice)
@@ -243,88 +476,258 @@ void Disk::diskio_stats(absl::Time start) noexcept
             continue;  // ignore loop and ram devices
         }
 
-        auto readTags = std::unordered_map<std::string, std::string>{{"id", kRead}, {"dev", st.device}};
-        auto writeTags = std::unordered_map<std::string, std::string>{{"id", kWrite}, {"dev", st.device}};
+        auto& m = diskio_meters_for(st, hint);
+        hint = static_cast<size_t>(&m - diskio_meters_.data()) + 1;
+        fn(m, st);
+    }
 
-        registry_->CreateMonotonicCounter("disk.io.bytes", readTags).Set(st.rsect * 512);
-        registry_->CreateMonotonicCounter("disk.io.bytes", writeTags).Set(st.wsect * 512);
+    // forget devices that have been removed
+    std::erase_if(diskio_meters_, [](const DiskIoMeters& m) { return !m.seen; });
+}
 
-        if (st.major == kMultipleDevice)
-        {
-            continue;  // ignore multiple devices for disk.io.ops and disk.percentBusy - they do not provide timing
-                       // stats
-        }
+void Disk::diskio_stats(absl::Time start) noexcept
+{
+    auto delta_millis = last_updated_ > absl::UnixEpoch() ? absl::ToInt64Milliseconds(start - last_updated_) : 0;
+    for_each_diskio(get_disk_stats(),
+                    [delta_millis](DiskIoMeters& m, const DiskIo& st)
+                    {
+                        m.read_bytes.Set(st.rsect * 512);
+                        m.write_bytes.Set(st.wsect * 512);
+
+                        if (!m.read_ops)
+                        {
+                            return;  // ignore multiple devices for disk.io.ops and disk.percentBusy - they do not
+                                     // provide timing stats
+                        }
+
+                        m.read_ops->update(absl::Milliseconds(st.ms_reading), st.reads_completed + st.reads_merged);
+                        m.write_ops->update(absl::Milliseconds(st.ms_writing),
+                                            st.writes_completed + st.writes_merged);
+
+                        if (delta_millis > 0 && m.last_ms_doing_io && st.ms_doing_io >= *m.last_ms_doing_io)
+                        {
+                            auto delta_time_doing_io = st.ms_doing_io - *m.last_ms_doing_io;
+                            m.percent_busy->Set(100.0 * delta_time_doing_io / delta_millis);
+                        }
+                        m.last_ms_doing_io = st.ms_doing_io;
+                    });
+}
 
-        MeterId mono_read_id = MeterId("disk.io.ops", readTags);
-        MeterId mono_write_id = MeterId("disk.io.ops", writeTags);
-        MeterId busy_gauge_id = MeterId("disk.percentBusy", {{"dev", st.device}});
+DiskLatencyMeters::DiskLatencyMeters(Registry* registry, const std::string& device)
+    : queue_depth{registry->CreateGauge("disk.io.queueDepth", {{"dev", device}})},
+      read_await{registry->CreateGauge("disk.io.await", {{"id", kRead}, {"dev", device}})},
+      write_await{registry->CreateGauge("disk.io.await", {{"id", kWrite}, {"dev", device}})},
+      discard_await{registry->CreateGauge("disk.io.await", {{"id", "discard"}, {"dev", device}})},
+      flush_await{registry->CreateGauge("disk.io.await", {{"id", "flush"}, {"dev", device}})},
+      discards{registry->CreateCounter("disk.io.discards", {{"dev", device}})},
+      discard_bytes{registry->CreateCounter("disk.io.discardBytes", {{"dev", device}})},
+      flushes{registry->CreateCounter("disk.io.flushes", {{"dev", device}})}
+{
+}
 
-        std::shared_ptr<MonotonicTimer> read_timer;
-        std::shared_ptr<MonotonicTimer> write_timer;
+// average time in seconds per completed request over the interval
+static void set_await(Gauge& gauge, u_long ms, u_long prev_ms, u_long ops, u_long prev_ops)
+{
+    if (ops > prev_ops && ms >= prev_ms)
+    {
+        gauge.Set((ms - prev_ms) / 1000.0 / (ops - prev_ops));
+    }
+}
 
-        auto it = monotonic_timers_.find(mono_read_id);
+void Disk::latency_stats() noexcept
+{
+    if (latency_enabled_)
+    {
+        diskio_latency_stats(absl::Now());
+    }
+}
+
+void Disk::diskio_latency_stats(absl::Time start) noexcept
+{
+    auto delta_millis =
+        latency_updated_ > absl::UnixEpoch() ? absl::ToInt64Milliseconds(start - latency_updated_) : 0;
+    latency_updated_ = start;
+    for_each_diskio(get_disk_stats(),
+                    [this, delta_millis](DiskIoMeters& m, const DiskIo& st)
+                    {
+                        if (!m.read_ops)
+                        {
+                            return;  // multiple devices do not provide timing stats
+                        }
+                        if (!m.latency)
+                        {
+                            m.latency.emplace(registry_, st.device);
+                        }
+                        auto& lat = *m.latency;
+                        if (lat.prev && delta_millis > 0)
+                        {
+                            const auto& prev = *lat.prev;
+                            // weighted time doing io accumulates the number of requests in flight every ms
+                            if (st.weighted_ms_doing_io >= prev.weighted_ms_doing_io)
+                            {
+                                lat.queue_depth.Set(static_cast<double>(st.weighted_ms_doing_io -
+                                                                        prev.weighted_ms_doing_io) /
+                                                    delta_millis);
+                            }
+                            set_await(lat.read_await, st.ms_reading, prev.ms_reading, st.reads_completed,
+                                      prev.reads_completed);
+                            set_await(lat.write_await, st.ms_writing, prev.ms_writing, st.writes_completed,
+                                      prev.writes_completed);
+                            set_await(lat.discard_await, st.ms_discarding, prev.ms_discarding,
+                                      st.discards_completed, prev.discards_completed);
+                            set_await(lat.flush_await, st.ms_flushing, prev.ms_flushing, st.flushes_completed,
+                                      prev.flushes_completed);
+                            if (st.discards_completed > prev.discards_completed)
+                            {
+                                lat.discards.Increment(st.discards_completed - prev.discards_completed);
+                            }
+                            if (st.dsect > prev.dsect)
+                            {
+                                lat.discard_bytes.Increment((st.dsect - prev.dsect) * 512);
+                            }
+                            if (st.flushes_completed > prev.flushes_completed)
+                            {
+                                lat.flushes.Increment(st.flushes_completed - prev.flushes_completed);
+                            }
+                        }
+                        lat.prev = st;
+                    });
+}
+
+DiskPeakMeters::DiskPeakMeters(Registry* registry, unsigned major, unsigned minor, std::string_view device)
+    : major{major},
+      minor{minor},
+      device{device},
+      read_ops{registry->CreateMaxGauge("disk.io.peakOps", {{"id", kRead}, {"dev", this->device}})},
+      write_ops{registry->CreateMaxGauge("disk.io.peakOps", {{"id", kWrite}, {"dev", this->device}})},
+      read_bytes{registry->CreateMaxGauge("disk.io.peakBytes", {{"id", kRead}, {"dev", this->device}})},
+      write_bytes{registry->CreateMaxGauge("disk.io.peakBytes", {{"id", kWrite}, {"dev", this->device}})}
+{
+}
 
-        if (it != monotonic_timers_.end())
+static void set_rate(MaxGauge& gauge, u_long cur, u_long& prev, double seconds, bool update)
+{
+    if (update && cur >= prev)
+    {
+        gauge.Set((cur - prev) / seconds);
+    }
+    prev = cur;
+}
+
+void Disk::peak_stats() noexcept { diskio_peak_stats(absl::Now()); }
+
+void Disk::diskio_peak_stats(absl::Time start) noexcept
+{
+    if (diskstats_ < 0)
+    {
+        auto file_name = fmt::format("{}/proc/diskstats", path_prefix_);
+        diskstats_.open(file_name.c_str());
+        if (diskstats_ < 0)
         {
-            read_timer = it->second;
-            write_timer = monotonic_timers_[mono_write_id];
+            return;
         }
-        else
-        {
-            read_timer.reset(new MonotonicTimer(registry_, mono_read_id));
-            write_timer.reset(new MonotonicTimer(registry_, mono_write_id));
+        diskstats_buf_.resize(16384);
+    }
 
-            monotonic_timers_[mono_read_id] = read_timer;
-            monotonic_timers_[mono_write_id] = write_timer;
+    // the buffer only grows, so once it fits every device this does not allocate
+    size_t len = 0;
+    ssize_t n;
+    while ((n = pread(diskstats_, diskstats_buf_.data() + len, diskstats_buf_.size() - len,
+                      static_cast<off_t>(len))) > 0)
+    {
+        len += static_cast<size_t>(n);
+        if (len == diskstats_buf_.size())
+        {
+            diskstats_buf_.resize(len * 2);
         }
+    }
+    if (n < 0)
+    {
+        Logger()->warn("Unable to read diskstats: {}", strerror(errno));
+        diskstats_ = UnixFile{-1};
+        return;
+    }
 
-        auto read_time = absl::Milliseconds(st.ms_reading);
-        auto write_time = absl::Milliseconds(st.ms_writing);
-        read_timer->update(read_time, st.reads_completed + st.reads_merged);
-        write_timer->update(write_time, st.writes_completed + st.writes_merged);
+    auto seconds = absl::ToDoubleSeconds(start - peak_updated_);
+    auto update = peak_updated_ > absl::UnixEpoch() && seconds > 0;
+    peak_updated_ = start;
 
-        if (last_updated_ > absl::UnixEpoch())
+    for (auto& m : peak_meters_)
+    {
+        m.seen = false;
+    }
+
+    std::string_view buf{diskstats_buf_.data(), len};
+    size_t hint = 0;
+    while (!buf.empty())
+    {
+        auto eol = buf.find('\n');
+        auto line = buf.substr(0, eol);
+        buf = eol == std::string_view::npos ? std::string_view{} : buf.substr(eol + 1);
+
+        unsigned major = 0, minor = 0;
+        u_long reads = 0, rsect = 0, writes = 0, wsect = 0, ignored;
+        parse_field(line, major);
+        parse_field(line, minor);
+        auto device = next_field(line);
+        if (device.empty() || major == kLoopDevice || major == kRamDevice || !device_wanted(major, minor, device))
         {
-            auto delta_t = start - last_updated_;
-            auto delta_millis = absl::ToInt64Milliseconds(delta_t);
-            auto last_time = last_ms_doing_io[st.device];
-            if (st.ms_doing_io >= last_time)
-            {
-                auto delta_time_doing_io = st.ms_doing_io - last_time;
-                registry_->CreateGauge(busy_gauge_id).Set(100.0 * delta_time_doing_io / delta_millis);
-            }
+            continue;
         }
-
-        last_ms_doing_io[st.device] = st.ms_doing_io;
+        parse_field(line, reads);
+        parse_field(line, ignored);  // reads merged
+        parse_field(line, rsect);
+        parse_field(line, ignored);  // ms reading
+        parse_field(line, writes);
+        parse_field(line, ignored);  // writes merged
+        parse_field(line, wsect);
+
+        bool created = false;
+        auto& m = device_record(peak_meters_, major, minor, device, hint,
+                                [&]
+                                {
+                                    created = true;
+                                    return DiskPeakMeters{registry_, major, minor, device};
+                                });
+        hint = static_cast<size_t>(&m - peak_meters_.data()) + 1;
+        set_rate(m.read_ops, reads, m.reads, seconds, update && !created);
+        set_rate(m.write_ops, writes, m.writes, seconds, update && !created);
+        set_rate(m.read_bytes, rsect * 512, m.bytes_read, seconds, update && !created);
+        set_rate(m.write_bytes, wsect * 512, m.bytes_written, seconds, update && !created);
     }
+
+    // forget devices that have been removed
+    std::erase_if(peak_meters_, [](const DiskPeakMeters& m) { return !m.seen; });
 }
 
 void Disk::titus_disk_stats() noexcept
 {
-    stats_for_interesting_mps([](Disk* disk, const MountPoint& mp) { disk->update_stats_for(mp); });
+    stats_for_interesting_mps([](Disk* disk, const MountPoint& mp, const StatvfsResult& result)
+                              { disk->update_stats_for(mp, result); });
 }
 
 // Currently a copy of titus_disk_stats(): the k8s flavor is container-scoped like Titus. Kept as a
 // separate entry point so k8s disk metrics can diverge from Titus without touching titus_disk_stats().
 void Disk::k8s_disk_stats() noexcept
 {
-    stats_for_interesting_mps([](Disk* disk, const MountPoint& mp) { disk->update_stats_for(mp); });
+    stats_for_interesting_mps([](Disk* disk, const MountPoint& mp, const StatvfsResult& result)
+                              { disk->update_stats_for(mp, result); });
 }
 
-void Disk::update_stats_for(const MountPoint& mp) noexcept
+void Disk::update_stats_for(const MountPoint& mp, const StatvfsResult& result) noexcept
 {
-    struct statvfs st;
-    if (statvfs(mp.mount_point.c_str(), &st) != 0)
+    if (!result.st)
     {
         // do not generate warnings for tmpfs mount points. On some systems
         // we'll get a permission denied error (titusagents) and generate a lot
-        // of noise in the logs
-        if (mp.fs_type != "tmpfs")
+        // of noise in the logs. Timeouts are logged by the StatvfsPool
+        if (mp.fs_type != "tmpfs" && result.error != 0 && result.error != ETIMEDOUT)
         {
-            Logger()->warn("Unable to statvfs({}) = {}", mp.mount_point, strerror(errno));
+            Logger()->warn("Unable to statvfs({}) = {}", mp.mount_point, strerror(result.error));
         }
         return;
     }
+    const auto& st = *result.st;
 
     auto id = get_id_from_mountpoint(mp.mount_point);
     std::unordered_map<std::string, std::string> tags = {{"id", id}, {"dev", get_dev_from_device(mp.device)}};
@@ -349,6 +752,21 @@ void Disk::update_stats_for(const MountPoint& mp) noexcept
     }
 }
 
-void Disk::set_prefix(const std::string& new_prefix) noexcept { path_prefix_ = new_prefix; }
+void Disk::set_prefix(const std::string& new_prefix) noexcept
+{
+    path_prefix_ = new_prefix;
+    mountinfo_ = UnixFile{-1};
+    diskstats_ = UnixFile{-1};
+    unwanted_filesystems_.reset();
+    interesting_mount_points_.clear();
+    partitions_.clear();
+}
+
+void Disk::set_device_filter(NameFilter filter, bool whole_disks_only) noexcept
+{
+    device_filter_ = std::move(filter);
+    whole_disks_only_ = whole_disks_only;
+    partitions_.clear();
+}
 
 }  // namespace atlasagent
@@ -1,12 +1,17 @@
 #pragma once
 #include <thirdparty/spectator-cpp/spectator/registry.h>
 #include <lib/monotonic_timer/src/monotonic_timer.h>
+#include <lib/files/src/files.h>
+#include <lib/collectors/disk/src/statvfs_pool.h>
+#include <lib/util/src/name_filter.h>
 #include <string>
 #include <sys/types.h>
 #include <fmt/format.h>
 #include <unordered_map>
 #include <vector>
 #include <unordered_set>
+#include <optional>
+#include <string_view>
 #include <absl/time/time.h>
 #include <absl/time/clock.h>
 
@@ -37,43 +42,140 @@ struct DiskIo
     u_long ios_in_progress;
     u_long ms_doing_io;
     u_long weighted_ms_doing_io;
+    // kernel 4.18+
+    u_long discards_completed{};
+    u_long discards_merged{};
+    u_long dsect{};
+    u_long ms_discarding{};
+    // kernel 5.5+
+    u_long flushes_completed{};
+    u_long ms_flushing{};
+};
+
+// Queue depth and latency meters for the optional 5s device stats
+struct DiskLatencyMeters
+{
+    DiskLatencyMeters(Registry* registry, const std::string& device);
+
+    Gauge queue_depth;
+    Gauge read_await;
+    Gauge write_await;
+    Gauge discard_await;
+    Gauge flush_await;
+    Counter discards;
+    Counter discard_bytes;
+    Counter flushes;
+    std::optional<DiskIo> prev;
+};
+
+// Meter handles and previous values for one /proc/diskstats device, kept across
+// collections so the per-device work is just arithmetic
+struct DiskIoMeters
+{
+    DiskIoMeters(Registry* registry, const DiskIo& st, bool timing);
+
+    unsigned major;
+    unsigned minor;
+    std::string device;
+    MonotonicCounter read_bytes;
+    MonotonicCounter write_bytes;
+    // multiple devices (md) do not provide timing stats
+    std::optional<MonotonicTimer> read_ops;
+    std::optional<MonotonicTimer> write_ops;
+    std::optional<Gauge> percent_busy;
+    std::optional<u_long> last_ms_doing_io;
+    std::optional<DiskLatencyMeters> latency;  // created by diskio_latency_stats()
+    bool seen{true};
+};
+
+// Per second read/write rates for one /proc/diskstats device, published as the peak each minute
+struct DiskPeakMeters
+{
+    DiskPeakMeters(Registry* registry, unsigned major, unsigned minor, std::string_view device);
+
+    unsigned major;
+    unsigned minor;
+    std::string device;
+    MaxGauge read_ops;
+    MaxGauge write_ops;
+    MaxGauge read_bytes;
+    MaxGauge write_bytes;
+    // previous values
+    u_long reads{};
+    u_long writes{};
+    u_long bytes_read{};
+    u_long bytes_written{};
+    bool seen{true};
 };
 
 // Helper functions
 std::unordered_set<std::string> get_nodev_filesystems(const std::string& prefix);
+std::vector<MountPoint> parse_mountinfo(std::string_view mountinfo,
+                                        const std::unordered_set<std::string>& unwanted_filesystems);
 std::string get_id_from_mountpoint(const std::string& mp);
 std::string get_dev_from_device(const std::string& device);
 
 class Disk
 {
    public:
-    explicit Disk(Registry* registry, std::string path_prefix = "") noexcept
-        : registry_(registry), path_prefix_(std::move(path_prefix))
-    {
-    }
+    explicit Disk(Registry* registry, std::string path_prefix = "") noexcept;
     void titus_disk_stats() noexcept;
     void k8s_disk_stats() noexcept;
     void disk_stats() noexcept;
+    // queue depth, await and discard/flush rates, when ATLAS_ENABLE_DISK_LATENCY_METRICS=true
+    void latency_stats() noexcept;
+    // per second IOPS and throughput, called every second
+    void peak_stats() noexcept;
     void set_prefix(const std::string& new_prefix) noexcept;  // for testing
+    void set_device_filter(NameFilter filter, bool whole_disks_only) noexcept;  // for testing
    private:
     Registry* registry_;
     std::string path_prefix_;
     absl::Time last_updated_{absl::UnixEpoch()};
-    std::unordered_map<std::string, u_long> last_ms_doing_io{};
-    std::unordered_map<MeterId, std::shared_ptr<MonotonicTimer>> monotonic_timers_{};
+    absl::Time latency_updated_{absl::UnixEpoch()};
+    bool latency_enabled_{false};
+    std::vector<DiskIoMeters> diskio_meters_{};  // sorted by (major, minor)
+    // mountinfo is kept open so poll() can tell us when the mount table changes
+    UnixFile mountinfo_{-1};
+    std::optional<std::unordered_set<std::string>> unwanted_filesystems_;
+    std::vector<MountPoint> interesting_mount_points_{};
+    std::vector<std::string> interesting_paths_{};
+    // statvfs runs on worker threads so a hung mount cannot stall collection
+    std::unique_ptr<StatvfsPool> statvfs_pool_;
+    // the per second peak tracker rereads diskstats through one fd and buffer
+    UnixFile diskstats_{-1};
+    std::string diskstats_buf_{};
+    std::vector<DiskPeakMeters> peak_meters_{};  // sorted by (major, minor)
+    absl::Time peak_updated_{absl::UnixEpoch()};
+    // devices to report, from ATLAS_DISK_INCLUDE / ATLAS_DISK_EXCLUDE
+    NameFilter device_filter_;
+    // skip partitions when ATLAS_DISK_WHOLE_DISKS_ONLY=true
+    bool whole_disks_only_{false};
+    std::unordered_map<dev_t, bool> partitions_{};
+
+    const std::unordered_set<std::string>& unwanted_filesystems() noexcept;
+    DiskIoMeters& diskio_meters_for(const DiskIo& st, size_t hint) noexcept;
+    void for_each_diskio(const std::vector<DiskIo>& stats,
+                         const std::function<void(DiskIoMeters&, const DiskIo&)>& fn) noexcept;
+    bool mount_table_changed() noexcept;
+    bool is_partition(unsigned major, unsigned minor) noexcept;
+    bool device_wanted(unsigned major, unsigned minor, std::string_view device) noexcept;
 
    protected:
     // protected for testing
     void do_disk_stats(absl::Time start) noexcept;
-    void stats_for_interesting_mps(std::function<void(Disk*, const MountPoint&)> stats_fn) noexcept;
+    void stats_for_interesting_mps(
+        std::function<void(Disk*, const MountPoint&, const StatvfsResult&)> stats_fn) noexcept;
     [[nodiscard]] std::vector<MountPoint> filter_interesting_mount_points(
         const std::vector<MountPoint>& mount_points) const noexcept;
-    [[nodiscard]] std::vector<MountPoint> get_mount_points() const noexcept;
-    [[nodiscard]] std::vector<DiskIo> get_disk_stats() const noexcept;
+    [[nodiscard]] std::vector<MountPoint> get_mount_points() noexcept;
+    [[nodiscard]] std::vector<DiskIo> get_disk_stats() noexcept;
     void update_titus_stats_for(const MountPoint& mp) noexcept;
-    void update_stats_for(const MountPoint& mp) noexcept;
+    void update_stats_for(const MountPoint& mp, const StatvfsResult& result) noexcept;
 
     void diskio_stats(absl::Time start) noexcept;
+    void diskio_latency_stats(absl::Time start) noexcept;
+    void diskio_peak_stats(absl::Time start) noexcept;
     void set_last_updated(absl::Time updated) { last_updated_ = updated; }
 };
 
@@ -0,0 +1,196 @@
+#include "statvfs_pool.h"
+
+#include <lib/logger/src/logger.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+namespace atlasagent
+{
+
+// a mount that timed out is skipped for 2, 4, 8... minutes, up to kMaxBackoff
+static constexpr auto kBaseBackoff = absl::Minutes(1);
+static constexpr auto kMaxBackoff = absl::Minutes(30);
+
+StatvfsPool::StatvfsPool(size_t num_workers, absl::Duration timeout, absl::Duration stale_after,
+                         StatFn stat_fn) noexcept
+    : timeout_{timeout}, stale_after_{stale_after}, stat_fn_{std::move(stat_fn)}, state_{std::make_shared<State>()}
+{
+    state_->num_workers = num_workers;
+    state_->max_workers = num_workers * 4;
+    state_->timeout = absl::ToChronoNanoseconds(timeout);
+    std::lock_guard lock{state_->mutex};
+    for (size_t i = 0; i < num_workers; ++i)
+    {
+        state_->threads++;
+        std::thread(&StatvfsPool::run, state_, stat_fn_).detach();
+    }
+}
+
+StatvfsPool::~StatvfsPool()
+{
+    {
+        std::lock_guard lock{state_->mutex};
+        state_->shutdown = true;
+    }
+    state_->work_cv.notify_all();
+}
+
+// workers in the middle of a call. stat() only looks for blocked workers once its calls had a full
+// timeout to finish, so any call still running at that point counts as blocked.
+size_t StatvfsPool::busy_workers(const State& state) noexcept
+{
+    return static_cast<size_t>(std::count_if(state.entries.begin(), state.entries.end(),
+                                             [](const auto& kv)
+                                             { return kv.second.in_flight && kv.second.started; }));
+}
+
+// called with the lock held
+void StatvfsPool::replace_blocked_workers() noexcept
+{
+    auto& state = *state_;
+    if (state.queue.empty())
+    {
+        return;
+    }
+    auto blocked = busy_workers(state);
+    while (state.threads - blocked < state.num_workers && state.threads < state.max_workers)
+    {
+        state.threads++;
+        std::thread(&StatvfsPool::run, state_, stat_fn_).detach();
+    }
+}
+
+void StatvfsPool::run(std::shared_ptr<State> state, StatFn stat_fn) noexcept
+{
+    std::unique_lock lock{state->mutex};
+    for (;;)
+    {
+        state->work_cv.wait(lock, [&] { return state->shutdown || !state->queue.empty(); });
+        if (state->shutdown)
+        {
+            state->threads--;
+            return;
+        }
+        auto path = std::move(state->queue.front());
+        state->queue.pop_front();
+        auto started = state->entries.find(path);
+        if (started != state->entries.end())
+        {
+            started->second.started = true;
+            started->second.started_at = Clock::now();
+        }
+
+        lock.unlock();
+        struct statvfs st;
+        auto rc = stat_fn(path.c_str(), &st);
+        auto error = rc == 0 ? 0 : errno;
+        lock.lock();
+
+        auto it = state->entries.find(path);
+        if (it != state->entries.end())
+        {
+            auto& entry = it->second;
+            entry.in_flight = false;
+            entry.started = false;
+            entry.error = error;
+            if (rc == 0)
+            {
+                entry.last = st;
+                entry.last_good = entry.queued;
+                entry.timeouts = 0;
+                entry.retry_after = absl::InfinitePast();
+            }
+            state->done_cv.notify_all();
+        }
+
+        // a replacement was started while this call was blocked
+        if (state->shutdown || state->threads - busy_workers(*state) > state->num_workers)
+        {
+            state->threads--;
+            return;
+        }
+    }
+}
+
+std::vector<StatvfsResult> StatvfsPool::stat(const std::vector<std::string>& paths, absl::Time now) noexcept
+{
+    std::unique_lock lock{state_->mutex};
+    auto& entries = state_->entries;
+
+    // forget mounts that went away, unless a worker still has them
+    std::erase_if(entries, [&](const auto& kv)
+                  { return !kv.second.in_flight && std::find(paths.begin(), paths.end(), kv.first) == paths.end(); });
+
+    std::vector<const std::string*> queued;
+    for (const auto& path : paths)
+    {
+        auto& entry = entries[path];
+        if (entry.in_flight || now < entry.retry_after)
+        {
+            continue;
+        }
+        entry.in_flight = true;
+        entry.queued = now;
+        state_->queue.push_back(path);
+        queued.push_back(&path);
+    }
+    // anything still running here was left over by an earlier stat() that already waited for it
+    replace_blocked_workers();
+    state_->work_cv.notify_all();
+
+    // done once every call returned or has been blocked for a full timeout
+    auto settled = [&]
+    {
+        auto now = Clock::now();
+        return std::none_of(queued.begin(), queued.end(),
+                            [&](const std::string* p)
+                            {
+                                const auto& entry = entries[*p];
+                                return entry.in_flight &&
+                                       (!entry.started || now - entry.started_at < state_->timeout);
+                            });
+    };
+    state_->done_cv.wait_for(lock, state_->timeout, settled);
+
+    // calls still queued behind hung mounts get fresh workers and a full timeout of their own
+    auto waiting = std::any_of(queued.begin(), queued.end(),
+                               [&](const std::string* p) { return entries[*p].in_flight && !entries[*p].started; });
+    if (waiting)
+    {
+        replace_blocked_workers();
+        state_->work_cv.notify_all();
+        state_->done_cv.wait_for(lock, state_->timeout, settled);
+    }
+
+    for (const auto* path : queued)
+    {
+        auto& entry = entries[*path];
+        if (entry.in_flight && entry.started)
+        {
+            entry.timeouts++;
+            auto backoff = std::min(kBaseBackoff * (int64_t{1} << std::min(entry.timeouts, 5)), kMaxBackoff);
+            entry.retry_after = now + backoff;
+            Logger()->warn("statvfs({}) did not finish within {}, skipping it for {}", *path,
+                           absl::FormatDuration(timeout_), absl::FormatDuration(backoff));
+        }
+    }
+
+    std::vector<StatvfsResult> results;
+    results.reserve(paths.size());
+    for (const auto& path : paths)
+    {
+        const auto& entry = entries[path];
+        auto& result = results.emplace_back();
+        result.error = entry.in_flight ? ETIMEDOUT : entry.error;
+        if (entry.last && now - entry.last_good <= stale_after_)
+        {
+            result.st = entry.last;
+        }
+    }
+    return results;
+}
+
+}  // namespace atlasagent
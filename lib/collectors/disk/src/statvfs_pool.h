@@ -0,0 +1,94 @@
+#pragma once
+
+#include <absl/time/time.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <sys/statvfs.h>
+#include <unordered_map>
+#include <vector>
+
+namespace atlasagent
+{
+
+struct StatvfsResult
+{
+    std::optional<struct statvfs> st;  // the last good value, until it goes stale
+    int error{0};                      // errno of the latest call, ETIMEDOUT if it has not returned yet
+};
+
+// Runs statvfs for a set of mount points on a few worker threads, so an unresponsive network or
+// FUSE mount cannot stall the collection loop. stat() waits at most `timeout` for the calls it
+// queued. A mount whose call has not returned stays in flight and is not queued again until it
+// does; after each timeout it is also skipped for an exponentially growing backoff. Mounts without
+// a fresh value report the last good one until it is older than `stale_after`.
+//
+// A worker still busy once stat() has waited `timeout` is treated as blocked and replaced, up to
+// four times `num_workers` threads, so calls still waiting in the queue are not held up by hung
+// mounts. Those calls are not charged a timeout, since they never started. Once a blocked call
+// returns, extra workers exit.
+//
+// Workers are detached and share their state with the pool, since a thread stuck in statvfs cannot
+// be joined.
+class StatvfsPool
+{
+   public:
+    using StatFn = std::function<int(const char*, struct statvfs*)>;
+
+    explicit StatvfsPool(size_t num_workers = 4, absl::Duration timeout = absl::Seconds(2),
+                         absl::Duration stale_after = absl::Minutes(5), StatFn stat_fn = ::statvfs) noexcept;
+    ~StatvfsPool();
+
+    StatvfsPool(const StatvfsPool&) = delete;
+    StatvfsPool& operator=(const StatvfsPool&) = delete;
+
+    // one result per path, in the same order
+    std::vector<StatvfsResult> stat(const std::vector<std::string>& paths, absl::Time now) noexcept;
+
+   private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry
+    {
+        bool in_flight{false};
+        bool started{false};      // a worker has picked up the queued call
+        Clock::time_point started_at{};
+        int error{0};
+        std::optional<struct statvfs> last;
+        absl::Time queued{absl::InfinitePast()};
+        absl::Time last_good{absl::InfinitePast()};  // when the call that produced `last` was queued
+        int timeouts{0};
+        absl::Time retry_after{absl::InfinitePast()};
+    };
+
+    struct State
+    {
+        std::mutex mutex;
+        std::condition_variable work_cv;
+        std::condition_variable done_cv;
+        std::deque<std::string> queue;
+        std::unordered_map<std::string, Entry> entries;
+        bool shutdown{false};
+        size_t num_workers{0};
+        size_t max_workers{0};
+        size_t threads{0};  // live worker threads, including blocked ones
+        Clock::duration timeout{};
+    };
+
+    static void run(std::shared_ptr<State> state, StatFn stat_fn) noexcept;
+    static size_t busy_workers(const State& state) noexcept;
+    void replace_blocked_workers() noexcept;
+
+    absl::Duration timeout_;
+    absl::Duration stale_after_;
+    StatFn stat_fn_;
+    std::shared_ptr<State> state_;
+};
+
+}  // namespace atlasagent
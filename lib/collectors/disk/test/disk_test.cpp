@@ -3,6 +3,11 @@
 #include <thirdparty/spectator-cpp/spectator/registry.h>
 #include <thirdparty/spectator-cpp/libs/writer/writer_wrapper/writer_test_helper.h>
 #include <gtest/gtest.h>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <thread>
 #include <unordered_set>
 
 namespace
@@ -11,6 +16,7 @@ using atlasagent::Disk;
 using atlasagent::DiskIo;
 using atlasagent::Logger;
 using atlasagent::MountPoint;
+using atlasagent::NameFilter;
 
 class TestDisk : public atlasagent::Disk
 {
@@ -27,15 +33,19 @@ class TestDisk : public atlasagent::Disk
 
     void set_last_updated(absl::Time now) { Disk::set_last_updated(now); }
 
-    std::vector<MountPoint> get_mount_points() const noexcept { return Disk::get_mount_points(); }
+    std::vector<MountPoint> get_mount_points() noexcept { return Disk::get_mount_points(); }
 
-    std::vector<DiskIo> get_disk_stats() const noexcept { return Disk::get_disk_stats(); }
+    std::vector<DiskIo> get_disk_stats() noexcept { return Disk::get_disk_stats(); }
 
     void update_titus_stats_for(const MountPoint& mp) noexcept { Disk::update_titus_stats_for(mp); }
 
     void diskio_stats(absl::Time start) noexcept { Disk::diskio_stats(start); }
 
     void do_disk_stats(absl::Time start) noexcept { Disk::do_disk_stats(start); }
+
+    void diskio_latency_stats(absl::Time start) noexcept { Disk::diskio_latency_stats(start); }
+
+    void diskio_peak_stats(absl::Time start) noexcept { Disk::diskio_peak_stats(start); }
 };
 
 TEST(Disk, NodevFS)
@@ -75,6 +85,20 @@ TEST(Disk, MountPoints)
     EXPECT_EQ(fmt::format("{}", mount_points.at(15)), "MP{dev#=7:8,mp=/snap/lxd/21835,dev=/dev/loop8,type=squashfs}");
 }
 
+TEST(Disk, ParseMountInfo)
+{
+    std::unordered_set<std::string> unwanted{"proc"};
+    auto mount_points = atlasagent::parse_mountinfo(
+        "22 1 202:1 / / rw,relatime shared:1 - ext4 /dev/xvda1 rw\n"
+        "23 22 0:5 / /proc rw,nosuid - proc proc rw\n"
+        "24 22 259:0 / /mnt rw master:2 shared:3 - xfs /dev/nvme0n1 rw,attr2\n"
+        "25 22 259:0 /bind /data rw - xfs /dev/nvme0n1 rw\n",
+        unwanted);
+    ASSERT_EQ(mount_points.size(), 2);
+    EXPECT_EQ(fmt::format("{}", mount_points.at(0)), "MP{dev#=202:1,mp=/,dev=/dev/xvda1,type=ext4}");
+    EXPECT_EQ(fmt::format("{}", mount_points.at(1)), "MP{dev#=259:0,mp=/mnt,dev=/dev/nvme0n1,type=xfs}");
+}
+
 TEST(Disk, id)
 {
     using atlasagent::get_id_from_mountpoint;
@@ -183,6 +207,29 @@ TEST(Disk, get_disk_stats)
     EXPECT_EQ(14, s.size());
 }
 
+TEST(Disk, get_disk_stats_filtered)
+{
+    auto config = Config(WriterConfig(WriterTypes::Memory));
+    auto r = Registry(config);
+    TestDisk disk(&r);
+
+    disk.set_device_filter(NameFilter{"xvd*,md0", "xvdb"}, false);
+    auto s = disk.get_disk_stats();
+    std::vector<std::string> devices;
+    for (const auto& st : s)
+    {
+        devices.push_back(st.device);
+    }
+    EXPECT_EQ((std::vector<std::string>{"xvda", "xvdc", "md0"}), devices);
+
+    // 202:32 has a partition attribute in the test sysfs
+    disk.set_device_filter(NameFilter{"xvd*", ""}, true);
+    s = disk.get_disk_stats();
+    ASSERT_EQ(2, s.size());
+    EXPECT_EQ("xvda", s[0].device);
+    EXPECT_EQ("xvdb", s[1].device);
+}
+
 TEST(Disk, diskio_stats)
 {
     auto config = Config(WriterConfig(WriterTypes::Memory));
@@ -229,4 +276,228 @@ TEST(Disk, diskio_stats)
     EXPECT_EQ(messages.at(14), "C:disk.io.bytes,dev=md0,id=read:12092416.000000\n");
     EXPECT_EQ(messages.at(15), "C:disk.io.bytes,dev=md0,id=write:396387328.000000\n");
 }
+
+TEST(Disk, diskio_stats_device_changes)
+{
+    auto prefix = std::filesystem::temp_directory_path() / "disk_test_diskio";
+    std::filesystem::create_directories(prefix / "proc");
+    auto write_diskstats = [&](const std::string& contents)
+    { std::ofstream{prefix / "proc" / "diskstats"} << contents; };
+    auto has = [](const std::vector<std::string>& messages, std::string_view text)
+    { return std::any_of(messages.begin(), messages.end(), [&](const auto& m) { return m.find(text) != m.npos; }); };
+
+    auto config = Config(WriterConfig(WriterTypes::Memory));
+    auto r = Registry(config);
+    TestDisk disk(&r);
+    disk.set_prefix(prefix.string());
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+
+    auto start = absl::Now();
+    write_diskstats(
+        " 202 0 xvda 1 0 8 0 1 0 8 0 0 1000 1000\n"
+        " 202 80 xvdf 1 0 8 0 1 0 8 0 0 1000 1000\n");
+    disk.diskio_stats(start);
+    disk.set_last_updated(start);
+
+    // xvdf was detached, so its record is dropped
+    memoryWriter->Clear();
+    write_diskstats(" 202 0 xvda 1 0 8 0 1 0 8 0 0 7000 7000\n");
+    disk.diskio_stats(start + absl::Seconds(60));
+    disk.set_last_updated(start + absl::Seconds(60));
+    auto messages = memoryWriter->GetMessages();
+    EXPECT_TRUE(has(messages, "g:disk.percentBusy,dev=xvda:10.000000\n"));
+    EXPECT_FALSE(has(messages, "xvdf"));
+
+    // when it comes back its busy time is not compared against the old record
+    memoryWriter->Clear();
+    write_diskstats(
+        " 202 0 xvda 1 0 8 0 1 0 8 0 0 13000 13000\n"
+        " 202 80 xvdf 1 0 8 0 1 0 8 0 0 50000 50000\n");
+    disk.diskio_stats(start + absl::Seconds(120));
+    disk.set_last_updated(start + absl::Seconds(120));
+    messages = memoryWriter->GetMessages();
+    EXPECT_TRUE(has(messages, "C:disk.io.bytes,dev=xvdf,id=read:"));
+    EXPECT_FALSE(has(messages, "disk.percentBusy,dev=xvdf"));
+
+    // a different device on the same number gets new meters under its own name
+    memoryWriter->Clear();
+    write_diskstats(
+        " 202 0 xvda 1 0 8 0 1 0 8 0 0 19000 19000\n"
+        " 202 80 xvdg 1 0 8 0 1 0 8 0 0 56000 56000\n");
+    disk.diskio_stats(start + absl::Seconds(180));
+    disk.set_last_updated(start + absl::Seconds(180));
+    messages = memoryWriter->GetMessages();
+    EXPECT_TRUE(has(messages, "C:disk.io.bytes,dev=xvdg,id=read:"));
+    EXPECT_FALSE(has(messages, "disk.percentBusy,dev=xvdg"));
+    EXPECT_FALSE(has(messages, "xvdf"));
+
+    memoryWriter->Clear();
+    write_diskstats(
+        " 202 0 xvda 1 0 8 0 1 0 8 0 0 25000 25000\n"
+        " 202 80 xvdg 1 0 8 0 1 0 8 0 0 62000 62000\n");
+    disk.diskio_stats(start + absl::Seconds(240));
+    messages = memoryWriter->GetMessages();
+    EXPECT_TRUE(has(messages, "g:disk.percentBusy,dev=xvdg:10.000000\n"));
+
+    std::filesystem::remove_all(prefix);
+}
+
+TEST(Disk, diskio_latency_stats)
+{
+    auto config = Config(WriterConfig(WriterTypes::Memory));
+    auto r = Registry(config);
+    TestDisk disk(&r);
+
+    auto start = absl::Now();
+    disk.set_prefix("testdata/resources2");
+    disk.diskio_latency_stats(start);
+
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    memoryWriter->Clear();
+    disk.set_prefix("testdata/resources3");
+    disk.diskio_latency_stats(start + absl::Seconds(5));
+    auto messages = memoryWriter->GetMessages();
+
+    ASSERT_EQ(8, messages.size());
+    EXPECT_EQ(messages.at(0), "g:disk.io.queueDepth,dev=xvda:0.200000\n");
+    EXPECT_EQ(messages.at(1), "g:disk.io.await,dev=xvda,id=read:0.005000\n");
+    EXPECT_EQ(messages.at(2), "g:disk.io.await,dev=xvda,id=write:0.002000\n");
+    EXPECT_EQ(messages.at(3), "g:disk.io.await,dev=xvda,id=discard:0.003000\n");
+    EXPECT_EQ(messages.at(4), "g:disk.io.await,dev=xvda,id=flush:0.002000\n");
+    EXPECT_EQ(messages.at(5), "c:disk.io.discards,dev=xvda:10.000000\n");
+    EXPECT_EQ(messages.at(6), "c:disk.io.discardBytes,dev=xvda:1048576.000000\n");
+    EXPECT_EQ(messages.at(7), "c:disk.io.flushes,dev=xvda:50.000000\n");
+}
+
+TEST(Disk, diskio_peak_stats)
+{
+    auto config = Config(WriterConfig(WriterTypes::Memory));
+    auto r = Registry(config);
+    TestDisk disk(&r);
+
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    memoryWriter->Clear();
+    auto start = absl::Now();
+    disk.diskio_peak_stats(start);
+    EXPECT_TRUE(memoryWriter->GetMessages().empty());
+
+    disk.set_prefix("testdata/resources2");
+    disk.diskio_peak_stats(start + absl::Seconds(2));
+    auto messages = memoryWriter->GetMessages();
+
+    ASSERT_EQ(16, messages.size());
+    EXPECT_EQ(messages.at(0), "m:disk.io.peakOps,dev=xvda,id=read:50.000000\n");
+    EXPECT_EQ(messages.at(1), "m:disk.io.peakOps,dev=xvda,id=write:65.000000\n");
+    EXPECT_EQ(messages.at(2), "m:disk.io.peakBytes,dev=xvda,id=read:2560000.000000\n");
+    EXPECT_EQ(messages.at(3), "m:disk.io.peakBytes,dev=xvda,id=write:702464.000000\n");
+    EXPECT_EQ(messages.at(12), "m:disk.io.peakOps,dev=md0,id=read:50.000000\n");
+}
+
+TEST(Disk, StatvfsPool)
+{
+    std::promise<void> release;
+    auto released = release.get_future().share();
+    // the workers are detached and can outlive this test, so they share their state by value
+    auto hung_calls = std::make_shared<std::atomic<int>>(0);
+    auto fail = std::make_shared<std::atomic<bool>>(false);
+    auto stat_fn = [released, hung_calls, fail](const char* path, struct statvfs* st)
+    {
+        std::string_view p{path};
+        if (p == "/hung")
+        {
+            (*hung_calls)++;
+            released.wait();
+        }
+        if (p == "/missing" || (p == "/" && *fail))
+        {
+            errno = ENOENT;
+            return -1;
+        }
+        *st = {};
+        st->f_blocks = 42;
+        return 0;
+    };
+    atlasagent::StatvfsPool pool{2, absl::Milliseconds(50), absl::Minutes(5), stat_fn};
+
+    auto now = absl::Now();
+    std::vector<std::string> paths{"/", "/hung", "/missing"};
+    auto results = pool.stat(paths, now);
+    ASSERT_EQ(results.size(), 3);
+    ASSERT_TRUE(results[0].st);
+    EXPECT_EQ(results[0].st->f_blocks, 42);
+    EXPECT_FALSE(results[1].st);
+    EXPECT_EQ(results[1].error, ETIMEDOUT);
+    EXPECT_FALSE(results[2].st);
+    EXPECT_EQ(results[2].error, ENOENT);
+
+    // past the backoff, but the hung call has not returned so it is not queued again
+    results = pool.stat(paths, now + absl::Minutes(3));
+    EXPECT_EQ(*hung_calls, 1);
+    EXPECT_EQ(results[1].error, ETIMEDOUT);
+
+    release.set_value();
+    for (int i = 0; i < 100 && !results[1].st; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        results = pool.stat(paths, now + absl::Minutes(4));
+    }
+    EXPECT_TRUE(results[1].st);
+
+    // the last good value is reported after a failure until it goes stale
+    *fail = true;
+    results = pool.stat(paths, now + absl::Minutes(8));
+    EXPECT_EQ(results[0].error, ENOENT);
+    EXPECT_TRUE(results[0].st);
+    results = pool.stat(paths, now + absl::Minutes(10));
+    EXPECT_FALSE(results[0].st);
+}
+
+TEST(Disk, StatvfsPoolMoreHungThanWorkers)
+{
+    std::promise<void> release;
+    auto released = release.get_future().share();
+    auto hung_calls = std::make_shared<std::atomic<int>>(0);
+    auto ok_calls = std::make_shared<std::atomic<int>>(0);
+    auto stat_fn = [released, hung_calls, ok_calls](const char* path, struct statvfs* st)
+    {
+        if (std::string_view{path}.starts_with("/hung"))
+        {
+            (*hung_calls)++;
+            released.wait();
+        }
+        else
+        {
+            (*ok_calls)++;
+        }
+        *st = {};
+        st->f_blocks = 42;
+        return 0;
+    };
+    atlasagent::StatvfsPool pool{2, absl::Milliseconds(50), absl::Minutes(5), stat_fn};
+
+    // both workers block on the first two mounts, the rest get replacement workers
+    auto now = absl::Now();
+    std::vector<std::string> paths{"/hung1", "/hung2", "/hung3", "/ok"};
+    auto results = pool.stat(paths, now);
+    ASSERT_EQ(results.size(), 4);
+    EXPECT_EQ(*hung_calls, 3);
+    EXPECT_EQ(*ok_calls, 1);
+    for (size_t i = 0; i < 3; ++i)
+    {
+        EXPECT_FALSE(results[i].st);
+        EXPECT_EQ(results[i].error, ETIMEDOUT);
+    }
+    ASSERT_TRUE(results[3].st);
+    EXPECT_EQ(results[3].error, 0);
+
+    // the healthy mount was not charged a backoff and keeps getting fresh values
+    for (int i = 1; i <= 6; ++i)
+    {
+        results = pool.stat(paths, now + absl::Minutes(i));
+        EXPECT_EQ(*ok_calls, i + 1);
+        ASSERT_TRUE(results[3].st);
+    }
+    EXPECT_EQ(*hung_calls, 3);
+    release.set_value();
+}
 }  // namespace
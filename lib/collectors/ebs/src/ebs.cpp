@@ -2,10 +2,16 @@
 
 #include <lib/util/src/util.h>
 
+#include <absl/strings/ascii.h>
+#include <absl/time/clock.h>
+
+#include <algorithm>
+#include <cstring>
 #include <fcntl.h>
 #include <filesystem>
+#include <future>
 #include <regex>
-#include <sys/ioctl.h>
+#include <sys/inotify.h>
 #include <unistd.h>
 
 struct EBSMetricConstants
@@ -26,6 +32,10 @@ struct EBSMetricConstants
     static constexpr auto ebsTP{"aws.ebs.perfExceededTput"};
     static constexpr auto ebsQueueLength{"aws.ebs.volumeQueueLength"};
     static constexpr auto ebsHistogram{"aws.ebs.ioLatencyHistogram"};
+    static constexpr auto ebsLatency{"aws.ebs.ioLatency"};
+    static constexpr auto ebsPeakIOPS{"aws.ebs.peakPerfExceededIOPS"};
+    static constexpr auto ebsPeakTP{"aws.ebs.peakPerfExceededTput"};
+    static constexpr auto ebsPeakQueueLength{"aws.ebs.peakVolumeQueueLength"};
 
     // Conversion Constants
     static constexpr auto ebsMicrosecondsToSeconds{.000001};
@@ -121,20 +131,96 @@ catch (const std::exception& e)
     return std::nullopt;
 }
 
-EBSCollector::EBSCollector(Registry* registry, const std::unordered_set<std::string>& config)
-    : config{config}, registry_{registry}
+std::vector<std::string> discover_ebs_devices(const char* sysClassNvme)
+try
 {
+    std::vector<std::string> devices{};
+    if (std::filesystem::is_directory(sysClassNvme) == false)
+    {
+        return devices;
+    }
+    for (const auto& controller : std::filesystem::directory_iterator(sysClassNvme))
+    {
+        // the model is padded with spaces
+        auto model = atlasagent::read_file((controller.path() / "model").string());
+        if (model.has_value() == false || model->empty() ||
+            absl::StripTrailingAsciiWhitespace(model->front()) != EBSConstants::EBSModel)
+        {
+            continue;
+        }
+
+        // EBS volumes have a single namespace, nvmeXn1
+        auto name = controller.path().filename().string();
+        std::string nameSpace{};
+        for (const auto& entry : std::filesystem::directory_iterator(controller.path()))
+        {
+            auto entryName = entry.path().filename().string();
+            if (entryName.starts_with(name + "n") && (nameSpace.empty() || entryName < nameSpace))
+            {
+                nameSpace = entryName;
+            }
+        }
+        devices.emplace_back(fmt::format("/dev/{}", nameSpace.empty() ? name : nameSpace));
+    }
+    std::sort(devices.begin(), devices.end());
+    return devices;
+}
+catch (const std::exception& e)
+{
+    atlasagent::Logger()->error("Exception: {} in discover_ebs_devices", e.what());
+    return {};
+}
+
+EBSCollector::EBSCollector(Registry* registry, const std::unordered_set<std::string>& config,
+                           const char* sysClassNvme, const char* devPath)
+    : config{config}, registry_{registry}, sysClassNvme_{sysClassNvme}
+{
+    static constexpr const char* kBinsEnvVar = "ATLAS_ENABLE_EBS_HISTOGRAM_BINS";
+    auto binsVar = std::getenv(kBinsEnvVar);
+    publishBins_ = binsVar != nullptr && std::strcmp(binsVar, "true") == 0;
+    if (publishBins_)
+    {
+        atlasagent::Logger()->info("EBS latency histogram bins have been enabled using the env variable {}",
+                                   kBinsEnvVar);
+    }
+
+    static constexpr const char* kSampleEnvVar = "ATLAS_EBS_THROTTLE_SAMPLE_SECONDS";
+    if (auto sampleVar = std::getenv(kSampleEnvVar); sampleVar != nullptr)
+    {
+        auto seconds = std::strtol(sampleVar, nullptr, 10);
+        if (seconds >= 1 && seconds <= 5)
+        {
+            sampler_ = std::make_unique<EBSThrottleSampler>(registry, absl::Seconds(seconds));
+            atlasagent::Logger()->info("Sampling EBS throttling every {}s", seconds);
+        }
+        else
+        {
+            atlasagent::Logger()->warn("Ignoring {}={}, expected 1 to 5", kSampleEnvVar, sampleVar);
+        }
+    }
+
+    devWatch_ = atlasagent::UnixFile{inotify_init1(IN_NONBLOCK | IN_CLOEXEC)};
+    if (devWatch_ < 0 || inotify_add_watch(devWatch_, devPath, IN_CREATE | IN_DELETE) < 0)
+    {
+        atlasagent::Logger()->info("Unable to watch {}, EBS volumes are only discovered at startup", devPath);
+        devWatch_ = atlasagent::UnixFile{-1};
+    }
+    rescan_devices();
+    if (sampler_)
+    {
+        sampler_->start();
+    }
 }
 
 std::optional<EBSCollector> EBSCollector::Create(Registry* registry)
 {
     auto config = parse_ebs_config_directory(EBSConstants::ConfigPath);
-    if (!config.has_value())
+    if (!config.has_value() && std::filesystem::is_directory(EBSConstants::SysClassNvme) == false)
     {
         atlasagent::Logger()->info("EBS Monitoring is disabled.");
         return std::nullopt;
     }
-    return std::optional<EBSCollector>{std::in_place, registry, config.value()};
+    return std::optional<EBSCollector>{std::in_place, registry, config.value_or(std::unordered_set<std::string>{})};
 }
 
 void EBSCollector::Collect(std::optional<EBSCollector>& self)
@@ -145,37 +231,103 @@ void EBSCollector::Collect(std::optional<EBSCollector>& self)
     }
 }
 
-bool EBSCollector::query_stats_from_device(const std::string& device, nvme_get_amzn_stats_logpage& stats)
-try
+void EBSCollector::rescan_devices()
 {
-    nvme_admin_command admin_cmd = {};
-    admin_cmd.opcode = NVMeCommands::GetLogPage;
-    admin_cmd.addr = (uint64_t)&stats;
-    admin_cmd.alen = sizeof(stats);
-    admin_cmd.nsid = 1;
-    admin_cmd.cdw10 = NVMeCommands::StatsLogPageId | (1024 << 16);
+    std::vector<std::string> paths{config.begin(), config.end()};
+    for (auto& device : discover_ebs_devices(sysClassNvme_.c_str()))
+    {
+        paths.emplace_back(std::move(device));
+    }
+    std::sort(paths.begin(), paths.end());
+    paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
 
-    int fd = open(device.c_str(), O_RDONLY);
-    if (fd == -1)
+    // keep the open fds of devices that are still present
+    std::vector<EBSDevice> devices{};
+    devices.reserve(paths.size());
+    for (auto& path : paths)
+    {
+        auto it = std::find_if(devices_.begin(), devices_.end(), [&](const EBSDevice& d) { return d.path == path; });
+        if (it != devices_.end())
+        {
+            devices.emplace_back(std::move(*it));
+        }
+        else
+        {
+            atlasagent::Logger()->info("Monitoring EBS device {}", path);
+            devices.emplace_back(EBSDevice{std::move(path)});
+        }
+    }
+    devices_ = std::move(devices);
+
+    if (sampler_)
+    {
+        std::vector<std::string> sampled{};
+        sampled.reserve(devices_.size());
+        for (const auto& device : devices_)
+        {
+            sampled.emplace_back(device.path);
+        }
+        sampler_->setDevices(sampled);
+    }
+}
+
+// Whether an nvme device node was created or removed under /dev since the last call
+bool EBSCollector::devices_changed()
+{
+    if (devWatch_ < 0)
     {
-        std::error_code ec(errno, std::system_category());
-        atlasagent::Logger()->error("Failed to open device {}: {}", device, ec.message());
         return false;
     }
+    bool changed{false};
+    alignas(inotify_event) char buf[4096];
+    ssize_t len;
+    while ((len = read(devWatch_, buf, sizeof buf)) > 0)
+    {
+        for (char* p = buf; p < buf + len;)
+        {
+            auto* event = reinterpret_cast<inotify_event*>(p);
+            if (event->len > 0 && std::string_view{event->name}.starts_with("nvme"))
+            {
+                changed = true;
+            }
+            // the queue overflowed, so we may have missed an nvme event
+            changed = changed || (event->mask & IN_Q_OVERFLOW) != 0;
+            p += sizeof(inotify_event) + event->len;
+        }
+    }
+    return changed;
+}
 
-    int ret = ioctl(fd, NVMeCommands::AdminCommand, &admin_cmd);
-    close(fd);
+bool EBSCollector::query_stats_from_device(EBSDevice& device, nvme_get_amzn_stats_logpage& stats)
+try
+{
+    if (device.fd < 0)
+    {
+        device.fd = atlasagent::UnixFile{open(device.path.c_str(), O_RDONLY | O_CLOEXEC)};
+        if (device.fd < 0)
+        {
+            std::error_code ec(errno, std::system_category());
+            atlasagent::Logger()->error("Failed to open device {}: {}", device.path, ec.message());
+            return false;
+        }
+        // a reopened device may be a different volume, so start the histograms and counters over
+        device.readLatency.valid = false;
+        device.writeLatency.valid = false;
+        device.prevExceeded.reset();
+    }
 
-    if (ret < 0)
+    if (!atlasagent::nvme_get_log_page(device.fd, NVMeCommands::StatsLogPageId, 1, &stats, sizeof(stats)))
     {
         std::error_code ec(errno, std::system_category());
-        atlasagent::Logger()->error("Failed to call ioctl on device {}: {}", device, ec.message());
+        atlasagent::Logger()->error("Failed to call ioctl on device {}: {}", device.path, ec.message());
+        // the device may have been detached and replaced, reopen it next time
+        device.fd = atlasagent::UnixFile{-1};
         return false;
     }
 
     if (stats._magic != NVMeCommands::StatsMagic)
     {
-        atlasagent::Logger()->error("Not an EBS device: {}", device);
+        atlasagent::Logger()->error("Not an EBS device: {}", device.path);
         return false;
     }
 
@@ -183,12 +335,45 @@ try
 }
 catch (const std::exception& e)
 {
-    atlasagent::Logger()->error("Exception: {} in parse_service_monitor_config_directory", e.what());
+    atlasagent::Logger()->error("Exception: {} in query_stats_from_device", e.what());
     return false;
 }
 
-bool EBSCollector::handle_histogram(const ebs_nvme_histogram& histogram, const std::string& devicePath,
-                                    const std::string& type)
+std::optional<double> ebs_histogram_percentile(const ebs_nvme_histogram& histogram, const uint32_t* deltas, double q)
+{
+    uint64_t total{0};
+    for (uint64_t i = 0; i < histogram.num_bins; i++)
+    {
+        total += deltas[i];
+    }
+    if (total == 0)
+    {
+        return std::nullopt;
+    }
+
+    auto rank = q * total;
+    uint64_t seen{0};
+    for (uint64_t i = 0; i < histogram.num_bins; i++)
+    {
+        if (deltas[i] == 0 || seen + deltas[i] < rank)
+        {
+            seen += deltas[i];
+            continue;
+        }
+        const auto& bin = histogram.bins[i];
+        // the last bin is open ended
+        if (i == histogram.num_bins - 1)
+        {
+            return static_cast<double>(bin.lower);
+        }
+        auto fraction = (rank - seen) / deltas[i];
+        return bin.lower + fraction * (bin.upper - bin.lower);
+    }
+    return static_cast<double>(histogram.bins[histogram.num_bins - 1].lower);
+}
+
+bool EBSCollector::handle_histogram(const ebs_nvme_histogram& histogram, EBSHistogramState& prev,
+                                    const std::string& devicePath, const std::string& type)
 {
     if (histogram.num_bins > AtlasNamingConvention.size())
     {
@@ -196,16 +381,45 @@ bool EBSCollector::handle_histogram(const ebs_nvme_histogram& histogram, const s
                                     AtlasNamingConvention.size());
         return false;
     }
+    if (publishBins_)
+    {
+        for (uint64_t i = 0; i < histogram.num_bins; i++)
+        {
+            ebsHistogram(registry_, EBSMC::ebsHistogram, devicePath, type, AtlasNamingConvention.at(i))
+                .Set(histogram.bins[i].count);
+        }
+    }
+
+    // the bin counts are cumulative 32 bit counters, so unsigned subtraction handles a wrap
+    std::array<uint32_t, 64> deltas{};
     for (uint64_t i = 0; i < histogram.num_bins; i++)
     {
-        ebsHistogram(registry_, EBSMC::ebsHistogram, devicePath, type, AtlasNamingConvention.at(i))
-            .Set(histogram.bins[i].count);
+        deltas[i] = histogram.bins[i].count - prev.counts[i];
+        prev.counts[i] = histogram.bins[i].count;
+    }
+    auto first = !prev.valid;
+    prev.valid = true;
+    if (first)
+    {
+        return true;
+    }
+
+    static constexpr std::pair<const char*, double> percentiles[] = {
+        {"p50", 0.50}, {"p90", 0.90}, {"p99", 0.99}, {"max", 1.0}};
+    for (const auto& [name, q] : percentiles)
+    {
+        // an idle interval reports 0 rather than repeating the last percentile until the gauge expires
+        auto latency = ebs_histogram_percentile(histogram, deltas.data(), q).value_or(0.0);
+        registry_
+            ->CreateGauge(EBSMC::ebsLatency, {{"dev", devicePath}, {"id", type}, {"percentile", name}})
+            .Set(latency * EBSMC::ebsMicrosecondsToSeconds);
     }
     return true;
 }
 
-bool EBSCollector::update_metrics(const std::string& devicePath, const nvme_get_amzn_stats_logpage& stats)
+bool EBSCollector::update_metrics(EBSDevice& device, const nvme_get_amzn_stats_logpage& stats)
 {
+    const auto& devicePath = device.path;
     if (this->registry_ == nullptr)
     {
         return false;
@@ -235,13 +449,13 @@ bool EBSCollector::update_metrics(const std::string& devicePath, const nvme_get_
     ebsGauge(registry_, EBSMC::ebsQueueLength, devicePath).Set(stats.volume_queue_length);
 
     bool success{true};
-    if (false == handle_histogram(stats.read_io_latency_histogram, devicePath, EBSMC::ReadOp))
+    if (false == handle_histogram(stats.read_io_latency_histogram, device.readLatency, devicePath, EBSMC::ReadOp))
     {
         atlasagent::Logger()->error("Failed to handle read histogram for device {}", devicePath);
         success = false;
     }
 
-    if (false == handle_histogram(stats.write_io_latency_histogram, devicePath, EBSMC::WriteOp))
+    if (false == handle_histogram(stats.write_io_latency_histogram, device.writeLatency, devicePath, EBSMC::WriteOp))
     {
         atlasagent::Logger()->error("Failed to handle write histogram for device {}", devicePath);
         success = false;
@@ -250,26 +464,196 @@ bool EBSCollector::update_metrics(const std::string& devicePath, const nvme_get_
     return success;
 }
 
+// Each log page ioctl is a round trip to the EBS controller, so query all the devices at once
+std::vector<bool> EBSCollector::query_all_devices(std::vector<nvme_get_amzn_stats_logpage>& stats)
+{
+    stats.assign(devices_.size(), nvme_get_amzn_stats_logpage{});
+    std::vector<std::future<bool>> queries{};
+    queries.reserve(devices_.size());
+    for (size_t i = 0; i < devices_.size(); i++)
+    {
+        queries.emplace_back(std::async(std::launch::async, &EBSCollector::query_stats_from_device,
+                                        std::ref(devices_[i]), std::ref(stats[i])));
+    }
+    std::vector<bool> results(devices_.size());
+    for (size_t i = 0; i < devices_.size(); i++)
+    {
+        results[i] = queries[i].get();
+    }
+    return results;
+}
+
 bool EBSCollector::gather_metrics()
 {
+    if (devices_changed())
+    {
+        rescan_devices();
+    }
+
+    std::vector<nvme_get_amzn_stats_logpage> stats;
+    auto queried = query_all_devices(stats);
+
     bool success{true};
-    // Iterate through all the devices in the config
-    for (const auto& device : config)
+    for (size_t i = 0; i < devices_.size(); i++)
     {
-        // Gather statistics for each device
-        nvme_get_amzn_stats_logpage stats{};
-        if (false == query_stats_from_device(device, stats))
+        const auto& device = devices_[i].path;
+        if (false == queried[i])
         {
             atlasagent::Logger()->error("Failed to query stats from device {}", device);
             success = false;
             continue;
         }
         // Push the metrics to spectatorD
-        if (update_metrics(device, stats) == false)
+        if (update_metrics(devices_[i], stats[i]) == false)
         {
             atlasagent::Logger()->error("Failed to update metrics for device {}", device);
             success = false;
         }
     }
     return success;
-}
\ No newline at end of file
+}
+
+void EBSCollector::Sample(std::optional<EBSCollector>& self)
+{
+    if (self.has_value() && self->sampler_)
+    {
+        self->sampler_->publish();
+    }
+}
+
+std::array<std::optional<double>, 4> ebs_exceeded_fractions(const std::optional<std::array<uint64_t, 4>>& prev,
+                                                            const std::array<uint64_t, 4>& cur,
+                                                            double elapsedMicros)
+{
+    std::array<std::optional<double>, 4> fractions{};
+    if (prev.has_value() == false || elapsedMicros <= 0)
+    {
+        return fractions;
+    }
+    for (size_t k = 0; k < cur.size(); k++)
+    {
+        if (cur[k] >= prev->at(k))
+        {
+            fractions[k] = std::min((cur[k] - prev->at(k)) / elapsedMicros, 1.0);
+        }
+    }
+    return fractions;
+}
+
+EBSThrottleSampler::EBSThrottleSampler(Registry* registry, absl::Duration interval)
+    : registry_{registry}, interval_{interval}
+{
+}
+
+EBSThrottleSampler::~EBSThrottleSampler()
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+}
+
+void EBSThrottleSampler::start() { thread_ = std::thread{&EBSThrottleSampler::run, this}; }
+
+void EBSThrottleSampler::setDevices(const std::vector<std::string>& paths)
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    pendingPaths_ = paths;
+}
+
+void EBSThrottleSampler::run()
+{
+    auto next = absl::Now();
+    std::unique_lock<std::mutex> lock{mutex_};
+    while (!stop_)
+    {
+        auto paths = std::move(pendingPaths_);
+        pendingPaths_.reset();
+        lock.unlock();
+
+        // keep the open fds and previous readings of devices that are still monitored
+        if (paths.has_value())
+        {
+            std::vector<EBSDevice> devices{};
+            devices.reserve(paths->size());
+            for (auto& path : *paths)
+            {
+                auto it = std::find_if(devices_.begin(), devices_.end(),
+                                       [&](const EBSDevice& d) { return d.path == path; });
+                devices.emplace_back(it != devices_.end() ? std::move(*it) : EBSDevice{std::move(path)});
+            }
+            devices_ = std::move(devices);
+        }
+        sample(absl::Now());
+
+        lock.lock();
+        // fixed-rate schedule, skipping ticks rather than bunching up after a slow round
+        next += interval_;
+        if (next < absl::Now())
+        {
+            next = absl::Now() + interval_;
+        }
+        cv_.wait_until(lock, absl::ToChronoTime(next), [this] { return stop_; });
+    }
+}
+
+void EBSThrottleSampler::sample(absl::Time now)
+{
+    nvme_get_amzn_stats_logpage st{};
+    for (auto& device : devices_)
+    {
+        if (false == EBSCollector::query_stats_from_device(device, st))
+        {
+            continue;
+        }
+        std::array<uint64_t, 4> exceeded{
+            st.ebs_volume_performance_exceeded_iops, st.ec2_instance_ebs_performance_exceeded_iops,
+            st.ebs_volume_performance_exceeded_tp, st.ec2_instance_ebs_performance_exceeded_tp};
+        auto fractions =
+            ebs_exceeded_fractions(device.prevExceeded, exceeded, absl::ToDoubleMicroseconds(now - device.prevSample));
+        device.prevExceeded = exceeded;
+        device.prevSample = now;
+
+        std::lock_guard<std::mutex> lock{mutex_};
+        auto& peaks = peaks_[device.path];
+        peaks.queueLength = std::max(peaks.queueLength, static_cast<double>(st.volume_queue_length));
+        for (size_t k = 0; k < fractions.size(); k++)
+        {
+            if (fractions[k].has_value())
+            {
+                peaks.exceeded[k] = std::max(peaks.exceeded[k].value_or(0.0), fractions[k].value());
+            }
+        }
+    }
+}
+
+void EBSThrottleSampler::publish()
+{
+    std::unordered_map<std::string, Peaks> peaks;
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        std::swap(peaks, peaks_);
+    }
+
+    static constexpr std::pair<const char*, const char*> kinds[] = {{EBSMC::ebsPeakIOPS, EBSMC::Volume},
+                                                                    {EBSMC::ebsPeakIOPS, EBSMC::Instance},
+                                                                    {EBSMC::ebsPeakTP, EBSMC::Volume},
+                                                                    {EBSMC::ebsPeakTP, EBSMC::Instance}};
+    for (const auto& [path, peak] : peaks)
+    {
+        registry_->CreateMaxGauge(EBSMC::ebsPeakQueueLength, {{"dev", path}}).Set(peak.queueLength);
+        for (size_t k = 0; k < peak.exceeded.size(); k++)
+        {
+            if (peak.exceeded[k].has_value())
+            {
+                registry_->CreateMaxGauge(kinds[k].first, {{"dev", path}, {"id", kinds[k].second}})
+                    .Set(peak.exceeded[k].value());
+            }
+        }
+    }
+}
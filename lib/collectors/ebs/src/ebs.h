@@ -1,43 +1,24 @@
 #pragma once
+#include <lib/collectors/nvme/src/nvme_log_page.h>
+#include <lib/files/src/files.h>
 #include <thirdparty/spectator-cpp/spectator/registry.h>
 
+#include <absl/time/time.h>
+
+#include <array>
+#include <condition_variable>
 #include <cstdint>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
-// Constants for NVMe commands
-struct NVMeCommands
-{
-    static constexpr auto GetLogPage = 0x02;
-    static constexpr auto AdminCommand = 0xC0484E41;
-    static constexpr auto StatsLogPageId = 0xD0;
-    static constexpr auto StatsMagic = 0x3C23B510;
-};
-
 // Structures
 #pragma pack(push, 1)
-struct nvme_admin_command
-{
-    uint8_t opcode;
-    uint8_t flags;
-    uint16_t cid;
-    uint32_t nsid;
-    uint64_t _reserved0;
-    uint64_t mptr;
-    uint64_t addr;
-    uint32_t mlen;
-    uint32_t alen;
-    uint32_t cdw10;
-    uint32_t cdw11;
-    uint32_t cdw12;
-    uint32_t cdw13;
-    uint32_t cdw14;
-    uint32_t cdw15;
-    uint64_t _reserved1;
-};
-
 struct nvme_histogram_bin
 {
     uint64_t lower;
@@ -105,36 +86,139 @@ inline auto ebsHistogram(Registry* registry, const std::string_view name, const
     return registry->CreateMonotonicCounter(std::string(name), tags);
 }
 
+// Bin counts of a latency histogram at the previous collection, so percentiles cover just the interval
+struct EBSHistogramState
+{
+    std::array<uint32_t, 64> counts{};
+    bool valid{false};
+};
+
+// A monitored volume. The fd stays open between collections and is reopened after an ioctl failure.
+struct EBSDevice
+{
+    std::string path;
+    atlasagent::UnixFile fd{-1};
+    EBSHistogramState readLatency{};
+    EBSHistogramState writeLatency{};
+    // perf exceeded counters (microseconds) at the previous throttle sample, and when it was taken
+    std::optional<std::array<uint64_t, 4>> prevExceeded{};
+    absl::Time prevSample{absl::InfinitePast()};
+};
+
+// The latency in microseconds below which a fraction `q` of the operations counted in `deltas` fall,
+// interpolated within the bin. Returns nullopt when no operations were counted.
+std::optional<double> ebs_histogram_percentile(const ebs_nvme_histogram& histogram, const uint32_t* deltas, double q);
+
+// The fraction of the `elapsedMicros` since the previous sample that each perf exceeded counter
+// (microseconds) spent over its limit, capped at 1. Empty on the first sample, and for a counter that
+// went backwards.
+std::array<std::optional<double>, 4> ebs_exceeded_fractions(const std::optional<std::array<uint64_t, 4>>& prev,
+                                                            const std::array<uint64_t, 4>& cur,
+                                                            double elapsedMicros);
+
+// Samples the perf exceeded counters and queue length of every volume from a background thread, and
+// keeps the peaks until the one second loop publishes them. The ioctls are issued one after another
+// on the sampler's own fds, so a slow controller delays only this thread and no thread is created per
+// sample.
+class EBSThrottleSampler
+{
+   public:
+    EBSThrottleSampler(Registry* registry, absl::Duration interval);
+    ~EBSThrottleSampler();
+
+    EBSThrottleSampler(const EBSThrottleSampler&) = delete;
+    EBSThrottleSampler& operator=(const EBSThrottleSampler&) = delete;
+
+    void start();
+    // the volumes to sample, picked up before the next sample
+    void setDevices(const std::vector<std::string>& paths);
+    void publish();
+
+   private:
+    struct Peaks
+    {
+        double queueLength{-1};
+        std::array<std::optional<double>, 4> exceeded{};
+    };
+
+    void run();
+    void sample(absl::Time now);
+
+    Registry* registry_;
+    absl::Duration interval_;
+    std::vector<EBSDevice> devices_;  // only used by the sampler thread
+
+    std::mutex mutex_;  // guards everything below
+    std::condition_variable cv_;
+    std::optional<std::vector<std::string>> pendingPaths_;
+    std::unordered_map<std::string, Peaks> peaks_;
+    bool stop_{false};
+    std::thread thread_;
+};
+
+struct EBSConstants
+{
+    static constexpr auto ConfigPath{"/etc/atlas-system-agent/conf.d"};
+    static constexpr auto ConfigFileExtPattern = ".*\\.ebs-devices$";
+    static constexpr auto SysClassNvme{"/sys/class/nvme"};
+    static constexpr auto EBSModel{"Amazon Elastic Block Store"};
+    static constexpr auto DevPath{"/dev"};
+};
+
 class EBSCollector
 {
    private:
-    // TODO: Change config to a vector to improve performance
-    // PreReq: Break collect_system_metrics into more functions
+    // devices listed in conf.d, always monitored
     std::unordered_set<std::string> config;
     Registry* registry_;
-    bool query_stats_from_device(const std::string& device, nvme_get_amzn_stats_logpage& stats);
-    bool update_metrics(const std::string& devicePath, const nvme_get_amzn_stats_logpage& stats);
-    bool handle_histogram(const ebs_nvme_histogram& histogram, const std::string& devicePath, const std::string& id);
+    std::vector<EBSDevice> devices_;
+    // discovered volumes are the EBS controllers listed here
+    std::string sysClassNvme_;
+    // watches /dev so volumes attached or detached at runtime are picked up
+    atlasagent::UnixFile devWatch_{-1};
+    // publish the raw histogram bins in addition to the percentiles
+    bool publishBins_{false};
+    // samples the perf exceeded counters, when ATLAS_EBS_THROTTLE_SAMPLE_SECONDS is set
+    std::unique_ptr<EBSThrottleSampler> sampler_;
+
+    void rescan_devices();
+    std::vector<bool> query_all_devices(std::vector<nvme_get_amzn_stats_logpage>& stats);
+    bool update_metrics(EBSDevice& device, const nvme_get_amzn_stats_logpage& stats);
+
+   protected:
+    // protected for testing
+    bool devices_changed();
+    bool handle_histogram(const ebs_nvme_histogram& histogram, EBSHistogramState& prev, const std::string& devicePath,
+                          const std::string& id);
+    [[nodiscard]] const std::vector<EBSDevice>& devices() const noexcept { return devices_; }
 
    public:
-    EBSCollector(Registry* registry, const std::unordered_set<std::string>& config);
+    EBSCollector(Registry* registry, const std::unordered_set<std::string>& config,
+                 const char* sysClassNvme = EBSConstants::SysClassNvme, const char* devPath = EBSConstants::DevPath);
 
     bool gather_metrics();
 
-    // Availability-aware factory: builds a collector only when a valid config directory is found (logging
-    // when monitoring is disabled), otherwise returns nullopt.
+    // Reads the stats log page, opening the device first if needed.
+    static bool query_stats_from_device(EBSDevice& device, nvme_get_amzn_stats_logpage& stats);
+
+    // Availability-aware factory: builds a collector when a valid config directory is found or the host has
+    // NVMe controllers to discover EBS volumes on (logging when monitoring is disabled), otherwise returns
+    // nullopt.
     static std::optional<EBSCollector> Create(Registry* registry);
 
     // Gathers metrics from `self` only when present; a no-op when disabled, logging on gather failure.
     // The mirror of Create(): it owns the has_value() guard so callers don't repeat it.
     static void Collect(std::optional<EBSCollector>& self);
-};
 
-struct EBSConstants
-{
-    static constexpr auto ConfigPath{"/etc/atlas-system-agent/conf.d"};
-    static constexpr auto ConfigFileExtPattern = ".*\\.ebs-devices$";
+    // Called every second. When ATLAS_EBS_THROTTLE_SAMPLE_SECONDS is 1 to 5, a background thread samples
+    // the perf exceeded counters at that interval, and this publishes the peak fraction of an interval
+    // spent throttled, along with the peak queue length, so bursts too short to show up in the per minute
+    // counters are visible. It does not wait for the devices.
+    static void Sample(std::optional<EBSCollector>& self);
 };
 
+// The namespace block devices (/dev/nvmeXn1) of NVMe controllers whose model is EBS
+std::vector<std::string> discover_ebs_devices(const char* sysClassNvme);
+
 std::optional<std::vector<std::string>> ebs_parse_regex_config_file(const char* configFilePath);
 std::optional<std::unordered_set<std::string>> parse_ebs_config_directory(const char* directoryPath);
\ No newline at end of file
@@ -0,0 +1,156 @@
+#include <lib/collectors/ebs/src/ebs.h>
+
+#include <thirdparty/spectator-cpp/spectator/registry.h>
+#include <thirdparty/spectator-cpp/libs/writer/writer_wrapper/writer_test_helper.h>
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+constexpr auto kClassNvme = "lib/collectors/nvme/test/resources/class_nvme";
+
+class EBSCollectorTest : public EBSCollector
+{
+   public:
+    EBSCollectorTest(Registry* registry, const std::unordered_set<std::string>& config, const char* devPath)
+        : EBSCollector{registry, config, kClassNvme, devPath}
+    {
+    }
+    using EBSCollector::devices;
+    using EBSCollector::devices_changed;
+    using EBSCollector::handle_histogram;
+};
+
+// bins of 0-1ms, 1-3ms, 3-10ms and 10ms and up, in microseconds
+ebs_nvme_histogram test_histogram()
+{
+    ebs_nvme_histogram histogram{};
+    histogram.num_bins = 4;
+    histogram.bins[0] = {0, 1000, 0, 0};
+    histogram.bins[1] = {1000, 3000, 0, 0};
+    histogram.bins[2] = {3000, 10000, 0, 0};
+    histogram.bins[3] = {10000, UINT64_MAX, 0, 0};
+    return histogram;
+}
+
+TEST(EBS, DiscoverDevices)
+{
+    // nvme0 is instance storage and nvme-subsys0 has no model
+    EXPECT_EQ(discover_ebs_devices(kClassNvme), (std::vector<std::string>{"/dev/nvme1n1"}));
+    EXPECT_TRUE(discover_ebs_devices("lib/collectors/nvme/test/resources/missing").empty());
+}
+
+TEST(EBS, DevicesChanged)
+{
+    auto dev = std::filesystem::temp_directory_path() / "ebs_test_dev";
+    std::filesystem::remove_all(dev);
+    std::filesystem::create_directories(dev);
+
+    auto config = Config(WriterConfig(WriterTypes::Memory));
+    auto r = Registry(config);
+    EBSCollectorTest ebs{&r, {"/dev/nvme1n1", "/dev/nvme9n1"}, dev.c_str()};
+    ASSERT_EQ(ebs.devices().size(), 2);
+    EXPECT_EQ(ebs.devices()[0].path, "/dev/nvme1n1");
+    EXPECT_EQ(ebs.devices()[1].path, "/dev/nvme9n1");
+    EXPECT_FALSE(ebs.devices_changed());
+
+    // only nvme device nodes count
+    std::ofstream{dev / "sda1"};
+    EXPECT_FALSE(ebs.devices_changed());
+    std::ofstream{dev / "nvme2n1"};
+    EXPECT_TRUE(ebs.devices_changed());
+    EXPECT_FALSE(ebs.devices_changed());
+    std::filesystem::remove(dev / "nvme2n1");
+    EXPECT_TRUE(ebs.devices_changed());
+
+    std::filesystem::remove_all(dev);
+}
+
+TEST(EBS, HistogramPercentile)
+{
+    auto histogram = test_histogram();
+
+    // no operations in the interval
+    uint32_t none[4]{};
+    EXPECT_FALSE(ebs_histogram_percentile(histogram, none, 0.5).has_value());
+
+    // interpolated within the bin the rank falls in
+    uint32_t spread[4]{0, 10, 10, 0};
+    EXPECT_DOUBLE_EQ(ebs_histogram_percentile(histogram, spread, 0.25).value(), 2000);
+    EXPECT_DOUBLE_EQ(ebs_histogram_percentile(histogram, spread, 0.5).value(), 3000);
+    EXPECT_DOUBLE_EQ(ebs_histogram_percentile(histogram, spread, 0.75).value(), 6500);
+
+    // the last bin has no upper bound, so its lower bound is reported
+    uint32_t slow[4]{0, 0, 1, 99};
+    EXPECT_DOUBLE_EQ(ebs_histogram_percentile(histogram, slow, 0.99).value(), 10000);
+    EXPECT_DOUBLE_EQ(ebs_histogram_percentile(histogram, slow, 1.0).value(), 10000);
+}
+
+TEST(EBS, HistogramCounterWrap)
+{
+    auto dev = std::filesystem::temp_directory_path();
+    auto config = Config(WriterConfig(WriterTypes::Memory));
+    auto r = Registry(config);
+    EBSCollectorTest ebs{&r, {}, dev.c_str()};
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    memoryWriter->Clear();
+
+    // the first reading only sets the baseline
+    auto histogram = test_histogram();
+    histogram.bins[1].count = UINT32_MAX - 4;
+    EBSHistogramState state{};
+    EXPECT_TRUE(ebs.handle_histogram(histogram, state, "/dev/nvme1n1", "read"));
+    EXPECT_TRUE(memoryWriter->GetMessages().empty());
+
+    // the bin count wrapped around after 10 more operations
+    histogram.bins[1].count = 5;
+    EXPECT_TRUE(ebs.handle_histogram(histogram, state, "/dev/nvme1n1", "read"));
+    auto messages = memoryWriter->GetMessages();
+    std::vector<std::string> expected{
+        "g:aws.ebs.ioLatency,percentile=p50,id=read,dev=/dev/nvme1n1:0.002000\n",
+        "g:aws.ebs.ioLatency,percentile=p90,id=read,dev=/dev/nvme1n1:0.002800\n",
+        "g:aws.ebs.ioLatency,percentile=p99,id=read,dev=/dev/nvme1n1:0.002980\n",
+        "g:aws.ebs.ioLatency,percentile=max,id=read,dev=/dev/nvme1n1:0.003000\n"};
+    EXPECT_EQ(messages, expected);
+
+    // an idle interval resets the percentiles instead of leaving the last values behind
+    memoryWriter->Clear();
+    EXPECT_TRUE(ebs.handle_histogram(histogram, state, "/dev/nvme1n1", "read"));
+    messages = memoryWriter->GetMessages();
+    expected = {"g:aws.ebs.ioLatency,percentile=p50,id=read,dev=/dev/nvme1n1:0.000000\n",
+                "g:aws.ebs.ioLatency,percentile=p90,id=read,dev=/dev/nvme1n1:0.000000\n",
+                "g:aws.ebs.ioLatency,percentile=p99,id=read,dev=/dev/nvme1n1:0.000000\n",
+                "g:aws.ebs.ioLatency,percentile=max,id=read,dev=/dev/nvme1n1:0.000000\n"};
+    EXPECT_EQ(messages, expected);
+}
+
+TEST(EBS, ExceededFractions)
+{
+    std::array<uint64_t, 4> cur{500000, 0, 3000000, 100};
+
+    // nothing to compare the first sample against
+    auto fractions = ebs_exceeded_fractions(std::nullopt, cur, 1e6);
+    for (const auto& f : fractions)
+    {
+        EXPECT_FALSE(f.has_value());
+    }
+
+    // half the second, none of it, capped at the whole second, and a counter that went backwards
+    std::optional<std::array<uint64_t, 4>> prev{{0, 0, 1000000, 200}};
+    fractions = ebs_exceeded_fractions(prev, cur, 1e6);
+    ASSERT_TRUE(fractions[0].has_value());
+    EXPECT_DOUBLE_EQ(fractions[0].value(), 0.5);
+    ASSERT_TRUE(fractions[1].has_value());
+    EXPECT_DOUBLE_EQ(fractions[1].value(), 0.0);
+    ASSERT_TRUE(fractions[2].has_value());
+    EXPECT_DOUBLE_EQ(fractions[2].value(), 1.0);
+    EXPECT_FALSE(fractions[3].has_value());
+
+    // no time elapsed
+    fractions = ebs_exceeded_fractions(prev, cur, 0);
+    EXPECT_FALSE(fractions[0].has_value());
+}
+}  // namespace
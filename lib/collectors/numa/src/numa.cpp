@@ -0,0 +1,270 @@
+#include "numa.h"
+
+#include <lib/collectors/proc/src/proc_cpu.h>
+#include <lib/files/src/files.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cinttypes>
+#include <cstring>
+
+namespace atlasagent
+{
+
+std::vector<unsigned> parse_cpulist(const std::string& cpulist) noexcept
+{
+    std::vector<unsigned> cpus;
+    const char* p = cpulist.data();
+    const char* end = p + cpulist.size();
+    while (p < end)
+    {
+        unsigned first, last;
+        auto res = std::from_chars(p, end, first);
+        if (res.ec != std::errc{})
+        {
+            break;
+        }
+        p = res.ptr;
+        last = first;
+        if (p < end && *p == '-')
+        {
+            res = std::from_chars(p + 1, end, last);
+            if (res.ec != std::errc{})
+            {
+                break;
+            }
+            p = res.ptr;
+        }
+        for (auto cpu = first; cpu <= last; ++cpu)
+        {
+            cpus.push_back(cpu);
+        }
+        if (p == end || *p != ',')
+        {
+            break;
+        }
+        ++p;
+    }
+    return cpus;
+}
+
+static std::string read_first_line(const std::string& prefix, const char* fn)
+{
+    auto fp = open_file(prefix, fn);
+    if (fp == nullptr)
+    {
+        return {};
+    }
+    char buf[4096];
+    if (fgets(buf, sizeof buf, fp) == nullptr)
+    {
+        return {};
+    }
+    return buf;
+}
+
+Numa::Numa(Registry* registry, std::string path_prefix) noexcept
+    : registry_{registry}, path_prefix_{std::move(path_prefix)}
+{
+    DirHandle dh{path_prefix_.c_str()};
+    if (dh == nullptr)
+    {
+        return;
+    }
+
+    // nodes do not come and go at runtime, so the topology is read once
+    struct dirent* direntry;
+    while ((direntry = readdir(dh)) != nullptr)
+    {
+        unsigned id;
+        if (sscanf(direntry->d_name, "node%u", &id) != 1)
+        {
+            continue;
+        }
+        auto dir = fmt::format("{}/{}", path_prefix_, direntry->d_name);
+        auto tag = std::to_string(id);
+        nodes_.emplace_back(Node{id, tag, dir, parse_cpulist(read_first_line(dir, "cpulist")), {}, {}, {},
+                                 registry_->CreateMaxGauge("sys.numa.cpuPeakUtilization", {{"node", tag}}),
+                                 registry_->CreateGauge("sys.numa.cpuUtilization", {{"node", tag}})});
+    }
+
+    if (nodes_.size() < 2)
+    {
+        nodes_.clear();
+        return;
+    }
+
+    std::sort(nodes_.begin(), nodes_.end(), [](const Node& a, const Node& b) { return a.num < b.num; });
+    for (size_t i = 0; i < nodes_.size(); ++i)
+    {
+        for (auto cpu : nodes_[i].cpus)
+        {
+            if (cpu >= cpu_to_node_.size())
+            {
+                cpu_to_node_.resize(cpu + 1, -1);
+            }
+            cpu_to_node_[cpu] = static_cast<int>(i);
+        }
+    }
+    iowait_.resize(cpu_to_node_.size());
+    Logger()->info("Found {} NUMA nodes", nodes_.size());
+}
+
+void Numa::meminfo_stats(const Node& node) noexcept
+{
+    auto fp = open_file(node.dir, "meminfo");
+    if (fp == nullptr)
+    {
+        return;
+    }
+
+    // lines look like "Node 0 MemTotal:       32817140 kB"
+    char line[1024];
+    char key[64];
+    uint64_t value;
+    int64_t total = -1, free = -1;
+    while (fgets(line, sizeof line, fp) != nullptr)
+    {
+        if (sscanf(line, "Node %*u %63[^:]: %" SCNu64, key, &value) != 2)
+        {
+            continue;
+        }
+        auto bytes = static_cast<double>(value) * 1024.0;
+        if (strcmp(key, "MemTotal") == 0)
+        {
+            total = static_cast<int64_t>(value);
+            registry_->CreateGauge("mem.numa.totalReal", {{"node", node.id}}).Set(bytes);
+        }
+        else if (strcmp(key, "MemFree") == 0)
+        {
+            free = static_cast<int64_t>(value);
+            registry_->CreateGauge("mem.numa.freeReal", {{"node", node.id}}).Set(bytes);
+        }
+        else if (strcmp(key, "FilePages") == 0)
+        {
+            registry_->CreateGauge("mem.numa.cached", {{"node", node.id}}).Set(bytes);
+        }
+        else if (strcmp(key, "AnonPages") == 0)
+        {
+            registry_->CreateGauge("mem.numa.anon", {{"node", node.id}}).Set(bytes);
+        }
+    }
+
+    if (total >= 0 && free >= 0 && total >= free)
+    {
+        registry_->CreateGauge("mem.numa.usedReal", {{"node", node.id}}).Set((total - free) * 1024.0);
+    }
+}
+
+void Numa::numastat_stats(const Node& node) noexcept
+{
+    std::unordered_map<std::string, int64_t> stats;
+    parse_kv_from_file(node.dir, "numastat", &stats);
+
+    // numastat counts pages allocated on this node: hit/miss are from the point of view of the
+    // allocating node's preference, foreign counts pages intended for this node that landed elsewhere
+    static constexpr std::pair<const char*, const char*> kCounters[] = {
+        {"numa_hit", "hit"},
+        {"numa_miss", "miss"},
+        {"numa_foreign", "foreign"},
+        {"interleave_hit", "interleave"},
+        {"local_node", "local"},
+        {"other_node", "other"},
+    };
+    for (const auto& [key, id] : kCounters)
+    {
+        auto it = stats.find(key);
+        if (it != stats.end())
+        {
+            registry_->CreateMonotonicCounter("mem.numa.pages", {{"node", node.id}, {"id", id}}).Set(it->second);
+        }
+    }
+}
+
+void Numa::collect() noexcept
+{
+    for (const auto& node : nodes_)
+    {
+        meminfo_stats(node);
+        numastat_stats(node);
+    }
+}
+
+static double busy_percent(const NumaCpuTicks& prev, const NumaCpuTicks& cur)
+{
+    // a cpu going offline removes its ticks from the sum; treat a shrinking total as no sample
+    if (!prev.valid || cur.total <= prev.total || cur.busy < prev.busy)
+    {
+        return -1.0;
+    }
+    return 100.0 * static_cast<double>(cur.busy - prev.busy) / static_cast<double>(cur.total - prev.total);
+}
+
+void Numa::CpuStats(const std::vector<std::vector<std::string>>& cpuLines,
+                    const bool sixtySecondMetricsEnabled) noexcept try
+{
+    if (nodes_.empty())
+    {
+        return;
+    }
+
+    for (auto& node : nodes_)
+    {
+        node.current = NumaCpuTicks{0, 0, true};
+    }
+
+    for (const auto& fields : cpuLines)
+    {
+        // skip the aggregate "cpu" line; per-core lines are "cpuN"
+        const auto& name = fields[0];
+        unsigned cpu;
+        if (name.size() <= 3 || std::from_chars(name.data() + 3, name.data() + name.size(), cpu).ec != std::errc{})
+        {
+            continue;
+        }
+        if (cpu >= cpu_to_node_.size() || cpu_to_node_[cpu] < 0)
+        {
+            continue;
+        }
+
+        CpuStatFields stats(fields);
+        // like ComputeGaugeValues, a decrease in iowait counts as none
+        auto& wait = iowait_[cpu];
+        if (wait.valid && stats.iowait > wait.last)
+        {
+            wait.total += stats.iowait - wait.last;
+        }
+        wait.last = stats.iowait;
+        wait.valid = true;
+
+        // same busy definition as sys.cpu.coreUtilization: everything but idle, guest time already in user/nice
+        auto busy = stats.user + stats.nice + stats.system + wait.total + stats.irq + stats.softirq + stats.steal;
+        auto& ticks = nodes_[cpu_to_node_[cpu]].current;
+        ticks.busy += busy;
+        ticks.total += busy + stats.idle;
+    }
+
+    for (auto& node : nodes_)
+    {
+        if (auto pct = busy_percent(node.prev, node.current); pct >= 0)
+        {
+            node.peakUtilization.Set(pct);
+        }
+        node.prev = node.current;
+
+        if (sixtySecondMetricsEnabled)
+        {
+            if (auto pct = busy_percent(node.prevMinute, node.current); pct >= 0)
+            {
+                node.utilization.Set(pct);
+            }
+            node.prevMinute = node.current;
+        }
+    }
+}
+catch (const std::exception& ex)
+{
+    Logger()->error("Exception updating NUMA cpu stats: {}", ex.what());
+}
+
+}  // namespace atlasagent
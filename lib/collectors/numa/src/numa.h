@@ -0,0 +1,76 @@
+#pragma once
+
+#include <lib/util/src/util.h>
+#include <thirdparty/spectator-cpp/spectator/registry.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace atlasagent
+{
+
+// Parse a sysfs cpulist such as "0-3,8-11" into the individual cpu numbers. An empty list (a
+// memory-only node) yields an empty vector.
+std::vector<unsigned> parse_cpulist(const std::string& cpulist) noexcept;
+
+// Busy and total jiffies summed over the cpus of one node.
+struct NumaCpuTicks
+{
+    uint64_t busy{};
+    uint64_t total{};
+    bool valid{false};
+};
+
+// Per-node memory and cpu statistics for multi-socket hosts, read from /sys/devices/system/node.
+// Host-wide /proc/meminfo totals hide remote-node allocations; numastat and the per-node meminfo
+// make them visible. Hosts with a single node publish nothing, since every value would duplicate
+// the host-wide metrics.
+class Numa
+{
+   public:
+    explicit Numa(Registry* registry, std::string path_prefix = "/sys/devices/system/node") noexcept;
+
+    // 60-second meminfo and numastat metrics.
+    void collect() noexcept;
+
+    // Called every second with the cpu lines already parsed from /proc/stat by Proc::CpuStats; folds
+    // the per-core counters into per-node busy time.
+    void CpuStats(const std::vector<std::vector<std::string>>& cpuLines, const bool sixtySecondMetricsEnabled) noexcept;
+
+    [[nodiscard]] size_t num_nodes() const noexcept { return nodes_.size(); }
+
+   protected:
+    struct Node
+    {
+        unsigned num;
+        std::string id;
+        std::string dir;
+        std::vector<unsigned> cpus;
+        NumaCpuTicks current;
+        NumaCpuTicks prev;        // last second, for the peak
+        NumaCpuTicks prevMinute;  // last 60s boundary, for the average
+        MaxGauge peakUtilization;
+        Gauge utilization;
+    };
+
+    void meminfo_stats(const Node& node) noexcept;
+    void numastat_stats(const Node& node) noexcept;
+
+   private:
+    Registry* registry_;
+    std::string path_prefix_;
+    std::vector<Node> nodes_;
+    std::vector<int> cpu_to_node_;  // index into nodes_, -1 for cpus not listed on any node
+
+    // iowait can go backwards on SMP, so each cpu's increases are summed into a counter that cannot
+    struct CpuIowait
+    {
+        uint64_t last{};
+        uint64_t total{};
+        bool valid{false};
+    };
+    std::vector<CpuIowait> iowait_;  // indexed by cpu
+};
+
+}  // namespace atlasagent
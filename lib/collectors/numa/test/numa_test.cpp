@@ -0,0 +1,99 @@
+#include <lib/collectors/numa/src/numa.h>
+
+#include <thirdparty/spectator-cpp/spectator/registry.h>
+#include <thirdparty/spectator-cpp/libs/writer/writer_wrapper/writer_test_helper.h>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+constexpr auto kNodes = "lib/collectors/numa/test/resources";
+
+std::vector<std::string> cpu_line(const char* name, int user, int idle, int iowait = 0)
+{
+    return {name, std::to_string(user), "0", "0", std::to_string(idle), std::to_string(iowait), "0", "0", "0", "0",
+            "0"};
+}
+}  // namespace
+
+TEST(NumaTest, ParseCpuList)
+{
+    EXPECT_EQ(atlasagent::parse_cpulist("0-3,8-9\n"), (std::vector<unsigned>{0, 1, 2, 3, 8, 9}));
+    EXPECT_EQ(atlasagent::parse_cpulist("5"), (std::vector<unsigned>{5}));
+    EXPECT_TRUE(atlasagent::parse_cpulist("\n").empty());
+}
+
+TEST(NumaTest, MemoryStats)
+{
+    auto config = Config(WriterConfig(WriterTypes::Memory));
+    auto r = Registry(config);
+    atlasagent::Numa numa{&r, kNodes};
+    ASSERT_EQ(numa.num_nodes(), 2);
+
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    memoryWriter->Clear();
+    numa.collect();
+    auto messages = memoryWriter->GetMessages();
+    ASSERT_EQ(messages.size(), 22);
+    EXPECT_EQ(messages.at(0), "g:mem.numa.totalReal,node=0:32768000000.000000\n");
+    EXPECT_EQ(messages.at(1), "g:mem.numa.freeReal,node=0:12288000000.000000\n");
+    EXPECT_EQ(messages.at(2), "g:mem.numa.cached,node=0:6144000000.000000\n");
+    EXPECT_EQ(messages.at(3), "g:mem.numa.anon,node=0:9216000000.000000\n");
+    EXPECT_EQ(messages.at(4), "g:mem.numa.usedReal,node=0:20480000000.000000\n");
+    EXPECT_EQ(messages.at(5), "C:mem.numa.pages,id=hit,node=0:1000.000000\n");
+    EXPECT_EQ(messages.at(6), "C:mem.numa.pages,id=miss,node=0:20.000000\n");
+    EXPECT_EQ(messages.at(7), "C:mem.numa.pages,id=foreign,node=0:30.000000\n");
+    EXPECT_EQ(messages.at(16), "C:mem.numa.pages,id=hit,node=1:500.000000\n");
+}
+
+TEST(NumaTest, CpuUtilization)
+{
+    auto config = Config(WriterConfig(WriterTypes::Memory));
+    auto r = Registry(config);
+    atlasagent::Numa numa{&r, kNodes};
+
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    memoryWriter->Clear();
+
+    std::vector<std::vector<std::string>> first{cpu_line("cpu", 0, 0), cpu_line("cpu0", 0, 0),
+                                                cpu_line("cpu1", 0, 0), cpu_line("cpu2", 0, 0),
+                                                cpu_line("cpu3", 0, 0)};
+    numa.CpuStats(first, true);
+    EXPECT_TRUE(memoryWriter->GetMessages().empty());
+
+    // node0: 150 busy of 200, node1: 20 busy of 200
+    std::vector<std::vector<std::string>> second{cpu_line("cpu", 170, 230), cpu_line("cpu0", 100, 0),
+                                                 cpu_line("cpu1", 50, 50), cpu_line("cpu2", 10, 90),
+                                                 cpu_line("cpu3", 10, 90)};
+    numa.CpuStats(second, true);
+    auto messages = memoryWriter->GetMessages();
+    ASSERT_EQ(messages.size(), 4);
+    EXPECT_EQ(messages.at(0), "m:sys.numa.cpuPeakUtilization,node=0:75.000000\n");
+    EXPECT_EQ(messages.at(1), "g:sys.numa.cpuUtilization,node=0:75.000000\n");
+    EXPECT_EQ(messages.at(2), "m:sys.numa.cpuPeakUtilization,node=1:10.000000\n");
+    EXPECT_EQ(messages.at(3), "g:sys.numa.cpuUtilization,node=1:10.000000\n");
+}
+
+TEST(NumaTest, CpuUtilizationDecreasingIowait)
+{
+    auto config = Config(WriterConfig(WriterTypes::Memory));
+    auto r = Registry(config);
+    atlasagent::Numa numa{&r, kNodes};
+
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    memoryWriter->Clear();
+
+    std::vector<std::vector<std::string>> first{cpu_line("cpu0", 0, 0, 100), cpu_line("cpu1", 0, 0, 0),
+                                                cpu_line("cpu2", 0, 0, 0), cpu_line("cpu3", 0, 0, 0)};
+    numa.CpuStats(first, false);
+
+    // cpu0's iowait goes back by 40 while cpu1 adds 20. Only the increase counts, so node0 is
+    // 50 + 20 busy of 200 instead of dropping the sample.
+    std::vector<std::vector<std::string>> second{cpu_line("cpu0", 50, 50, 60), cpu_line("cpu1", 0, 80, 20),
+                                                 cpu_line("cpu2", 10, 90, 0), cpu_line("cpu3", 10, 90, 0)};
+    numa.CpuStats(second, false);
+    auto messages = memoryWriter->GetMessages();
+    ASSERT_EQ(messages.size(), 2);
+    EXPECT_EQ(messages.at(0), "m:sys.numa.cpuPeakUtilization,node=0:35.000000\n");
+    EXPECT_EQ(messages.at(1), "m:sys.numa.cpuPeakUtilization,node=1:10.000000\n");
+}
@@ -0,0 +1,27 @@
+#include "nvme_log_page.h"
+
+#include <cerrno>
+#include <sys/ioctl.h>
+
+namespace atlasagent
+{
+
+bool nvme_get_log_page(int fd, uint8_t logId, uint32_t nsid, void* buf, uint32_t len) noexcept
+{
+    nvme_admin_command admin_cmd = {};
+    admin_cmd.opcode = NVMeCommands::GetLogPage;
+    admin_cmd.addr = reinterpret_cast<uint64_t>(buf);
+    admin_cmd.alen = len;
+    admin_cmd.nsid = nsid;
+    // the number of dwords to transfer is zero based
+    admin_cmd.cdw10 = logId | ((len / 4 - 1) << 16);
+
+    auto ret = ioctl(fd, NVMeCommands::AdminCommand, &admin_cmd);
+    if (ret > 0)
+    {
+        errno = 0;  // an NVMe status code, not an errno
+    }
+    return ret == 0;
+}
+
+}  // namespace atlasagent
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Constants for NVMe commands
+struct NVMeCommands
+{
+    static constexpr auto GetLogPage = 0x02;
+    static constexpr auto AdminCommand = 0xC0484E41;  // NVME_IOCTL_ADMIN_CMD
+    static constexpr auto SmartLogPageId = 0x02;
+    static constexpr auto StatsLogPageId = 0xD0;
+    static constexpr auto StatsMagic = 0x3C23B510;
+    static constexpr uint32_t AllNamespaces = 0xFFFFFFFF;
+};
+
+#pragma pack(push, 1)
+struct nvme_admin_command
+{
+    uint8_t opcode;
+    uint8_t flags;
+    uint16_t cid;
+    uint32_t nsid;
+    uint64_t _reserved0;
+    uint64_t mptr;
+    uint64_t addr;
+    uint32_t mlen;
+    uint32_t alen;
+    uint32_t cdw10;
+    uint32_t cdw11;
+    uint32_t cdw12;
+    uint32_t cdw13;
+    uint32_t cdw14;
+    uint32_t cdw15;
+    uint64_t _reserved1;
+};
+#pragma pack(pop)
+
+namespace atlasagent
+{
+
+// Reads `len` bytes (a multiple of 4, up to 16KB) of log page `logId` for namespace `nsid` through an
+// admin Get Log Page command on an open NVMe controller or namespace device. Returns false with errno
+// set when the ioctl fails, or with errno 0 when the controller reports an NVMe status.
+bool nvme_get_log_page(int fd, uint8_t logId, uint32_t nsid, void* buf, uint32_t len) noexcept;
+
+}  // namespace atlasagent
@@ -0,0 +1,156 @@
+#include "nvme_smart.h"
+#include "nvme_log_page.h"
+
+#include <lib/logger/src/logger.h>
+
+#include <algorithm>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+
+namespace atlasagent
+{
+
+uint64_t nvme_smart_counter(const uint8_t (&counter)[16]) noexcept
+{
+    uint64_t value{0};
+    for (int i = 7; i >= 0; --i)
+    {
+        value = value << 8u | counter[i];
+    }
+    return value;
+}
+
+std::vector<std::string> nvme_controllers(const char* sysClassNvme)
+{
+    std::vector<std::string> controllers;
+    auto dir = opendir(sysClassNvme);
+    if (dir == nullptr)
+    {
+        return controllers;
+    }
+    struct dirent* de;
+    while ((de = readdir(dir)) != nullptr)
+    {
+        std::string_view name{de->d_name};
+        // controllers are nvme<N>, subsystems and fabrics devices live elsewhere
+        if (name.size() > 4 && name.starts_with("nvme") &&
+            std::all_of(name.begin() + 4, name.end(), [](char c) { return c >= '0' && c <= '9'; }))
+        {
+            controllers.emplace_back(name);
+        }
+    }
+    closedir(dir);
+    std::sort(controllers.begin(), controllers.end());
+    return controllers;
+}
+
+NvmeSmart::NvmeSmart(Registry* registry, std::string sysClassNvme, std::string devPrefix) noexcept
+    : registry_{registry}, sys_class_nvme_{std::move(sysClassNvme)}, dev_prefix_{std::move(devPrefix)}
+{
+}
+
+std::optional<NvmeSmart> NvmeSmart::Create(Registry* registry)
+{
+    if (nvme_controllers("/sys/class/nvme").empty())
+    {
+        Logger()->debug("No NVMe controllers found, NVMe SMART metrics are disabled");
+        return std::nullopt;
+    }
+    return std::optional<NvmeSmart>{std::in_place, registry};
+}
+
+void NvmeSmart::Collect(std::optional<NvmeSmart>& self)
+{
+    if (self.has_value())
+    {
+        self->collect();
+    }
+}
+
+void NvmeSmart::rescan() noexcept
+{
+    std::vector<Controller> controllers;
+    for (auto& name : nvme_controllers(sys_class_nvme_.c_str()))
+    {
+        auto it = std::find_if(controllers_.begin(), controllers_.end(),
+                               [&](const Controller& c) { return c.name == name; });
+        if (it != controllers_.end())
+        {
+            controllers.emplace_back(std::move(*it));
+        }
+        else
+        {
+            controllers.emplace_back(Controller{std::move(name)});
+        }
+    }
+    controllers_ = std::move(controllers);
+}
+
+void NvmeSmart::collect() noexcept
+{
+    // drives are rarely hot plugged, and listing a directory once a minute is cheap
+    rescan();
+    for (auto& controller : controllers_)
+    {
+        if (!controller.supported)
+        {
+            continue;
+        }
+        if (controller.fd < 0)
+        {
+            auto path = fmt::format("{}/{}", dev_prefix_, controller.name);
+            controller.fd = UnixFile{open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+            if (controller.fd < 0)
+            {
+                Logger()->warn("Unable to open {}: {}", path, strerror(errno));
+                continue;
+            }
+        }
+
+        nvme_smart_log log{};
+        if (!nvme_get_log_page(controller.fd, NVMeCommands::SmartLogPageId, NVMeCommands::AllNamespaces, &log,
+                               sizeof log))
+        {
+            if (errno == 0 || errno == EINVAL || errno == ENOTTY)
+            {
+                Logger()->info("{} does not support the SMART log page, skipping it", controller.name);
+                controller.supported = false;
+            }
+            else
+            {
+                Logger()->warn("Unable to read the SMART log of {}: {}", controller.name, strerror(errno));
+                controller.fd = UnixFile{-1};
+            }
+            continue;
+        }
+        update_metrics(controller.name, log);
+    }
+}
+
+void NvmeSmart::update_metrics(const std::string& controller, const nvme_smart_log& log) noexcept
+{
+    static constexpr double kDataUnitBytes = 512 * 1000;
+    std::unordered_map<std::string, std::string> dev{{"dev", controller}};
+
+    if (log.temperature > 0)
+    {
+        registry_->CreateGauge("disk.nvme.temperature", dev).Set(log.temperature - 273.15);
+    }
+    registry_->CreateGauge("disk.nvme.percentageUsed", dev).Set(log.percent_used);
+    registry_->CreateGauge("disk.nvme.availableSpare", dev).Set(log.avail_spare);
+    registry_->CreateGauge("disk.nvme.criticalWarning", dev).Set(log.critical_warning);
+    registry_->CreateMonotonicCounter("disk.nvme.mediaErrors", dev).Set(nvme_smart_counter(log.media_errors));
+    registry_->CreateMonotonicCounter("disk.nvme.unsafeShutdowns", dev)
+        .Set(nvme_smart_counter(log.unsafe_shutdowns));
+    registry_->CreateMonotonicCounter("disk.nvme.bytes", {{"dev", controller}, {"id", "read"}})
+        .Set(nvme_smart_counter(log.data_units_read) * kDataUnitBytes);
+    registry_->CreateMonotonicCounter("disk.nvme.bytes", {{"dev", controller}, {"id", "write"}})
+        .Set(nvme_smart_counter(log.data_units_written) * kDataUnitBytes);
+    registry_->CreateMonotonicCounter("disk.nvme.thermalThrottleTime", {{"dev", controller}, {"id", "light"}})
+        .Set(log.thm_temp1_total_time);
+    registry_->CreateMonotonicCounter("disk.nvme.thermalThrottleTime", {{"dev", controller}, {"id", "heavy"}})
+        .Set(log.thm_temp2_total_time);
+}
+
+}  // namespace atlasagent
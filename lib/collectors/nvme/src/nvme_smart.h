@@ -0,0 +1,89 @@
+#pragma once
+
+#include <lib/files/src/files.h>
+#include <thirdparty/spectator-cpp/spectator/registry.h>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#pragma pack(push, 1)
+// SMART / Health Information log page (0x02), NVMe base specification
+struct nvme_smart_log
+{
+    uint8_t critical_warning;
+    uint16_t temperature;  // composite temperature in kelvin
+    uint8_t avail_spare;
+    uint8_t spare_thresh;
+    uint8_t percent_used;
+    uint8_t endu_grp_crit_warn_sumry;
+    uint8_t _reserved0[25];
+    // 128 bit little endian counters
+    uint8_t data_units_read[16];  // thousands of 512 byte units
+    uint8_t data_units_written[16];
+    uint8_t host_reads[16];
+    uint8_t host_writes[16];
+    uint8_t ctrl_busy_time[16];
+    uint8_t power_cycles[16];
+    uint8_t power_on_hours[16];
+    uint8_t unsafe_shutdowns[16];
+    uint8_t media_errors[16];
+    uint8_t num_err_log_entries[16];
+    uint32_t warning_temp_time;  // minutes
+    uint32_t critical_comp_time;
+    uint16_t temp_sensor[8];
+    uint32_t thm_temp1_trans_count;
+    uint32_t thm_temp2_trans_count;
+    uint32_t thm_temp1_total_time;  // seconds of light thermal throttling
+    uint32_t thm_temp2_total_time;  // seconds of heavy thermal throttling
+    uint8_t _reserved1[280];
+};
+#pragma pack(pop)
+static_assert(sizeof(nvme_smart_log) == 512);
+
+namespace atlasagent
+{
+
+// The low 64 bits of a 128 bit SMART counter, which is plenty for any real drive
+uint64_t nvme_smart_counter(const uint8_t (&counter)[16]) noexcept;
+
+// The NVMe controllers under /sys/class/nvme (nvme0, nvme1...)
+std::vector<std::string> nvme_controllers(const char* sysClassNvme);
+
+// Reports the SMART / Health log of every NVMe controller once a minute: temperature, wear, spare
+// capacity, media errors, unsafe shutdowns, data read and written, and time spent thermal throttling.
+// The log is controller wide, so it covers all of the controller's namespaces. Controllers that do
+// not support the log page (some EBS volumes) are skipped after the first failure.
+class NvmeSmart
+{
+   public:
+    explicit NvmeSmart(Registry* registry, std::string sysClassNvme = "/sys/class/nvme",
+                       std::string devPrefix = "/dev") noexcept;
+
+    void collect() noexcept;
+
+    // Builds a collector when the host has NVMe controllers, otherwise returns nullopt.
+    static std::optional<NvmeSmart> Create(Registry* registry);
+    static void Collect(std::optional<NvmeSmart>& self);
+
+   protected:
+    void update_metrics(const std::string& controller, const nvme_smart_log& log) noexcept;
+
+   private:
+    struct Controller
+    {
+        std::string name;
+        UnixFile fd{-1};
+        bool supported{true};
+    };
+
+    void rescan() noexcept;
+
+    Registry* registry_;
+    std::string sys_class_nvme_;
+    std::string dev_prefix_;
+    std::vector<Controller> controllers_;
+};
+
+}  // namespace atlasagent
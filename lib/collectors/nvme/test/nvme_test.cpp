@@ -0,0 +1,68 @@
+#include <lib/collectors/nvme/src/nvme_smart.h>
+
+#include <thirdparty/spectator-cpp/spectator/registry.h>
+#include <thirdparty/spectator-cpp/libs/writer/writer_wrapper/writer_test_helper.h>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+class NvmeSmartTest : public atlasagent::NvmeSmart
+{
+   public:
+    explicit NvmeSmartTest(Registry* registry) : NvmeSmart{registry, "lib/collectors/nvme/test/resources/class_nvme"}
+    {
+    }
+
+    void update_metrics(const std::string& controller, const nvme_smart_log& log)
+    {
+        NvmeSmart::update_metrics(controller, log);
+    }
+};
+
+TEST(NvmeSmart, Controllers)
+{
+    auto controllers = atlasagent::nvme_controllers("lib/collectors/nvme/test/resources/class_nvme");
+    EXPECT_EQ(controllers, (std::vector<std::string>{"nvme0", "nvme1"}));
+    EXPECT_TRUE(atlasagent::nvme_controllers("lib/collectors/nvme/test/resources/missing").empty());
+}
+
+TEST(NvmeSmart, Counter)
+{
+    uint8_t counter[16] = {0x01, 0x02, 0, 0, 0, 0, 0, 0, 0xff};
+    EXPECT_EQ(atlasagent::nvme_smart_counter(counter), 0x0201);
+}
+
+TEST(NvmeSmart, UpdateMetrics)
+{
+    auto config = Config(WriterConfig(WriterTypes::Memory));
+    auto r = Registry(config);
+    NvmeSmartTest smart{&r};
+
+    nvme_smart_log log{};
+    log.temperature = 318;
+    log.percent_used = 3;
+    log.avail_spare = 100;
+    log.data_units_read[0] = 10;
+    log.data_units_written[0] = 20;
+    log.unsafe_shutdowns[0] = 2;
+    log.thm_temp1_total_time = 30;
+
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    memoryWriter->Clear();
+    smart.update_metrics("nvme0", log);
+    auto messages = memoryWriter->GetMessages();
+
+    ASSERT_EQ(messages.size(), 10);
+    EXPECT_EQ(messages.at(0), "g:disk.nvme.temperature,dev=nvme0:44.850000\n");
+    EXPECT_EQ(messages.at(1), "g:disk.nvme.percentageUsed,dev=nvme0:3.000000\n");
+    EXPECT_EQ(messages.at(2), "g:disk.nvme.availableSpare,dev=nvme0:100.000000\n");
+    EXPECT_EQ(messages.at(3), "g:disk.nvme.criticalWarning,dev=nvme0:0.000000\n");
+    EXPECT_EQ(messages.at(4), "C:disk.nvme.mediaErrors,dev=nvme0:0.000000\n");
+    EXPECT_EQ(messages.at(5), "C:disk.nvme.unsafeShutdowns,dev=nvme0:2.000000\n");
+    EXPECT_EQ(messages.at(6), "C:disk.nvme.bytes,id=read,dev=nvme0:5120000.000000\n");
+    EXPECT_EQ(messages.at(7), "C:disk.nvme.bytes,id=write,dev=nvme0:10240000.000000\n");
+    EXPECT_EQ(messages.at(8), "C:disk.nvme.thermalThrottleTime,id=light,dev=nvme0:30.000000\n");
+    EXPECT_EQ(messages.at(9), "C:disk.nvme.thermalThrottleTime,id=heavy,dev=nvme0:0.000000\n");
+}
+}  // namespace
@@ -25,6 +25,10 @@ void PressureStall::collect() noexcept
     {
         auto usecs = std::strtoul(lines[0][4].substr(6).c_str(), nullptr, 10);
         registry_->CreateMonotonicCounter("sys.pressure.some", {{"id", "cpu"}}).Set(usecs / MICROS);
+
+        // host-level cpu full is only tracked since 5.13, older kernels report zeros
+        usecs = std::strtoul(lines[1][4].substr(6).c_str(), nullptr, 10);
+        registry_->CreateMonotonicCounter("sys.pressure.full", {{"id", "cpu"}}).Set(usecs / MICROS);
     }
 
     lines = read_lines_fields(path_prefix_, "io");
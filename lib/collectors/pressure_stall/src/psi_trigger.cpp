@@ -0,0 +1,194 @@
+#include "psi_trigger.h"
+
+#include <lib/util/src/util.h>
+
+#include <charconv>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/magic.h>
+#include <sys/epoll.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+
+namespace atlasagent
+{
+
+constexpr double MICROS = 1000 * 1000.0;
+constexpr const char* kKindNames[] = {"some", "full"};
+
+namespace
+{
+std::optional<PsiLine> parse_psi_line(std::string_view line)
+{
+    auto avg10 = line.find("avg10=");
+    auto total = line.find("total=");
+    if (avg10 == std::string_view::npos || total == std::string_view::npos)
+    {
+        return std::nullopt;
+    }
+    PsiLine result{};
+    auto a = line.substr(avg10 + 6);
+    auto t = line.substr(total + 6);
+    if (std::from_chars(a.data(), a.data() + a.size(), result.avg10).ec != std::errc{} ||
+        std::from_chars(t.data(), t.data() + t.size(), result.total).ec != std::errc{})
+    {
+        return std::nullopt;
+    }
+    return result;
+}
+
+// Triggers are only written to procfs or cgroupfs: on a regular file the write would clobber it.
+bool is_pressure_fs(const std::string& path)
+{
+    struct statfs fs;
+    return statfs(path.c_str(), &fs) == 0 && (fs.f_type == PROC_SUPER_MAGIC || fs.f_type == CGROUP2_SUPER_MAGIC);
+}
+}  // namespace
+
+PsiStats parse_psi(std::string_view buf) noexcept
+{
+    PsiStats stats;
+    while (!buf.empty())
+    {
+        auto eol = buf.find('\n');
+        auto line = buf.substr(0, eol);
+        if (line.starts_with("some "))
+        {
+            stats.some = parse_psi_line(line);
+        }
+        else if (line.starts_with("full "))
+        {
+            stats.full = parse_psi_line(line);
+        }
+        if (eol == std::string_view::npos)
+        {
+            break;
+        }
+        buf.remove_prefix(eol + 1);
+    }
+    return stats;
+}
+
+PsiTriggers::PsiTriggers(Registry* registry, std::string path_prefix, std::string suffix, uint32_t threshold_us,
+                         uint32_t window_us) noexcept
+    : registry_{registry}, epoll_{epoll_create1(EPOLL_CLOEXEC)}
+{
+    for (const auto* name : {"cpu", "io", "memory"})
+    {
+        auto path = fmt::format("{}/{}{}", path_prefix, name, suffix);
+        UnixFile fd{::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+        if (fd < 0)
+        {
+            // /proc/pressure is not available on RHEL/Rocky
+            continue;
+        }
+        resources_.push_back(Resource{name, std::move(fd)});
+        if (epoll_ >= 0 && is_pressure_fs(path))
+        {
+            arm(resources_.size() - 1, Some, path, threshold_us, window_us);
+            arm(resources_.size() - 1, Full, path, threshold_us, window_us);
+        }
+    }
+    Logger()->debug("Armed {} PSI triggers under {}", triggers_.size(), path_prefix);
+}
+
+void PsiTriggers::arm(size_t resource, Kind kind, const std::string& path, uint32_t threshold_us,
+                      uint32_t window_us) noexcept
+{
+    UnixFile fd{::open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC)};
+    if (fd < 0)
+    {
+        return;
+    }
+    auto trigger = fmt::format("{} {} {}", kKindNames[kind], threshold_us, window_us);
+    auto ok = write(fd, trigger.c_str(), trigger.size() + 1) >= 0;
+    if (!ok && errno == EINVAL && window_us % 2000000 != 0)
+    {
+        // without CAP_SYS_RESOURCE, kernels since 6.5 only accept windows that are multiples of 2s
+        trigger = fmt::format("{} {} {}", kKindNames[kind], threshold_us, (window_us / 2000000 + 1) * 2000000);
+        ok = write(fd, trigger.c_str(), trigger.size() + 1) >= 0;
+    }
+    // EINVAL remains for cpu full on kernels before 5.13
+    if (!ok)
+    {
+        Logger()->debug("Unable to arm PSI trigger '{}' on {}: {}", trigger, path, strerror(errno));
+        return;
+    }
+
+    epoll_event ev{};
+    ev.events = EPOLLPRI;
+    ev.data.u64 = triggers_.size();
+    if (epoll_ctl(epoll_, EPOLL_CTL_ADD, fd, &ev) != 0)
+    {
+        Logger()->debug("Unable to watch PSI trigger on {}: {}", path, strerror(errno));
+        return;
+    }
+    triggers_.push_back(Trigger{resource, kind, std::move(fd)});
+}
+
+PsiTriggers::KindMeters& PsiTriggers::meters_for(Resource& r, Kind kind) noexcept
+{
+    auto& meters = r.meters[kind];
+    if (!meters)
+    {
+        auto tags = std::unordered_map<std::string, std::string>{{"id", r.name}, {"kind", kKindNames[kind]}};
+        meters.emplace(KindMeters{registry_->CreateMaxGauge("sys.pressure.avg10", tags),
+                                  registry_->CreateCounter("sys.pressure.stallEvents", tags),
+                                  registry_->CreateDistributionSummary("sys.pressure.triggeredStallTime", tags)});
+    }
+    return *meters;
+}
+
+void PsiTriggers::poll() noexcept
+{
+    if (!triggers_.empty())
+    {
+        epoll_event events[8];
+        int n;
+        while ((n = epoll_wait(epoll_, events, std::size(events), 0)) > 0)
+        {
+            for (int i = 0; i < n; ++i)
+            {
+                const auto& t = triggers_[events[i].data.u64];
+                auto& r = resources_[t.resource];
+                r.fired[t.kind] = true;
+                meters_for(r, t.kind).stall_events.Increment();
+            }
+            if (n < static_cast<int>(std::size(events)))
+            {
+                break;
+            }
+        }
+    }
+
+    char buf[512];
+    for (auto& r : resources_)
+    {
+        auto len = pread(r.fd, buf, sizeof buf - 1, 0);
+        if (len <= 0)
+        {
+            continue;
+        }
+        auto stats = parse_psi(std::string_view{buf, static_cast<size_t>(len)});
+        for (auto kind : {Some, Full})
+        {
+            const auto& line = kind == Some ? stats.some : stats.full;
+            if (!line)
+            {
+                continue;
+            }
+            auto& meters = meters_for(r, kind);
+            meters.avg10.Set(line->avg10);
+
+            auto& prev = r.prev_total[kind];
+            if (r.fired[kind] && prev && line->total >= *prev)
+            {
+                meters.triggered_stall_time.Record((line->total - *prev) / MICROS);
+            }
+            r.fired[kind] = false;
+            prev = line->total;
+        }
+    }
+}
+
+}  // namespace atlasagent
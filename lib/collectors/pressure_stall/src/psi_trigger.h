@@ -0,0 +1,94 @@
+#pragma once
+
+#include <lib/files/src/files.h>
+#include <thirdparty/spectator-cpp/spectator/registry.h>
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace atlasagent
+{
+
+// One line of a PSI file: "some avg10=0.00 avg60=0.18 avg300=0.18 total=2000000"
+struct PsiLine
+{
+    double avg10;    // percent of the last 10s spent stalled
+    uint64_t total;  // cumulative stall time in microseconds
+};
+
+struct PsiStats
+{
+    std::optional<PsiLine> some;
+    std::optional<PsiLine> full;
+};
+
+PsiStats parse_psi(std::string_view buf) noexcept;
+
+// Stall event detection through PSI triggers. For each resource, a "some" and a "full" trigger
+// ("<kind> <threshold_us> <window_us>") is written to the pressure file and registered with epoll.
+// The kernel then flags the fd whenever the stall time within a window crosses the threshold.
+// Sub-minute stalls are counted this way, which the cumulative totals sampled once a minute hide.
+//
+// poll() is meant for the 1s loop. It drains the flagged triggers with a zero-timeout epoll_wait,
+// and reads each pressure file once to publish the avg10 peak for the minute. For every trigger that
+// fired, sys.pressure.triggeredStallTime records the stall time that accrued since the previous poll.
+// That is the stall time of the interval the event fell in, not the length of the event: the kernel
+// only signals that the threshold was crossed.
+//
+// Hosts use /proc/pressure/{cpu,io,memory}. Containers use <cgroup>/{cpu,io,memory}.pressure, via a
+// ".pressure" suffix. Arming needs write access to the file and a kernel with trigger support. A
+// resource whose triggers cannot be armed still reports its avg10 peaks.
+class PsiTriggers
+{
+   public:
+    explicit PsiTriggers(Registry* registry, std::string path_prefix = "/proc/pressure", std::string suffix = "",
+                         uint32_t threshold_us = 100000, uint32_t window_us = 1000000) noexcept;
+
+    void poll() noexcept;
+    [[nodiscard]] size_t armed() const noexcept { return triggers_.size(); }
+
+   private:
+    enum Kind
+    {
+        Some,
+        Full
+    };
+
+    // Meter handles for one resource and kind, created the first time they are needed.
+    struct KindMeters
+    {
+        MaxGauge avg10;
+        Counter stall_events;
+        DistributionSummary triggered_stall_time;
+    };
+
+    struct Resource
+    {
+        std::string name;
+        UnixFile fd{-1};  // read side, kept open between polls
+        std::array<std::optional<uint64_t>, 2> prev_total;
+        std::array<bool, 2> fired{};
+        std::array<std::optional<KindMeters>, 2> meters;
+    };
+
+    struct Trigger
+    {
+        size_t resource;
+        Kind kind;
+        UnixFile fd{-1};
+    };
+
+    void arm(size_t resource, Kind kind, const std::string& path, uint32_t threshold_us, uint32_t window_us) noexcept;
+    KindMeters& meters_for(Resource& r, Kind kind) noexcept;
+
+    Registry* registry_;
+    UnixFile epoll_{-1};
+    std::vector<Resource> resources_;
+    std::vector<Trigger> triggers_;
+};
+
+}  // namespace atlasagent
@@ -1,4 +1,5 @@
 #include <lib/collectors/pressure_stall/src/pressure_stall.h>
+#include <lib/collectors/pressure_stall/src/psi_trigger.h>
 
 #include <thirdparty/spectator-cpp/spectator/registry.h>
 #include <thirdparty/spectator-cpp/libs/writer/writer_wrapper/writer_test_helper.h>
@@ -27,11 +28,49 @@ TEST(PressureStallTest, UpdateStats)
     auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
     pressure.stats();
     auto messages = memoryWriter->GetMessages();
-    EXPECT_EQ(messages.size(), 5);
+    EXPECT_EQ(messages.size(), 6);
 
     EXPECT_EQ(messages.at(0), "C:sys.pressure.some,id=cpu:2.000000\n");
-    EXPECT_EQ(messages.at(1), "C:sys.pressure.some,id=io:2.000000\n");
-    EXPECT_EQ(messages.at(2), "C:sys.pressure.full,id=io:1.500000\n");
-    EXPECT_EQ(messages.at(3), "C:sys.pressure.some,id=memory:2.000000\n");
-    EXPECT_EQ(messages.at(4), "C:sys.pressure.full,id=memory:1.500000\n");
+    EXPECT_EQ(messages.at(1), "C:sys.pressure.full,id=cpu:1.500000\n");
+    EXPECT_EQ(messages.at(2), "C:sys.pressure.some,id=io:2.000000\n");
+    EXPECT_EQ(messages.at(3), "C:sys.pressure.full,id=io:1.500000\n");
+    EXPECT_EQ(messages.at(4), "C:sys.pressure.some,id=memory:2.000000\n");
+    EXPECT_EQ(messages.at(5), "C:sys.pressure.full,id=memory:1.500000\n");
+}
+
+TEST(PsiTriggersTest, ParsePsi)
+{
+    auto stats = atlasagent::parse_psi(
+        "some avg10=1.25 avg60=0.18 avg300=0.18 total=2000000\n"
+        "full avg10=0.50 avg60=0.00 avg300=0.00 total=1500000\n");
+    ASSERT_TRUE(stats.some.has_value());
+    ASSERT_TRUE(stats.full.has_value());
+    EXPECT_DOUBLE_EQ(stats.some->avg10, 1.25);
+    EXPECT_EQ(stats.some->total, 2000000);
+    EXPECT_DOUBLE_EQ(stats.full->avg10, 0.5);
+    EXPECT_EQ(stats.full->total, 1500000);
+
+    // kernels before 5.13 have no full line for cpu at the host level
+    stats = atlasagent::parse_psi("some avg10=0.00 avg60=0.00 avg300=0.00 total=42\n");
+    EXPECT_TRUE(stats.some.has_value());
+    EXPECT_FALSE(stats.full.has_value());
+}
+
+TEST(PsiTriggersTest, Avg10WithoutTriggers)
+{
+    auto config = Config(WriterConfig(WriterTypes::Memory));
+    auto r = Registry(config);
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    memoryWriter->Clear();
+
+    // triggers are never written to regular files, so only the avg10 peaks are reported
+    atlasagent::PsiTriggers triggers{&r, "lib/collectors/pressure_stall/test/resources"};
+    EXPECT_EQ(triggers.armed(), 0);
+    triggers.poll();
+    auto messages = memoryWriter->GetMessages();
+    EXPECT_EQ(messages.size(), 6);
+    for (const auto& m : messages)
+    {
+        EXPECT_TRUE(m.starts_with("m:sys.pressure.avg10,")) << m;
+    }
 }
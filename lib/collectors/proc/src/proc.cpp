@@ -5,8 +5,10 @@
 #include <absl/strings/str_split.h>
 #include <absl/strings/str_join.h>
 #include <absl/strings/numbers.h>
+#include <array>
 #include <cinttypes>
 #include <cstring>
+#include <optional>
 #include <utility>
 
 namespace atlasagent
@@ -38,6 +40,11 @@ void Proc::handle_line(FILE* fp) noexcept
     if (assigned > 0)
     {
         iface[strlen(iface) - 1] = '\0';  // strip trailing ':'
+        if (!iface_filter_.matches(iface))
+        {
+            discard_line(fp);
+            return;
+        }
 
         auto allTagsIn = this->net_tags_;
         allTagsIn.emplace("iface", iface);
@@ -67,8 +74,79 @@ void Proc::handle_line(FILE* fp) noexcept
     }
 }
 
+Proc::NetIfaceCounters Proc::make_iface_counters(const std::string& name) const
+{
+    auto in = net_tags_;
+    in.emplace("iface", name);
+    auto out = in;
+    auto collisions = registry_->CreateMonotonicCounter("net.iface.collisions", in);
+    in.emplace("id", "in");
+    out.emplace("id", "out");
+    return NetIfaceCounters{name,
+                            registry_->CreateMonotonicCounter("net.iface.bytes", in),
+                            registry_->CreateMonotonicCounter("net.iface.packets", in),
+                            registry_->CreateMonotonicCounter("net.iface.errors", in),
+                            registry_->CreateMonotonicCounter("net.iface.droppedPackets", in),
+                            registry_->CreateMonotonicCounter("net.iface.bytes", out),
+                            registry_->CreateMonotonicCounter("net.iface.packets", out),
+                            registry_->CreateMonotonicCounter("net.iface.errors", out),
+                            registry_->CreateMonotonicCounter("net.iface.droppedPackets", out),
+                            collisions};
+}
+
+bool Proc::netlink_network_stats() noexcept
+{
+    auto links = rtnl::dump_link_stats();
+    if (!links)
+    {
+        return false;
+    }
+
+    std::unordered_map<int, NetIfaceCounters> seen;
+    seen.reserve(links->size());
+    for (const auto& link : *links)
+    {
+        if (!iface_filter_.matches(link.name))
+        {
+            continue;
+        }
+        auto it = iface_counters_.find(link.ifindex);
+        // an ifindex is only reused after its interface is gone, but a rename keeps the index
+        if (it == iface_counters_.end() || it->second.name != link.name)
+        {
+            it = iface_counters_.insert_or_assign(link.ifindex, make_iface_counters(link.name)).first;
+        }
+        const auto& c = it->second;
+        const auto& st = link.stats;
+
+        // the same sums /proc/net/dev prints for errs+fifo+frame, drop, errs+fifo and colls
+        c.bytes_in.Set(st.rx_bytes);
+        c.packets_in.Set(st.rx_packets);
+        c.errors_in.Set(st.rx_errors + st.rx_fifo_errors + st.rx_length_errors + st.rx_over_errors +
+                        st.rx_crc_errors + st.rx_frame_errors);
+        c.dropped_in.Set(st.rx_dropped + st.rx_missed_errors);
+        c.collisions.Set(st.collisions);
+        c.bytes_out.Set(st.tx_bytes);
+        c.packets_out.Set(st.tx_packets);
+        c.errors_out.Set(st.tx_errors + st.tx_fifo_errors);
+        c.dropped_out.Set(st.tx_dropped);
+
+        seen.emplace(link.ifindex, std::move(it->second));
+    }
+    // drop handles for interfaces that went away (veth churn on busy nodes)
+    iface_counters_ = std::move(seen);
+    return true;
+}
+
 void Proc::network_stats() noexcept
 {
+    // The rtnetlink dump describes the live network namespace, so it only replaces /proc/net/dev when
+    // reading the real /proc; a test prefix always goes through the file parser below.
+    if (path_prefix_ == "/proc" && netlink_network_stats())
+    {
+        return;
+    }
+
     auto fp = open_file(path_prefix_, "net/dev");
     if (fp == nullptr)
     {
@@ -515,6 +593,85 @@ inline void set_if_present(const std::unordered_map<std::string, int64_t>& stats
     }
 }
 
+inline void set_if_present(const std::optional<int64_t>& value, const MonotonicCounter& ctr)
+{
+    if (value)
+    {
+        ctr.Set(*value);
+    }
+}
+
+// Reclaim and compaction counters from /proc/vmstat. Older kernels split pgscan/pgsteal/allocstall
+// per zone (pgscan_kswapd_normal, allocstall_movable, ...) and newer ones split workingset_refault
+// into anon/file, so each counter is the sum of every key sharing its prefix. A counter stays unset
+// when the kernel does not expose any of its keys.
+struct VmstatReclaim
+{
+    std::optional<int64_t> pgscan_kswapd;
+    std::optional<int64_t> pgscan_direct;
+    std::optional<int64_t> pgsteal_kswapd;
+    std::optional<int64_t> pgsteal_direct;
+    std::optional<int64_t> allocstall;
+    std::optional<int64_t> compact_stall;
+    std::optional<int64_t> compact_fail;
+    std::optional<int64_t> thp_fault_alloc;
+    std::optional<int64_t> thp_fault_fallback;
+    std::optional<int64_t> workingset_refault;
+    std::optional<int64_t> oom_kill;
+
+    explicit VmstatReclaim(const std::unordered_map<std::string, int64_t>& stats)
+    {
+        auto add = [](std::optional<int64_t>& total, int64_t value) { total = total.value_or(0) + value; };
+        for (const auto& [key, value] : stats)
+        {
+            if (key.starts_with("pgscan_kswapd"))
+            {
+                add(pgscan_kswapd, value);
+            }
+            else if (key.starts_with("pgscan_direct") && key != "pgscan_direct_throttle")
+            {
+                add(pgscan_direct, value);
+            }
+            else if (key.starts_with("pgsteal_kswapd"))
+            {
+                add(pgsteal_kswapd, value);
+            }
+            else if (key.starts_with("pgsteal_direct"))
+            {
+                add(pgsteal_direct, value);
+            }
+            else if (key.starts_with("allocstall"))
+            {
+                add(allocstall, value);
+            }
+            else if (key.starts_with("workingset_refault"))
+            {
+                add(workingset_refault, value);
+            }
+            else if (key == "compact_stall")
+            {
+                compact_stall = value;
+            }
+            else if (key == "compact_fail")
+            {
+                compact_fail = value;
+            }
+            else if (key == "thp_fault_alloc")
+            {
+                thp_fault_alloc = value;
+            }
+            else if (key == "thp_fault_fallback")
+            {
+                thp_fault_fallback = value;
+            }
+            else if (key == "oom_kill")
+            {
+                oom_kill = value;
+            }
+        }
+    }
+};
+
 void Proc::uptime_stats() noexcept
 {
     static auto sys_uptime = registry_->CreateGauge("sys.uptime");
@@ -534,6 +691,17 @@ void Proc::vmstats() noexcept
     static auto page_out = registry_->CreateMonotonicCounter("vmstat.paging", {{"id", "out"}});
     static auto swap_in = registry_->CreateMonotonicCounter("vmstat.swapping", {{"id", "in"}});
     static auto swap_out = registry_->CreateMonotonicCounter("vmstat.swapping", {{"id", "out"}});
+    static auto scan_kswapd = registry_->CreateMonotonicCounter("vmstat.pgscan", {{"id", "kswapd"}});
+    static auto scan_direct = registry_->CreateMonotonicCounter("vmstat.pgscan", {{"id", "direct"}});
+    static auto steal_kswapd = registry_->CreateMonotonicCounter("vmstat.pgsteal", {{"id", "kswapd"}});
+    static auto steal_direct = registry_->CreateMonotonicCounter("vmstat.pgsteal", {{"id", "direct"}});
+    static auto alloc_stall = registry_->CreateMonotonicCounter("vmstat.allocStall");
+    static auto compact_stall = registry_->CreateMonotonicCounter("vmstat.compaction", {{"id", "stall"}});
+    static auto compact_fail = registry_->CreateMonotonicCounter("vmstat.compaction", {{"id", "fail"}});
+    static auto thp_alloc = registry_->CreateMonotonicCounter("vmstat.thpFault", {{"id", "alloc"}});
+    static auto thp_fallback = registry_->CreateMonotonicCounter("vmstat.thpFault", {{"id", "fallback"}});
+    static auto refault = registry_->CreateMonotonicCounter("vmstat.workingsetRefault");
+    static auto oom_kill = registry_->CreateMonotonicCounter("vmstat.oomKill");
     static auto fh_alloc = registry_->CreateGauge("vmstat.fh.allocated");
     static auto fh_max = registry_->CreateGauge("vmstat.fh.max");
 
@@ -573,6 +741,19 @@ void Proc::vmstats() noexcept
     set_if_present(vmstats, "pswpin", swap_in);
     set_if_present(vmstats, "pswpout", swap_out);
 
+    VmstatReclaim reclaim{vmstats};
+    set_if_present(reclaim.pgscan_kswapd, scan_kswapd);
+    set_if_present(reclaim.pgscan_direct, scan_direct);
+    set_if_present(reclaim.pgsteal_kswapd, steal_kswapd);
+    set_if_present(reclaim.pgsteal_direct, steal_direct);
+    set_if_present(reclaim.allocstall, alloc_stall);
+    set_if_present(reclaim.compact_stall, compact_stall);
+    set_if_present(reclaim.compact_fail, compact_fail);
+    set_if_present(reclaim.thp_fault_alloc, thp_alloc);
+    set_if_present(reclaim.thp_fault_fallback, thp_fallback);
+    set_if_present(reclaim.workingset_refault, refault);
+    set_if_present(reclaim.oom_kill, oom_kill);
+
     auto fh = open_file(path_prefix_, "sys/fs/file-nr");
     if (fgets(line, sizeof line, fh) != nullptr)
     {
@@ -769,12 +950,13 @@ void Proc::CollectK8s() noexcept
     uptime_stats();
 }
 
-void Proc::CpuStats(const bool fiveSecondMetrics, const bool sixtySecondMetricsEnabled) noexcept
+std::vector<std::vector<std::string>> Proc::CpuStats(const bool fiveSecondMetrics,
+                                                     const bool sixtySecondMetricsEnabled) noexcept
 {
     auto cpuLines = ParseProcStatFile();
     if (cpuLines.empty())
     {
-        return;
+        return cpuLines;
     }
 
     // If 60-second metrics are enabled, collect utilization metrics
@@ -792,6 +974,7 @@ void Proc::CpuStats(const bool fiveSecondMetrics, const bool sixtySecondMetricsE
 
     // Always collect peak stats (called every 1 second)
     PeakCpuStats(cpuLines[0]);
+    return cpuLines;
 }
 
 void Proc::memory_stats() noexcept
@@ -870,17 +1053,75 @@ void Proc::memory_stats() noexcept
     total_free.Set(total_free_bytes * 1024.0);
 }
 
-inline int64_t to_int64(const std::string& s)
+// Maps the columns of a "Prefix: Name1 Name2 ..." header line from /proc/net/netstat to a fixed set
+// of wanted names. Column positions are only recomputed when the header text changes (i.e. once per
+// kernel), so each read is a single pass over the value line with no splitting or allocation.
+template <size_t N>
+class HeaderIndex
 {
-    int64_t res;
-    auto parsed = absl::SimpleAtoi(s, &res);
-    return parsed ? res : 0;
-}
+   public:
+    explicit HeaderIndex(const std::array<const char*, N>& names) noexcept : names_(names) {}
+
+    void update(const char* header)
+    {
+        if (header_ == header)
+        {
+            return;
+        }
+        header_ = header;
+        columns_.clear();
+        std::vector<std::string> fields = absl::StrSplit(header, absl::ByAnyChar(" \t\n"), absl::SkipEmpty());
+        for (const auto& field : fields)
+        {
+            auto it = std::find_if(names_.begin(), names_.end(), [&field](const char* n) { return field == n; });
+            columns_.push_back(it == names_.end() ? -1 : static_cast<int>(it - names_.begin()));
+        }
+    }
+
+    // Values for the wanted names, unset when the kernel does not export a column.
+    std::array<std::optional<int64_t>, N> parse(const char* values) const noexcept
+    {
+        std::array<std::optional<int64_t>, N> result;
+        auto p = values;
+        for (auto slot : columns_)
+        {
+            char* end;
+            auto v = strtoll(p, &end, 10);
+            if (end == p && slot != -1)
+            {
+                break;  // the first column is the "Prefix:" label; any other non-number ends the line
+            }
+            if (slot >= 0)
+            {
+                result[slot] = v;
+            }
+            p = end == p ? strpbrk(p, " \t") : end;
+            if (p == nullptr)
+            {
+                break;
+            }
+        }
+        return result;
+    }
+
+   private:
+    std::array<const char*, N> names_;
+    std::string header_;
+    std::vector<int> columns_;  // wanted-name slot for each header column, -1 if not wanted
+};
 
 void Proc::socket_stats() noexcept
 {
     auto pagesize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
     static auto tcp_memory = registry_->CreateGauge("net.tcp.memory");
+    static auto tcp_inuse = registry_->CreateGauge("net.tcp.sockets", {{"id", "inuse"}, {"proto", "v4"}});
+    static auto tcp6_inuse = registry_->CreateGauge("net.tcp.sockets", {{"id", "inuse"}, {"proto", "v6"}});
+    static auto tcp_orphan = registry_->CreateGauge("net.tcp.sockets", {{"id", "orphan"}});
+    static auto tcp_tw = registry_->CreateGauge("net.tcp.sockets", {{"id", "timeWait"}});
+    static auto tcp_alloc = registry_->CreateGauge("net.tcp.sockets", {{"id", "alloc"}});
+    static auto udp_memory = registry_->CreateGauge("net.udp.memory");
+    static auto udp_inuse = registry_->CreateGauge("net.udp.sockets", {{"id", "inuse"}, {"proto", "v4"}});
+    static auto udp6_inuse = registry_->CreateGauge("net.udp.sockets", {{"id", "inuse"}, {"proto", "v6"}});
 
     auto fp = open_file(path_prefix_, "net/sockstat");
     if (fp == nullptr)
@@ -888,22 +1129,42 @@ void Proc::socket_stats() noexcept
         return;
     }
 
+    // orphan, tw, alloc and mem are shared by v4 and v6, so only inuse is split by protocol
     char line[1024];
     while (fgets(line, sizeof line, fp) != nullptr)
     {
-        if (starts_with(line, "TCP:"))
+        int64_t inuse, orphan, tw, alloc, mem;
+        if (sscanf(line, "TCP: inuse %" SCNd64 " orphan %" SCNd64 " tw %" SCNd64 " alloc %" SCNd64 " mem %" SCNd64,
+                   &inuse, &orphan, &tw, &alloc, &mem) == 5)
         {
-            std::vector<std::string> values = absl::StrSplit(line, absl::ByAnyChar(" \t\n"), absl::SkipEmpty());
-            auto idx = 0u;
-            for (const auto& value : values)
-            {
-                if (value == "mem")
-                {
-                    tcp_memory.Set(to_int64(values[idx + 1]) * pagesize);
-                }
-                ++idx;
-            }
-            break;
+            tcp_inuse.Set(inuse);
+            tcp_orphan.Set(orphan);
+            tcp_tw.Set(tw);
+            tcp_alloc.Set(alloc);
+            tcp_memory.Set(mem * pagesize);
+        }
+        else if (sscanf(line, "UDP: inuse %" SCNd64 " mem %" SCNd64, &inuse, &mem) == 2)
+        {
+            udp_inuse.Set(inuse);
+            udp_memory.Set(mem * pagesize);
+        }
+    }
+
+    auto fp6 = open_file(path_prefix_, "net/sockstat6");
+    if (fp6 == nullptr)
+    {
+        return;
+    }
+    while (fgets(line, sizeof line, fp6) != nullptr)
+    {
+        int64_t inuse;
+        if (sscanf(line, "TCP6: inuse %" SCNd64, &inuse) == 1)
+        {
+            tcp6_inuse.Set(inuse);
+        }
+        else if (sscanf(line, "UDP6: inuse %" SCNd64, &inuse) == 1)
+        {
+            udp6_inuse.Set(inuse);
         }
     }
 }
@@ -921,6 +1182,33 @@ void Proc::netstat_stats() noexcept
     static auto noEct_ctr = registry_->CreateMonotonicCounter("net.ip.ectPackets", notCapableTags);
     static auto congested_ctr = registry_->CreateMonotonicCounter("net.ip.congestedPackets", protoTags);
 
+    auto tagged = [this](std::unordered_map<std::string, std::string> tags)
+    {
+        tags.insert(net_tags_.begin(), net_tags_.end());
+        return tags;
+    };
+    // counters are in the same order as the TcpExt names they are set from
+    static HeaderIndex<7> tcpExtIndex{{"ListenOverflows", "ListenDrops", "TCPBacklogDrop", "TCPTimeouts",
+                                       "TCPLossProbes", "TCPMemoryPressures", "PruneCalled"}};
+    static std::array<MonotonicCounter, 7> tcpExtCtrs{
+        registry_->CreateMonotonicCounter("net.tcp.listen", tagged({{"id", "overflows"}})),
+        registry_->CreateMonotonicCounter("net.tcp.listen", tagged({{"id", "drops"}})),
+        registry_->CreateMonotonicCounter("net.tcp.errors", tagged({{"id", "backlogDrops"}})),
+        registry_->CreateMonotonicCounter("net.tcp.errors", tagged({{"id", "timeouts"}})),
+        registry_->CreateMonotonicCounter("net.tcp.lossProbes", net_tags_),
+        registry_->CreateMonotonicCounter("net.tcp.memoryPressures", net_tags_),
+        registry_->CreateMonotonicCounter("net.tcp.pruneCalled", net_tags_),
+    };
+
+    enum IpExt
+    {
+        InNoECTPkts,
+        InECT1Pkts,
+        InECT0Pkts,
+        InCEPkts,
+    };
+    static HeaderIndex<4> ipExtIndex{{"InNoECTPkts", "InECT1Pkts", "InECT0Pkts", "InCEPkts"}};
+
     auto fp = open_file(path_prefix_, "net/netstat");
     if (fp == nullptr)
     {
@@ -928,39 +1216,36 @@ void Proc::netstat_stats() noexcept
     }
 
     int64_t noEct = 0, ect = 0, congested = 0;
-    char line[1024];
-    while (fgets(line, sizeof line, fp) != nullptr)
+    // the TcpExt header is several KB on recent kernels
+    char header[8192];
+    char line[8192];
+    while (fgets(header, sizeof header, fp) != nullptr)
     {
-        if (starts_with(line, "IpExt:"))
+        if (fgets(line, sizeof line, fp) == nullptr)
         {
-            // get header indexes
-            std::vector<std::string> headers = absl::StrSplit(line, absl::ByAnyChar(" \t\n"), absl::SkipEmpty());
-            if (fgets(line, sizeof line, fp) == nullptr)
-            {
-                Logger()->warn("Unable to parse {}/net/netstat", path_prefix_);
-                return;
-            }
-            std::vector<std::string> values = absl::StrSplit(line, absl::ByAnyChar(" \t\n"), absl::SkipEmpty());
-            ;
-            assert(values.size() == headers.size());
-            auto idx = 0u;
-            for (const auto& header : headers)
+            Logger()->warn("Unable to parse {}/net/netstat", path_prefix_);
+            return;
+        }
+
+        if (starts_with(header, "TcpExt:"))
+        {
+            tcpExtIndex.update(header);
+            auto values = tcpExtIndex.parse(line);
+            for (size_t i = 0; i < values.size(); ++i)
             {
-                if (header == "InNoECTPkts")
-                {
-                    noEct = to_int64(values[idx]);
-                }
-                else if (header == "InECT1Pkts" || header == "InECT0Pkts")
+                if (values[i])
                 {
-                    ect += to_int64(values[idx]);
+                    tcpExtCtrs[i].Set(*values[i]);
                 }
-                else if (header == "InCEPkts")
-                {
-                    congested = to_int64(values[idx]);
-                }
-                ++idx;
             }
-            break;
+        }
+        else if (starts_with(header, "IpExt:"))
+        {
+            ipExtIndex.update(header);
+            auto values = ipExtIndex.parse(line);
+            noEct = values[InNoECTPkts].value_or(0);
+            ect = values[InECT1Pkts].value_or(0) + values[InECT0Pkts].value_or(0);
+            congested = values[InCEPkts].value_or(0);
         }
     }
 
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "rtnetlink.h"
+
+#include <lib/util/src/name_filter.h>
 #include <thirdparty/spectator-cpp/spectator/registry.h>
 
 namespace atlasagent
@@ -10,7 +13,10 @@ class Proc
    public:
     Proc(Registry* registry, std::unordered_map<std::string, std::string> net_tags,
          std::string path_prefix = "/proc") noexcept
-        : registry_(registry), net_tags_{std::move(net_tags)}, path_prefix_(std::move(path_prefix))
+        : registry_(registry),
+          net_tags_{std::move(net_tags)},
+          path_prefix_(std::move(path_prefix)),
+          iface_filter_{NameFilter::FromEnv("ATLAS_NET_IFACE_INCLUDE", "ATLAS_NET_IFACE_EXCLUDE")}
     {
     }
     // 60-second "slow" proc metrics for each agent flavor. These are the production entry points;
@@ -19,8 +25,10 @@ class Proc
     void CollectTitus() noexcept;
     void CollectK8s() noexcept;
 
-    // Peak CPU metrics run every second (1s/5s/60s cadence), separate from the slow set above.
-    void CpuStats(const bool fiveSecondMetrics, const bool sixtySecondMetricsEnabled) noexcept;
+    // Peak CPU metrics run every second (1s/5s/60s cadence), separate from the slow set above. Returns the
+    // parsed cpu lines of /proc/stat (aggregate first) so other per-second consumers can reuse them.
+    std::vector<std::vector<std::string>> CpuStats(const bool fiveSecondMetrics,
+                                                   const bool sixtySecondMetricsEnabled) noexcept;
     void set_prefix(const std::string& new_prefix) noexcept;  // for testing
 
    protected:
@@ -46,6 +54,17 @@ class Proc
     void UpdateCoreUtilization(const std::vector<std::vector<std::string>>& cpu_lines, const bool sixtySecondMetricsEnabled);
     void UpdateNumProcs(const unsigned int numberProcessors);
 
+    // Counter handles for one interface, cached by ifindex so the rtnetlink path does not rebuild tag
+    // maps or look up meters for every interface on every collection.
+    struct NetIfaceCounters
+    {
+        std::string name;
+        MonotonicCounter bytes_in, packets_in, errors_in, dropped_in;
+        MonotonicCounter bytes_out, packets_out, errors_out, dropped_out;
+        MonotonicCounter collisions;
+    };
+    NetIfaceCounters make_iface_counters(const std::string& name) const;
+    bool netlink_network_stats() noexcept;
     void handle_line(FILE* fp) noexcept;
     void parse_ip_stats(const char* buf) noexcept;
     void parse_tcp_stats(const char* buf) noexcept;
@@ -58,6 +77,9 @@ class Proc
     Registry* registry_;
     const std::unordered_map<std::string, std::string> net_tags_;
     std::string path_prefix_;
+    std::unordered_map<int, NetIfaceCounters> iface_counters_;
+    // interfaces to report, e.g. to leave out the veth pair of every pod
+    NameFilter iface_filter_;
 };
 
 namespace proc
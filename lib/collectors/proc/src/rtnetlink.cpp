@@ -0,0 +1,122 @@
+#include "rtnetlink.h"
+
+#include <lib/files/src/files.h>
+
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <sys/socket.h>
+
+#include <cerrno>
+#include <algorithm>
+#include <cstring>
+
+namespace atlasagent::rtnl
+{
+
+ParseResult parse_link_messages(const char* buf, size_t len, std::vector<LinkStats>* links) noexcept
+{
+    auto remaining = static_cast<int>(len);
+    for (auto nh = reinterpret_cast<const nlmsghdr*>(buf); NLMSG_OK(nh, remaining); nh = NLMSG_NEXT(nh, remaining))
+    {
+        if (nh->nlmsg_type == NLMSG_DONE)
+        {
+            return ParseResult::Done;
+        }
+        if (nh->nlmsg_type == NLMSG_ERROR)
+        {
+            return ParseResult::Error;
+        }
+        if (nh->nlmsg_type != RTM_NEWLINK || nh->nlmsg_len < NLMSG_LENGTH(sizeof(ifinfomsg)))
+        {
+            continue;
+        }
+
+        auto ifi = static_cast<const ifinfomsg*>(NLMSG_DATA(nh));
+        LinkStats link;
+        link.ifindex = ifi->ifi_index;
+        auto has_stats = false;
+
+        auto attr_len = static_cast<int>(IFLA_PAYLOAD(nh));
+        for (auto rta = IFLA_RTA(ifi); RTA_OK(rta, attr_len); rta = RTA_NEXT(rta, attr_len))
+        {
+            if (rta->rta_type == IFLA_IFNAME)
+            {
+                auto name = static_cast<const char*>(RTA_DATA(rta));
+                link.name.assign(name, strnlen(name, RTA_PAYLOAD(rta)));
+            }
+            else if (rta->rta_type == IFLA_STATS64)
+            {
+                // attributes are only 4-byte aligned; older kernels may also send a shorter struct
+                memcpy(&link.stats, RTA_DATA(rta), std::min<size_t>(sizeof link.stats, RTA_PAYLOAD(rta)));
+                has_stats = true;
+            }
+        }
+
+        if (has_stats && !link.name.empty())
+        {
+            links->emplace_back(std::move(link));
+        }
+    }
+    return remaining == 0 ? ParseResult::More : ParseResult::Error;
+}
+
+std::optional<std::vector<LinkStats>> dump_link_stats() noexcept
+{
+    UnixFile sock{socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE)};
+    if (sock < 0)
+    {
+        Logger()->warn("Unable to open rtnetlink socket: {}", strerror(errno));
+        return std::nullopt;
+    }
+
+    // The dump filters the kernel offers (IFLA_MASTER, IFLA_LINKINFO kind) select a single master or
+    // kind, they cannot exclude one, so every link is requested and filtering happens in the caller.
+    struct
+    {
+        nlmsghdr nh;
+        ifinfomsg ifm;
+    } req{};
+    static uint32_t seq = 0;
+    req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(ifinfomsg));
+    req.nh.nlmsg_type = RTM_GETLINK;
+    req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nh.nlmsg_seq = ++seq;
+    req.ifm.ifi_family = AF_UNSPEC;
+
+    sockaddr_nl kernel{};
+    kernel.nl_family = AF_NETLINK;
+    if (sendto(sock, &req, req.nh.nlmsg_len, 0, reinterpret_cast<sockaddr*>(&kernel), sizeof kernel) < 0)
+    {
+        Logger()->warn("Unable to send RTM_GETLINK request: {}", strerror(errno));
+        return std::nullopt;
+    }
+
+    std::vector<LinkStats> links;
+    // large enough for the kernel's dump skb size, so each recv returns complete messages
+    alignas(nlmsghdr) static char buf[32768];
+    for (;;)
+    {
+        auto n = recv(sock, buf, sizeof buf, 0);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            Logger()->warn("Error reading RTM_GETLINK dump: {}", strerror(errno));
+            return std::nullopt;
+        }
+        auto result = parse_link_messages(buf, static_cast<size_t>(n), &links);
+        if (result == ParseResult::Done)
+        {
+            return links;
+        }
+        if (result == ParseResult::Error || n == 0)
+        {
+            Logger()->warn("Malformed RTM_GETLINK dump");
+            return std::nullopt;
+        }
+    }
+}
+
+}  // namespace atlasagent::rtnl
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <linux/if_link.h>
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace atlasagent::rtnl
+{
+
+// Interface name and 64-bit counters for one link, as returned by an RTM_GETLINK dump.
+struct LinkStats
+{
+    int ifindex{};
+    std::string name;
+    rtnl_link_stats64 stats{};
+};
+
+enum class ParseResult
+{
+    More,   // the dump continues in the next datagram
+    Done,   // NLMSG_DONE seen
+    Error,  // NLMSG_ERROR or a truncated message
+};
+
+// Append every RTM_NEWLINK message in one netlink datagram that carries IFLA_STATS64 to `links`.
+ParseResult parse_link_messages(const char* buf, size_t len, std::vector<LinkStats>* links) noexcept;
+
+// Dump all links in the current network namespace over a NETLINK_ROUTE socket. The kernel fills
+// rtnl_link_stats64 directly, which avoids formatting and re-parsing /proc/net/dev. Returns nullopt
+// if the socket cannot be used, so callers can fall back to /proc/net/dev.
+std::optional<std::vector<LinkStats>> dump_link_stats() noexcept;
+
+}  // namespace atlasagent::rtnl
@@ -3,12 +3,15 @@
 #include <thirdparty/spectator-cpp/libs/writer/writer_wrapper/writer_test_helper.h>
 #include <lib/collectors/proc/src/proc.h>
 #include <lib/collectors/proc/src/proc_cpu.h>
+#include <lib/collectors/proc/src/rtnetlink.h>
 
 #include <fmt/ostream.h>
 #include <gtest/gtest.h>
 #include <iostream>
 #include <iomanip>
 #include <algorithm>
+#include <cstring>
+#include <linux/rtnetlink.h>
 
 namespace
 {
@@ -115,6 +118,73 @@ TEST(Proc, ParseNetwork)
     EXPECT_EQ(messages.at(26), "C:net.iface.droppedPackets,id=out,iface=eth0,nf.test=extra:1.000000\n");
 }
 
+TEST(Proc, ParseNetworkFiltered)
+{
+    auto config = Config(WriterConfig(WriterTypes::Memory));
+    auto r = Registry(config);
+    setenv("ATLAS_NET_IFACE_INCLUDE", "eth*", 1);
+    setenv("ATLAS_NET_IFACE_EXCLUDE", "eth1", 1);
+    TestProc proc{&r, {}, "testdata/resources/proc"};
+    unsetenv("ATLAS_NET_IFACE_INCLUDE");
+    unsetenv("ATLAS_NET_IFACE_EXCLUDE");
+
+    // eth1 is excluded and lo is not included, so only eth0 is reported
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    memoryWriter->Clear();
+    proc.network_stats();
+    auto messages = memoryWriter->GetMessages();
+    EXPECT_EQ(messages.size(), 9);
+    for (const auto& m : messages)
+    {
+        EXPECT_TRUE(m.find(",iface=eth0") != std::string::npos) << m;
+    }
+    EXPECT_EQ(messages.at(0), "C:net.iface.bytes,id=in,iface=eth0:3437349965.000000\n");
+}
+
+// Append one netlink attribute to a message under construction.
+static void add_attr(std::vector<char>* msg, unsigned short type, const void* data, size_t len)
+{
+    auto offset = msg->size();
+    msg->resize(offset + RTA_SPACE(len));
+    auto rta = reinterpret_cast<rtattr*>(msg->data() + offset);
+    rta->rta_type = type;
+    rta->rta_len = RTA_LENGTH(len);
+    memcpy(RTA_DATA(rta), data, len);
+}
+
+TEST(Proc, ParseLinkMessages)
+{
+    std::vector<char> buf(NLMSG_SPACE(sizeof(ifinfomsg)));
+    auto ifi = static_cast<ifinfomsg*>(NLMSG_DATA(reinterpret_cast<nlmsghdr*>(buf.data())));
+    ifi->ifi_index = 2;
+    add_attr(&buf, IFLA_IFNAME, "eth0", 5);
+    rtnl_link_stats64 stats{};
+    stats.rx_bytes = 3437349965;
+    stats.tx_packets = 12878559;
+    add_attr(&buf, IFLA_STATS64, &stats, sizeof stats);
+    auto nh = reinterpret_cast<nlmsghdr*>(buf.data());
+    nh->nlmsg_len = buf.size();
+    nh->nlmsg_type = RTM_NEWLINK;
+
+    std::vector<atlasagent::rtnl::LinkStats> links;
+    EXPECT_EQ(atlasagent::rtnl::parse_link_messages(buf.data(), buf.size(), &links),
+              atlasagent::rtnl::ParseResult::More);
+    ASSERT_EQ(links.size(), 1);
+    EXPECT_EQ(links[0].ifindex, 2);
+    EXPECT_EQ(links[0].name, "eth0");
+    EXPECT_EQ(links[0].stats.rx_bytes, 3437349965);
+    EXPECT_EQ(links[0].stats.tx_packets, 12878559);
+
+    nlmsghdr done{};
+    done.nlmsg_len = NLMSG_LENGTH(sizeof(int));
+    done.nlmsg_type = NLMSG_DONE;
+    std::vector<char> last(NLMSG_SPACE(sizeof(int)));
+    memcpy(last.data(), &done, sizeof done);
+    EXPECT_EQ(atlasagent::rtnl::parse_link_messages(last.data(), last.size(), &links),
+              atlasagent::rtnl::ParseResult::Done);
+    EXPECT_EQ(links.size(), 1);
+}
+
 TEST(Proc, ParseSnmp)
 {
     auto config = Config(WriterConfig(WriterTypes::Memory));
@@ -346,7 +416,7 @@ TEST(Proc, VmStats)
     auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
     auto messages = memoryWriter->GetMessages();
 
-    EXPECT_EQ(messages.size(), 9);
+    EXPECT_EQ(messages.size(), 19);
     EXPECT_EQ(messages.at(0), "C:vmstat.procs.count:537838.000000\n");
     EXPECT_EQ(messages.at(1), "g:vmstat.procs,id=running:1.000000\n");
     EXPECT_EQ(messages.at(2), "g:vmstat.procs,id=blocked:0.000000\n");
@@ -354,15 +424,20 @@ TEST(Proc, VmStats)
     EXPECT_EQ(messages.at(4), "C:vmstat.paging,id=out:939162.000000\n");
     EXPECT_EQ(messages.at(5), "C:vmstat.swapping,id=in:0.000000\n");
     EXPECT_EQ(messages.at(6), "C:vmstat.swapping,id=out:0.000000\n");
-    EXPECT_EQ(messages.at(7), "g:vmstat.fh.allocated:2016.000000\n");
-    EXPECT_EQ(messages.at(8), "g:vmstat.fh.max:12556616.000000\n");
+    EXPECT_EQ(messages.at(7), "C:vmstat.pgscan,id=kswapd:0.000000\n");
+    EXPECT_EQ(messages.at(12), "C:vmstat.compaction,id=stall:0.000000\n");
+    EXPECT_EQ(messages.at(14), "C:vmstat.thpFault,id=alloc:40.000000\n");
+    EXPECT_EQ(messages.at(16), "C:vmstat.workingsetRefault:0.000000\n");
+    // no oom_kill key on this kernel
+    EXPECT_EQ(messages.at(17), "g:vmstat.fh.allocated:2016.000000\n");
+    EXPECT_EQ(messages.at(18), "g:vmstat.fh.max:12556616.000000\n");
 
     memoryWriter->Clear();
     proc.set_prefix("testdata/resources/proc2");
     proc.vmstats();
     messages = memoryWriter->GetMessages();
 
-    EXPECT_EQ(messages.size(), 9);
+    EXPECT_EQ(messages.size(), 20);
     EXPECT_EQ(messages.at(0), "C:vmstat.procs.count:540697.000000\n");
     EXPECT_EQ(messages.at(1), "g:vmstat.procs,id=running:3.000000\n");
     EXPECT_EQ(messages.at(2), "g:vmstat.procs,id=blocked:4.000000\n");
@@ -370,8 +445,20 @@ TEST(Proc, VmStats)
     EXPECT_EQ(messages.at(4), "C:vmstat.paging,id=out:939418.000000\n");
     EXPECT_EQ(messages.at(5), "C:vmstat.swapping,id=in:0.000000\n");
     EXPECT_EQ(messages.at(6), "C:vmstat.swapping,id=out:0.000000\n");
-    EXPECT_EQ(messages.at(7), "g:vmstat.fh.allocated:2017.000000\n");
-    EXPECT_EQ(messages.at(8), "g:vmstat.fh.max:12556616.000000\n");
+    // per-zone keys are summed
+    EXPECT_EQ(messages.at(7), "C:vmstat.pgscan,id=kswapd:1234.000000\n");
+    EXPECT_EQ(messages.at(8), "C:vmstat.pgscan,id=direct:80.000000\n");
+    EXPECT_EQ(messages.at(9), "C:vmstat.pgsteal,id=kswapd:1100.000000\n");
+    EXPECT_EQ(messages.at(10), "C:vmstat.pgsteal,id=direct:50.000000\n");
+    EXPECT_EQ(messages.at(11), "C:vmstat.allocStall:3.000000\n");
+    EXPECT_EQ(messages.at(12), "C:vmstat.compaction,id=stall:2.000000\n");
+    EXPECT_EQ(messages.at(13), "C:vmstat.compaction,id=fail:1.000000\n");
+    EXPECT_EQ(messages.at(14), "C:vmstat.thpFault,id=alloc:40.000000\n");
+    EXPECT_EQ(messages.at(15), "C:vmstat.thpFault,id=fallback:5.000000\n");
+    EXPECT_EQ(messages.at(16), "C:vmstat.workingsetRefault:77.000000\n");
+    EXPECT_EQ(messages.at(17), "C:vmstat.oomKill:1.000000\n");
+    EXPECT_EQ(messages.at(18), "g:vmstat.fh.allocated:2017.000000\n");
+    EXPECT_EQ(messages.at(19), "g:vmstat.fh.max:12556616.000000\n");
 }
 
 TEST(Proc, MemoryStats)
@@ -406,20 +493,34 @@ TEST(Proc, ParseNetstat)
     auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
     auto messages = memoryWriter->GetMessages();
 
-    EXPECT_EQ(messages.size(), 3);
-    EXPECT_EQ(messages.at(0), "C:net.ip.congestedPackets,nf.test=extra,proto=v4:0.000000\n");
-    EXPECT_EQ(messages.at(1), "C:net.ip.ectPackets,nf.test=extra,proto=v4,id=capable:122266.000000\n");
-    EXPECT_EQ(messages.at(2), "C:net.ip.ectPackets,nf.test=extra,proto=v4,id=notCapable:380016.000000\n");
+    EXPECT_EQ(messages.size(), 10);
+    EXPECT_EQ(messages.at(0), "C:net.tcp.listen,nf.test=extra,id=overflows:0.000000\n");
+    EXPECT_EQ(messages.at(1), "C:net.tcp.listen,nf.test=extra,id=drops:0.000000\n");
+    EXPECT_EQ(messages.at(2), "C:net.tcp.errors,nf.test=extra,id=backlogDrops:0.000000\n");
+    EXPECT_EQ(messages.at(3), "C:net.tcp.errors,nf.test=extra,id=timeouts:1245.000000\n");
+    EXPECT_EQ(messages.at(4), "C:net.tcp.lossProbes,nf.test=extra:10.000000\n");
+    EXPECT_EQ(messages.at(5), "C:net.tcp.memoryPressures,nf.test=extra:0.000000\n");
+    EXPECT_EQ(messages.at(6), "C:net.tcp.pruneCalled,nf.test=extra:1.000000\n");
+    EXPECT_EQ(messages.at(7), "C:net.ip.congestedPackets,nf.test=extra,proto=v4:0.000000\n");
+    EXPECT_EQ(messages.at(8), "C:net.ip.ectPackets,nf.test=extra,proto=v4,id=capable:122266.000000\n");
+    EXPECT_EQ(messages.at(9), "C:net.ip.ectPackets,nf.test=extra,proto=v4,id=notCapable:380016.000000\n");
 
     memoryWriter->Clear();
     proc.set_prefix("testdata/resources/proc2");
     proc.netstat_stats();
     messages = memoryWriter->GetMessages();
 
-    EXPECT_EQ(messages.size(), 3);
-    EXPECT_EQ(messages.at(0), "C:net.ip.congestedPackets,nf.test=extra,proto=v4:30.000000\n");
-    EXPECT_EQ(messages.at(1), "C:net.ip.ectPackets,nf.test=extra,proto=v4,id=capable:122446.000000\n");
-    EXPECT_EQ(messages.at(2), "C:net.ip.ectPackets,nf.test=extra,proto=v4,id=notCapable:380076.000000\n");
+    EXPECT_EQ(messages.size(), 10);
+    EXPECT_EQ(messages.at(0), "C:net.tcp.listen,nf.test=extra,id=overflows:12.000000\n");
+    EXPECT_EQ(messages.at(1), "C:net.tcp.listen,nf.test=extra,id=drops:15.000000\n");
+    EXPECT_EQ(messages.at(2), "C:net.tcp.errors,nf.test=extra,id=backlogDrops:3.000000\n");
+    EXPECT_EQ(messages.at(3), "C:net.tcp.errors,nf.test=extra,id=timeouts:1300.000000\n");
+    EXPECT_EQ(messages.at(4), "C:net.tcp.lossProbes,nf.test=extra:20.000000\n");
+    EXPECT_EQ(messages.at(5), "C:net.tcp.memoryPressures,nf.test=extra:1.000000\n");
+    EXPECT_EQ(messages.at(6), "C:net.tcp.pruneCalled,nf.test=extra:2.000000\n");
+    EXPECT_EQ(messages.at(7), "C:net.ip.congestedPackets,nf.test=extra,proto=v4:30.000000\n");
+    EXPECT_EQ(messages.at(8), "C:net.ip.ectPackets,nf.test=extra,proto=v4,id=capable:122446.000000\n");
+    EXPECT_EQ(messages.at(9), "C:net.ip.ectPackets,nf.test=extra,proto=v4,id=notCapable:380076.000000\n");
 }
 
 TEST(Proc, ParseSocketStats)
@@ -433,9 +534,16 @@ TEST(Proc, ParseSocketStats)
     auto messages = memoryWriter->GetMessages();
 
     auto pagesize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
-    auto expected = "g:net.tcp.memory:" + std::to_string(4519.0 * pagesize) + "\n";
-    EXPECT_EQ(messages.size(), 1);
-    EXPECT_EQ(messages.at(0), expected);
+    EXPECT_EQ(messages.size(), 9);
+    EXPECT_EQ(messages.at(0), "g:net.tcp.sockets,proto=v4,id=inuse:8622.000000\n");
+    EXPECT_EQ(messages.at(1), "g:net.tcp.sockets,id=orphan:2.000000\n");
+    EXPECT_EQ(messages.at(2), "g:net.tcp.sockets,id=timeWait:32.000000\n");
+    EXPECT_EQ(messages.at(3), "g:net.tcp.sockets,id=alloc:8630.000000\n");
+    EXPECT_EQ(messages.at(4), "g:net.tcp.memory:" + std::to_string(4519.0 * pagesize) + "\n");
+    EXPECT_EQ(messages.at(5), "g:net.udp.sockets,proto=v4,id=inuse:3.000000\n");
+    EXPECT_EQ(messages.at(6), "g:net.udp.memory:" + std::to_string(2.0 * pagesize) + "\n");
+    EXPECT_EQ(messages.at(7), "g:net.tcp.sockets,proto=v6,id=inuse:14.000000\n");
+    EXPECT_EQ(messages.at(8), "g:net.udp.sockets,proto=v6,id=inuse:2.000000\n");
 }
 
 TEST(Proc, ArpStats)
@@ -0,0 +1,105 @@
+#include "schedstat.h"
+
+#include <cinttypes>
+#include <cstring>
+
+namespace atlasagent
+{
+
+std::vector<SchedStatCpu> parse_schedstat(FILE* fp) noexcept
+{
+    std::vector<SchedStatCpu> cpus;
+    if (fp == nullptr)
+    {
+        return cpus;
+    }
+
+    // domain lines hold one cpumask per domain and get long on large hosts; we only need the cpuN
+    // lines, so overlong lines are drained instead of growing the buffer
+    char line[4096];
+    while (fgets(line, sizeof line, fp) != nullptr)
+    {
+        auto complete = strchr(line, '\n') != nullptr;
+        if (starts_with(line, "cpu"))
+        {
+            unsigned cpu;
+            SchedStatCpu st;
+            // cpuN yld_count legacy sched_count sched_goidle ttwu_count ttwu_local rq_cpu_time rq_run_delay pcount
+            if (sscanf(line, "cpu%u %*u %*u %*u %*u %*u %*u %" SCNu64 " %" SCNu64 " %" SCNu64, &cpu,
+                       &st.run_time_ns, &st.run_delay_ns, &st.timeslices) == 4)
+            {
+                st.valid = true;
+                if (cpu >= cpus.size())
+                {
+                    cpus.resize(cpu + 1);
+                }
+                cpus[cpu] = st;
+            }
+        }
+
+        if (!complete)
+        {
+            for (auto ch = getc_unlocked(fp); ch != EOF && ch != '\n'; ch = getc_unlocked(fp))
+            {
+                // keep reading until the end of this line
+            }
+        }
+    }
+    return cpus;
+}
+
+SchedStat::SchedStat(Registry* registry, std::string path_prefix) noexcept
+    : registry_(registry),
+      path_prefix_(std::move(path_prefix)),
+      max_latency_(registry_->CreateMaxGauge("sys.cpu.runQueueLatency", {{"id", "max"}})),
+      mean_latency_(registry_->CreateMaxGauge("sys.cpu.runQueueLatency", {{"id", "mean"}}))
+{
+}
+
+void SchedStat::set_prefix(std::string new_prefix) noexcept { path_prefix_ = std::move(new_prefix); }
+
+void SchedStat::collect() noexcept
+{
+    auto fp = open_file(path_prefix_, "schedstat");
+    if (fp == nullptr)
+    {
+        return;
+    }
+
+    auto cur = parse_schedstat(fp);
+    if (cur.empty())
+    {
+        return;
+    }
+
+    auto have_sample = false;
+    double max_wait = 0.0;
+    uint64_t total_delay = 0;
+    uint64_t total_slices = 0;
+    for (size_t i = 0; i < cur.size() && i < prev_.size(); ++i)
+    {
+        const auto& c = cur[i];
+        const auto& p = prev_[i];
+        // skip cpus that went offline, and counters that went backward after a cpu was re-onlined
+        if (!c.valid || !p.valid || c.timeslices <= p.timeslices || c.run_delay_ns < p.run_delay_ns)
+        {
+            continue;
+        }
+
+        auto delta_delay = c.run_delay_ns - p.run_delay_ns;
+        auto delta_slices = c.timeslices - p.timeslices;
+        max_wait = std::max(max_wait, static_cast<double>(delta_delay) / delta_slices);
+        total_delay += delta_delay;
+        total_slices += delta_slices;
+        have_sample = true;
+    }
+    prev_ = std::move(cur);
+
+    if (have_sample)
+    {
+        max_latency_.Set(max_wait / NANOS);
+        mean_latency_.Set(static_cast<double>(total_delay) / total_slices / NANOS);
+    }
+}
+
+}  // namespace atlasagent
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <lib/util/src/util.h>
+#include <thirdparty/spectator-cpp/spectator/registry.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace atlasagent
+{
+
+// Cumulative per-CPU scheduler counters from a "cpuN" line of /proc/schedstat (version 15).
+struct SchedStatCpu
+{
+    uint64_t run_time_ns{};   // time spent running tasks on this cpu
+    uint64_t run_delay_ns{};  // time tasks spent runnable but waiting on this cpu's run queue
+    uint64_t timeslices{};    // number of timeslices run on this cpu
+    bool valid{false};
+};
+
+// Parse the cpuN lines of a /proc/schedstat file into a vector indexed by cpu number. Domain, version,
+// and timestamp lines are skipped.
+std::vector<SchedStatCpu> parse_schedstat(FILE* fp) noexcept;
+
+// Publishes the average time a task waits on a run queue before it gets the cpu, computed from the
+// run_delay / timeslices deltas between two consecutive reads. Unlike sys.load.*, this is a direct
+// measure of the scheduling delay felt by latency-sensitive services.
+class SchedStat
+{
+   public:
+    explicit SchedStat(Registry* registry, std::string path_prefix = "/proc") noexcept;
+
+    void set_prefix(std::string new_prefix) noexcept;
+
+    // Called every second, from the same loop as the peak cpu metrics.
+    void collect() noexcept;
+
+   private:
+    Registry* registry_;
+    std::string path_prefix_;
+    std::vector<SchedStatCpu> prev_;
+    MaxGauge max_latency_;
+    MaxGauge mean_latency_;
+    static constexpr double NANOS = 1000 * 1000 * 1000.0;
+};
+}  // namespace atlasagent
@@ -0,0 +1,46 @@
+#include <lib/collectors/schedstat/src/schedstat.h>
+
+#include <thirdparty/spectator-cpp/spectator/registry.h>
+#include <thirdparty/spectator-cpp/libs/writer/writer_wrapper/writer_test_helper.h>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+constexpr auto kSample1 = "lib/collectors/schedstat/test/resources/sample1";
+constexpr auto kSample2 = "lib/collectors/schedstat/test/resources/sample2";
+}  // namespace
+
+TEST(SchedStatTest, Parse)
+{
+    auto fp = atlasagent::open_file(kSample1, "schedstat");
+    auto cpus = atlasagent::parse_schedstat(fp);
+    ASSERT_EQ(cpus.size(), 2);
+    EXPECT_TRUE(cpus[0].valid);
+    EXPECT_EQ(cpus[0].run_time_ns, 10000000000ULL);
+    EXPECT_EQ(cpus[0].run_delay_ns, 2000000000ULL);
+    EXPECT_EQ(cpus[0].timeslices, 100000ULL);
+    EXPECT_EQ(cpus[1].run_delay_ns, 3000000000ULL);
+}
+
+TEST(SchedStatTest, RunQueueLatency)
+{
+    auto config = Config(WriterConfig(WriterTypes::Memory));
+    auto r = Registry(config);
+    atlasagent::SchedStat schedstat{&r, kSample1};
+
+    auto memoryWriter = static_cast<MemoryWriter*>(WriterTestHelper::GetImpl());
+    memoryWriter->Clear();
+
+    // the first read only establishes the baseline
+    schedstat.collect();
+    EXPECT_TRUE(memoryWriter->GetMessages().empty());
+
+    // cpu0: 50ms delay over 1000 slices, cpu1: 30ms over 3000 slices
+    schedstat.set_prefix(kSample2);
+    schedstat.collect();
+    auto messages = memoryWriter->GetMessages();
+    ASSERT_EQ(messages.size(), 2);
+    EXPECT_EQ(messages.at(0), "m:sys.cpu.runQueueLatency,id=max:0.000050\n");
+    EXPECT_EQ(messages.at(1), "m:sys.cpu.runQueueLatency,id=mean:0.000020\n");
+}
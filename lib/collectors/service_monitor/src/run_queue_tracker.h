@@ -0,0 +1,37 @@
+#pragma once
+
+#include <optional>
+
+// Turns the run_delay / timeslices counters of /proc/[pid]/schedstat into the average time, in
+// seconds, the process spent waiting on a run queue per timeslice during the interval just closed.
+//
+// Like CpuRateTracker it owns the Identity (main PID) its baseline was read from: update() returns
+// nullopt on the first sample, after an identity change or counter reset, and when no timeslices ran
+// in the interval (an idle process has no latency to report). The baseline advances on every call,
+// so callers must skip update() entirely when the read failed.
+template <typename Identity>
+class RunQueueTracker
+{
+   public:
+    std::optional<double> update(const Identity& id, unsigned long long runDelayNs, unsigned long long timeslices)
+    {
+        std::optional<double> latency;
+        if (valid_ && id == id_ && runDelayNs >= runDelayNs_ && timeslices > timeslices_)
+        {
+            latency = static_cast<double>(runDelayNs - runDelayNs_) / static_cast<double>(timeslices - timeslices_) /
+                      1e9;
+        }
+
+        id_ = id;
+        runDelayNs_ = runDelayNs;
+        timeslices_ = timeslices;
+        valid_ = true;
+        return latency;
+    }
+
+   private:
+    Identity id_{};
+    unsigned long long runDelayNs_{0};
+    unsigned long long timeslices_{0};
+    bool valid_{false};
+};
@@ -123,7 +123,8 @@ bool ServiceMonitor::publish_metric(const std::string& service, std::optional<T>
 
 bool ServiceMonitor::collect_process_metrics(const std::string& service, const ServiceProperties& props,
                                              std::chrono::steady_clock::time_point now,
-                                             CpuRateTracker<unsigned int>& cpu) const
+                                             CpuRateTracker<unsigned int>& cpu,
+                                             RunQueueTracker<unsigned int>& runQueue) const
 {
     bool success = true;
     success &= publish_metric(service, get_rss(props.mainPid), static_cast<double>(pageSize_),
@@ -131,6 +132,13 @@ bool ServiceMonitor::collect_process_metrics(const std::string& service, const S
     success &= publish_metric(service, get_number_fds(props.mainPid), 1.0, ServiceMonitorConstants::FdsName, "process",
                               "Failed to get FD count");
 
+    // schedstat is absent on kernels built without CONFIG_SCHEDSTATS; that is not a collection failure.
+    if (auto sched = get_process_schedstat(props.mainPid))
+    {
+        publish_metric(service, runQueue.update(props.mainPid, sched->runDelayNs, sched->timeslices), 1.0,
+                       ServiceMonitorConstants::RunQueueLatencyName, "process");
+    }
+
     // Read the main PID's accumulated CPU time. On a failed read there is no sample this cycle: skip
     // the tracker update so its baseline is preserved and the next good read spans the gap correctly.
     auto times = get_process_times(props.mainPid);
@@ -203,7 +211,7 @@ try
         // start invalid, so that cycle publishes no CPU%. The trackers are mutated in place -- there
         // is no per-cycle state object to rebuild and reassign.
         ServiceCpuState& state = cpuState_[service];
-        success &= collect_process_metrics(service, *props, now, state.process);
+        success &= collect_process_metrics(service, *props, now, state.process, state.runQueue);
         success &= collect_cgroup_metrics(service, *props, now, state.cgroup);
     }
 
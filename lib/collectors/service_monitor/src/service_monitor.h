@@ -19,6 +19,7 @@
 #include <thirdparty/spectator-cpp/spectator/registry.h>
 
 #include "cpu_rate_tracker.h"
+#include "run_queue_tracker.h"
 #include "service_monitor_utils.h"
 
 struct ServiceMonitorConstants
@@ -30,6 +31,7 @@ struct ServiceMonitorConstants
     static constexpr auto MemoryName{"systemd.service.memory"};  // whole-service cgroup memory.current
     static constexpr auto FdsName{"systemd.service.fds"};
     static constexpr auto CpuUsageName{"systemd.service.cpuUsage"};
+    static constexpr auto RunQueueLatencyName{"systemd.service.runQueueLatency"};  // main PID, from schedstat
     static constexpr auto ServiceStatusName{"systemd.service.status"};
 };
 
@@ -63,12 +65,13 @@ inline auto gaugeServiceState(Registry* registry, const std::string_view name, c
 }
 }  // namespace detail
 
-// The two independent CPU counters a service exposes: its main PID and its whole cgroup. Held in one
-// map entry per service so both advance under the same key.
+// The independent CPU counters a service exposes: its main PID and its whole cgroup, plus the main
+// PID's run-queue wait. Held in one map entry per service so all advance under the same key.
 struct ServiceCpuState
 {
-    CpuRateTracker<unsigned int> process;  // keyed by main PID
-    CpuRateTracker<std::string> cgroup;    // keyed by control-group path
+    CpuRateTracker<unsigned int> process;    // keyed by main PID
+    CpuRateTracker<std::string> cgroup;      // keyed by control-group path
+    RunQueueTracker<unsigned int> runQueue;  // main PID run-queue wait, keyed by main PID
 };
 
 class ServiceMonitor
@@ -106,11 +109,12 @@ class ServiceMonitor
     bool publish_metric(const std::string& service, std::optional<T> val, double scale, std::string_view name,
                         std::string_view scope, std::string_view errMsg = {}) const;
 
-    // Publish the per-main-PID metrics (rss, process-scope fds, process-scope cpu) and advance the
-    // process CPU tracker. Returns whether every metric this cycle was collected successfully. const:
+    // Publish the per-main-PID metrics (rss, process-scope fds, process-scope cpu, run-queue latency)
+    // and advance the process CPU and run-queue trackers. Returns whether every metric this cycle was collected successfully. const:
     // the only mutated state is the caller-owned tracker passed by reference, not a member of this.
     bool collect_process_metrics(const std::string& service, const ServiceProperties& props,
-                                 std::chrono::steady_clock::time_point now, CpuRateTracker<unsigned int>& cpu) const;
+                                 std::chrono::steady_clock::time_point now, CpuRateTracker<unsigned int>& cpu,
+                                 RunQueueTracker<unsigned int>& runQueue) const;
     // Publish the whole-cgroup metrics (memory, summed fds, service-scope cpu) and advance the cgroup
     // CPU tracker. Returns whether every metric this cycle was collected successfully. const for the
     // same reason as collect_process_metrics.
@@ -233,6 +233,36 @@ std::optional<ProcessTimes> get_process_times(const unsigned int& pid)
     return parse_process_times(pidStats.value());
 }
 
+std::optional<ProcessSchedStat> parse_process_schedstat(const std::vector<std::string>& lines)
+try
+{
+    // A single line of three counters: "<run_time ns> <run_delay ns> <timeslices>"
+    std::vector<std::string> tokens = absl::StrSplit(lines.at(0), ' ', absl::SkipWhitespace());
+    if (tokens.size() < 3)
+    {
+        atlasagent::Logger()->error("Not enough tokens in proc schedstat file. Expected 3, got {}", tokens.size());
+        return std::nullopt;
+    }
+    return ProcessSchedStat{std::stoull(tokens[0]), std::stoull(tokens[1]), std::stoull(tokens[2])};
+}
+catch (const std::exception& e)
+{
+    atlasagent::Logger()->error("Exception: {} in parse_process_schedstat", e.what());
+    return std::nullopt;
+}
+
+std::optional<ProcessSchedStat> get_process_schedstat(const unsigned int& pid)
+{
+    std::filesystem::path path = std::filesystem::path(ServiceMonitorUtilConstants::ProcPath) / std::to_string(pid) /
+                                 ServiceMonitorUtilConstants::SchedStatPath;
+    auto lines = atlasagent::read_file(path.string().c_str());
+    if (lines.has_value() == false)
+    {
+        return std::nullopt;
+    }
+    return parse_process_schedstat(lines.value());
+}
+
 std::optional<unsigned long> parse_rss(const std::vector<std::string>& pidStats)
 try
 {
@@ -41,6 +41,7 @@ struct ServiceMonitorUtilConstants
 {
     static constexpr auto ProcPath{"/proc"};
     static constexpr auto StatPath{"stat"};
+    static constexpr auto SchedStatPath{"schedstat"};
     static constexpr auto FdPath{"fd"};
     static constexpr auto ConfigFileExtPattern = ".*\\.systemd-unit$";
     static constexpr auto Active{"active"};
@@ -66,6 +67,14 @@ struct ProcessTimes
     unsigned long sTime{};
 };
 
+// /proc/[pid]/schedstat: time on cpu, time spent runnable waiting on a run queue, and timeslices run.
+struct ProcessSchedStat
+{
+    unsigned long long runTimeNs{};
+    unsigned long long runDelayNs{};
+    unsigned long long timeslices{};
+};
+
 struct ServiceProperties
 {
     std::string name;
@@ -86,6 +95,8 @@ std::optional<std::vector<std::regex>> parse_service_monitor_config_directory(co
 std::optional<unsigned long> get_rss(const unsigned int& pid);
 std::optional<unsigned int> get_number_fds(const unsigned int& pid);
 std::optional<ProcessTimes> get_process_times(const unsigned int& pid);
+std::optional<ProcessSchedStat> parse_process_schedstat(const std::vector<std::string>& lines);
+std::optional<ProcessSchedStat> get_process_schedstat(const unsigned int& pid);
 
 // cgroup-v2 metric functions
 // Returns nullopt when the usage_usec key is absent or unparseable (distinct from a real 0).
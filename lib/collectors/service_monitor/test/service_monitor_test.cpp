@@ -1,4 +1,5 @@
 #include <lib/collectors/service_monitor/src/cpu_rate_tracker.h>
+#include <lib/collectors/service_monitor/src/run_queue_tracker.h>
 #include <lib/collectors/service_monitor/src/service_monitor_utils.cpp>
 #include <lib/util/src/util.h>
 
@@ -248,3 +249,45 @@ TEST(CpuRateTrackerTest, StringIdentityComputesRateAndDetectsCgroupChange)
     EXPECT_DOUBLE_EQ(200.0, *pct);
     EXPECT_EQ(std::nullopt, tracker.update("/system.slice/bar.service", 3'000'000, at_seconds(2)));
 }
+
+TEST(ServiceMonitorTest, ParseProcPidSchedStat)
+{
+    auto filepath{"testdata/resources2/service_monitor/valid-proc-pid-schedstat.txt"};
+    auto fileContents = atlasagent::read_file(filepath);
+    EXPECT_NE(std::nullopt, fileContents);
+    auto sched = parse_process_schedstat(fileContents.value());
+    ASSERT_TRUE(sched.has_value());
+    EXPECT_EQ(1520123456ULL, sched->runTimeNs);
+    EXPECT_EQ(30000000ULL, sched->runDelayNs);
+    EXPECT_EQ(1000ULL, sched->timeslices);
+}
+
+TEST(ServiceMonitorTest, ParseProcPidSchedStatTruncated)
+{
+    std::vector<std::string> lines{"1520123456 30000000"};
+    EXPECT_EQ(std::nullopt, parse_process_schedstat(lines));
+}
+
+// ── RunQueueTracker ───────────────────────────────────────────────────────────
+
+// 30ms of run-queue delay over 10 timeslices is an average wait of 3ms per slice.
+TEST(RunQueueTrackerTest, AverageWaitPerTimeslice)
+{
+    RunQueueTracker<unsigned int> tracker;
+    EXPECT_EQ(std::nullopt, tracker.update(100, 0, 0));
+    auto latency = tracker.update(100, 30'000'000, 10);
+    ASSERT_TRUE(latency.has_value());
+    EXPECT_DOUBLE_EQ(0.003, *latency);
+}
+
+// A process that never ran during the interval has no latency to report, and a new PID rebaselines.
+TEST(RunQueueTrackerTest, IdleIntervalAndIdentityChange)
+{
+    RunQueueTracker<unsigned int> tracker;
+    tracker.update(100, 30'000'000, 10);
+    EXPECT_EQ(std::nullopt, tracker.update(100, 30'000'000, 10));
+    EXPECT_EQ(std::nullopt, tracker.update(200, 1'000'000, 5));
+    auto latency = tracker.update(200, 2'000'000, 6);
+    ASSERT_TRUE(latency.has_value());
+    EXPECT_DOUBLE_EQ(0.001, *latency);
+}
@@ -50,6 +50,19 @@ class UnixFile
 
     UnixFile(const UnixFile&) = delete;
     UnixFile(UnixFile&& other) noexcept : fd_(other.fd_) { other.fd_ = -1; }
+    UnixFile& operator=(UnixFile&& other) noexcept
+    {
+        if (this != &other)
+        {
+            if (fd_ >= 0)
+            {
+                close(fd_);
+            }
+            fd_ = other.fd_;
+            other.fd_ = -1;
+        }
+        return *this;
+    }
 
     void open(const char* name)
     {
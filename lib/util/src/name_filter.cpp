@@ -0,0 +1,139 @@
+#include "name_filter.h"
+
+#include <lib/logger/src/logger.h>
+
+#include <cstdlib>
+
+namespace atlasagent
+{
+
+// Iterative glob matching: on a mismatch, backtrack to the last '*' and let it absorb one more character
+bool glob_match(std::string_view pattern, std::string_view name) noexcept
+{
+    size_t p = 0, n = 0;
+    size_t star = std::string_view::npos, star_n = 0;
+    while (n < name.size())
+    {
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n]))
+        {
+            ++p;
+            ++n;
+        }
+        else if (p < pattern.size() && pattern[p] == '*')
+        {
+            star = p++;
+            star_n = n;
+        }
+        else if (star != std::string_view::npos)
+        {
+            p = star + 1;
+            n = ++star_n;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*')
+    {
+        ++p;
+    }
+    return p == pattern.size();
+}
+
+std::vector<NameFilter::Rule> NameFilter::compile(std::string_view rules)
+{
+    std::vector<Rule> compiled;
+    while (!rules.empty())
+    {
+        auto comma = rules.find(',');
+        auto rule = rules.substr(0, comma);
+        rules = comma == std::string_view::npos ? std::string_view{} : rules.substr(comma + 1);
+
+        while (!rule.empty() && rule.front() == ' ')
+        {
+            rule.remove_prefix(1);
+        }
+        while (!rule.empty() && rule.back() == ' ')
+        {
+            rule.remove_suffix(1);
+        }
+        if (rule.empty())
+        {
+            continue;
+        }
+
+        auto wildcard = rule.find_first_of("*?");
+        if (wildcard == std::string_view::npos)
+        {
+            compiled.push_back(Rule{Rule::Kind::Exact, std::string{rule}});
+        }
+        else if (wildcard == rule.size() - 1 && rule.back() == '*')
+        {
+            compiled.push_back(Rule{Rule::Kind::Prefix, std::string{rule.substr(0, wildcard)}});
+        }
+        else
+        {
+            compiled.push_back(Rule{Rule::Kind::Glob, std::string{rule}});
+        }
+    }
+    return compiled;
+}
+
+NameFilter::NameFilter(std::string_view include, std::string_view exclude)
+    : include_{compile(include)}, exclude_{compile(exclude)}
+{
+}
+
+NameFilter NameFilter::FromEnv(const char* includeVar, const char* excludeVar)
+{
+    auto include = std::getenv(includeVar);
+    auto exclude = std::getenv(excludeVar);
+    if (include == nullptr && exclude == nullptr)
+    {
+        return NameFilter{};
+    }
+    Logger()->info("Filtering names with {}={} {}={}", includeVar, include == nullptr ? "" : include, excludeVar,
+                   exclude == nullptr ? "" : exclude);
+    return NameFilter{include == nullptr ? "" : include, exclude == nullptr ? "" : exclude};
+}
+
+bool NameFilter::any_match(const std::vector<Rule>& rules, std::string_view name) noexcept
+{
+    for (const auto& rule : rules)
+    {
+        switch (rule.kind)
+        {
+            case Rule::Kind::Exact:
+                if (name == rule.pattern)
+                {
+                    return true;
+                }
+                break;
+            case Rule::Kind::Prefix:
+                if (name.starts_with(rule.pattern))
+                {
+                    return true;
+                }
+                break;
+            case Rule::Kind::Glob:
+                if (glob_match(rule.pattern, name))
+                {
+                    return true;
+                }
+                break;
+        }
+    }
+    return false;
+}
+
+bool NameFilter::matches(std::string_view name) const noexcept
+{
+    if (!include_.empty() && !any_match(include_, name))
+    {
+        return false;
+    }
+    return !any_match(exclude_, name);
+}
+
+}  // namespace atlasagent
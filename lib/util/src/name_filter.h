@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace atlasagent
+{
+
+// Include/exclude rules for device and interface names, compiled once from comma separated lists
+// such as "veth*,cali*,docker0". A rule without wildcards matches the whole name, a rule whose only
+// wildcard is a trailing '*' matches a prefix, and anything else is a glob where '*' matches any run
+// of characters and '?' any single character. A name matches when the include list is empty or one
+// of its rules matches, and none of the exclude rules match.
+class NameFilter
+{
+   public:
+    NameFilter() = default;  // matches everything
+    NameFilter(std::string_view include, std::string_view exclude);
+
+    // Rules from the environment variables, logging them when any are set
+    static NameFilter FromEnv(const char* includeVar, const char* excludeVar);
+
+    [[nodiscard]] bool matches(std::string_view name) const noexcept;
+    [[nodiscard]] bool empty() const noexcept { return include_.empty() && exclude_.empty(); }
+
+   private:
+    struct Rule
+    {
+        enum class Kind
+        {
+            Exact,
+            Prefix,
+            Glob
+        };
+        Kind kind;
+        std::string pattern;  // without the trailing '*' for prefixes
+    };
+
+    static std::vector<Rule> compile(std::string_view rules);
+    static bool any_match(const std::vector<Rule>& rules, std::string_view name) noexcept;
+
+    std::vector<Rule> include_;
+    std::vector<Rule> exclude_;
+};
+
+bool glob_match(std::string_view pattern, std::string_view name) noexcept;
+
+}  // namespace atlasagent
@@ -1,3 +1,4 @@
+#include <lib/util/src/name_filter.h>
 #include <lib/util/src/util.h>
 #include <gtest/gtest.h>
 
@@ -93,4 +94,36 @@ TEST(Utils, ParseTagsEmpty)
     EXPECT_EQ(some_invalid.size(), 1);
     EXPECT_EQ(some_invalid.at("key"), "val");
 }
+
+TEST(Utils, GlobMatch)
+{
+    using atlasagent::glob_match;
+    EXPECT_TRUE(glob_match("veth*", "veth1234"));
+    EXPECT_TRUE(glob_match("nvme?n*p*", "nvme0n1p1"));
+    EXPECT_TRUE(glob_match("*", ""));
+    EXPECT_TRUE(glob_match("a*b*c", "aXXbYYbc"));
+    EXPECT_FALSE(glob_match("nvme?n*p*", "nvme0n1"));
+    EXPECT_FALSE(glob_match("sd?", "sda1"));
+}
+
+TEST(Utils, NameFilter)
+{
+    atlasagent::NameFilter all;
+    EXPECT_TRUE(all.empty());
+    EXPECT_TRUE(all.matches("anything"));
+
+    atlasagent::NameFilter exclude{"", "veth*, cali*,docker0,dm-?*"};
+    EXPECT_FALSE(exclude.matches("veth0a1b"));
+    EXPECT_FALSE(exclude.matches("cali1234"));
+    EXPECT_FALSE(exclude.matches("docker0"));
+    EXPECT_FALSE(exclude.matches("dm-0"));
+    EXPECT_TRUE(exclude.matches("docker1"));
+    EXPECT_TRUE(exclude.matches("eth0"));
+
+    atlasagent::NameFilter include{"eth*,ens*", "eth1"};
+    EXPECT_TRUE(include.matches("eth0"));
+    EXPECT_TRUE(include.matches("ens5"));
+    EXPECT_FALSE(include.matches("eth1"));
+    EXPECT_FALSE(include.matches("lo"));
+}
 }  // namespace